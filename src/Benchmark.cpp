@@ -0,0 +1,396 @@
+/**
+  * @file Benchmark.cpp
+  * @brief Implementation of the Benchmark class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "Benchmark.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "PartNameIndex.h"
+#include "STLReader.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QPersistentModelIndex>
+#include <QScrollBar>
+#include <QTextStream>
+#include <QTreeView>
+
+#include <vtkNew.h>
+#include <vtkSTLReader.h>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/**
+ * @brief Benchmark::loadSTL
+ * Loads the file once with the selected reader and prints the time taken,
+ * the size of the mesh and the peak memory use of the process.
+ * @param fileName The STL file to load.
+ * @param reader "vtk" for vtkSTLReader or "fast" for STLReader.
+ * @return 0 on success, 1 if the file could not be loaded.
+ */
+int Benchmark::loadSTL(const QString& fileName, const QString& reader) {
+    QTextStream out(stdout);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    vtkSmartPointer<vtkPolyData> polyData;
+    if (reader == "vtk") {
+        vtkNew<vtkSTLReader> vtkReader;
+        vtkReader->SetFileName(fileName.toStdString().c_str());
+        vtkReader->Update();
+        polyData = vtkReader->GetOutput();
+    } else {
+        polyData = STLReader::read(fileName);
+    }
+
+    const qint64 elapsed = timer.elapsed();
+
+    if (!polyData || polyData->GetNumberOfPoints() == 0) {
+        out << "Could not load " << fileName << Qt::endl;
+        return 1;
+    }
+
+    out << "reader:    " << reader << Qt::endl;
+    out << "triangles: " << polyData->GetNumberOfCells() << Qt::endl;
+    out << "points:    " << polyData->GetNumberOfPoints() << Qt::endl;
+    out << "time:      " << elapsed << " ms" << Qt::endl;
+    out << "peak RSS:  " << peakMemory() / (1024 * 1024) << " MB" << Qt::endl;
+    return 0;
+}
+
+/**
+ * @brief Benchmark::tree
+ * Builds a tree of subassemblies of 5000 parts each, like a frame full of
+ * fasteners, and times expanding it in a QTreeView, scrolling through it a
+ * page at a time and visiting every index through the model.
+ * Run with "-platform offscreen" on a machine without a display. With lazy,
+ * the tree starts as records, as an opened project does, and every branch
+ * is made as the view expands it. With open, every part is visible with a
+ * geometry file, and the parts to load are listed as the main window does
+ * after opening a project, which makes every branch they are in; the files
+ * don't exist and aren't read.
+ * @param parts The number of parts in the tree.
+ * @param lazy True to keep the parts as PartRecords until their assembly is expanded.
+ * @param open True to give the parts geometry files and list them for loading first.
+ * @return 0 on success, 1 if the number of parts is not positive.
+ */
+int Benchmark::tree(int parts, bool lazy, bool open) {
+    QTextStream out(stdout);
+    if (parts <= 0) {
+        out << "The number of parts must be positive" << Qt::endl;
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const QList<ModelPart*> assemblies = syntheticTree(parts, lazy, open,
+                                                       [](int part) { return QString("Fastener %1.stl").arg(part + 1); });
+
+    ModelPartList model("PartsList");
+    model.replaceParts(assemblies);
+    const qint64 buildTime = timer.restart();
+    const qint64 buildMemory = peakMemory();
+
+    /* Parts made so far, without making any more */
+    auto madeParts = [&model]() {
+        qint64 made = 0;
+        QList<ModelPart*> stack = { model.getRootItem() };
+        while (!stack.isEmpty()) {
+            ModelPart* next = stack.takeLast();
+            made += next->childCount();
+            for (int i = 0; i < next->childCount(); ++i)
+                stack.append(next->child(i));
+        }
+        return made;
+    };
+
+    qint64 openTime = 0;
+    qsizetype toLoad = 0;
+    const qint64 madeBeforeOpen = madeParts();
+    if (open) {
+        timer.restart();
+        toLoad = model.visibleGeometryParts(model.getRootItem()).size();
+        openTime = timer.restart();
+    }
+    const qint64 madeAfterOpen = madeParts();
+    const qint64 openMemory = peakMemory();
+
+    QTreeView view;
+    view.setUniformRowHeights(true);
+    view.resize(400, 800);
+    view.setModel(&model);
+    view.show();
+    QApplication::processEvents();
+    const qint64 showTime = timer.restart();
+
+    view.expandAll();
+    QApplication::processEvents();
+    const qint64 expandTime = timer.restart();
+
+    QScrollBar* scrollBar = view.verticalScrollBar();
+    int pages = 0;
+    for (int value = 0; value <= scrollBar->maximum(); value += scrollBar->pageStep(), ++pages) {
+        scrollBar->setValue(value);
+        view.viewport()->repaint();
+    }
+    const qint64 scrollTime = timer.restart();
+
+    /* Every index, and the parent of every index, as a view or proxy model would ask */
+    qint64 visited = 0;
+    QList<QModelIndex> stack = { QModelIndex() };
+    while (!stack.isEmpty()) {
+        const QModelIndex parent = stack.takeLast();
+        if (model.canFetchMore(parent))
+            model.fetchMore(parent);
+        for (int row = 0; row < model.rowCount(parent); ++row) {
+            const QModelIndex index = model.index(row, 0, parent);
+            if (model.parent(index) != parent)
+                out << "Wrong parent at row " << row << Qt::endl;
+            stack.append(index);
+            ++visited;
+        }
+    }
+    const qint64 walkTime = timer.elapsed();
+
+    out << "parts:     " << parts << " in " << assemblies.size() << " assemblies" << (lazy ? ", lazy" : "") << Qt::endl;
+    out << "build:     " << buildTime << " ms, peak RSS " << buildMemory / (1024 * 1024) << " MB, "
+        << madeBeforeOpen << " parts made" << Qt::endl;
+    if (open)
+        out << "open:      " << openTime << " ms, peak RSS " << openMemory / (1024 * 1024) << " MB, "
+            << toLoad << " parts to load, " << madeAfterOpen << " parts made" << Qt::endl;
+    out << "show:      " << showTime << " ms" << Qt::endl;
+    out << "expand:    " << expandTime << " ms" << Qt::endl;
+    out << "scroll:    " << scrollTime << " ms for " << pages << " pages" << Qt::endl;
+    out << "walk:      " << walkTime << " ms for " << visited << " indexes" << Qt::endl;
+    out << "peak RSS:  " << peakMemory() / (1024 * 1024) << " MB" << Qt::endl;
+    return 0;
+}
+
+/**
+ * @brief Benchmark::search
+ * Builds a tree of subassemblies of 5000 parts each, named after a few kinds
+ * of fastener and held as records as in an opened project, and types the
+ * name of one part into the search a character at a time. Each search is
+ * timed through the index and as a scan of every name in the tree and its
+ * records, and the two must find the same number of parts.
+ *
+ * The tree is then changed as a user would: one assembly's branch is made,
+ * a tenth of its parts renamed, parts inserted and removed, and a whole
+ * assembly still held as records deleted. The name is typed again to check
+ * that the index has followed each change.
+ * @param parts The number of parts in the tree.
+ * @return 0 on success, 1 if the number of parts is not positive or the index and a scan disagree.
+ */
+int Benchmark::search(int parts) {
+    QTextStream out(stdout);
+    if (parts <= 0) {
+        out << "The number of parts must be positive" << Qt::endl;
+        return 1;
+    }
+
+    const QStringList kinds = { "Bolt_M8", "Nut_M8", "Washer_M8", "Bracket_Left", "Bracket_Right" };
+    auto partName = [&kinds](int part) {
+        return QString("%1_%2.stl").arg(kinds[part % kinds.size()]).arg(part + 1, 6, 10, QChar('0'));
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    const QList<ModelPart*> assemblies = syntheticTree(parts, true, false, partName);
+    ModelPartList model("PartsList");
+    model.replaceParts(assemblies);
+    const qint64 buildTime = timer.restart();
+
+    PartNameIndex index(&model);
+    const qint64 indexTime = timer.elapsed();
+
+    /* Every name in the tree, made or still a record */
+    auto scan = [&model](const QString& text) {
+        qsizetype found = 0;
+        QList<ModelPart*> stack = { model.getRootItem() };
+        while (!stack.isEmpty()) {
+            ModelPart* next = stack.takeLast();
+            for (int i = 0; i < next->childCount(); ++i) {
+                if (next->child(i)->name().contains(text, Qt::CaseInsensitive))
+                    ++found;
+                stack.append(next->child(i));
+            }
+
+            if (!next->hasPendingChildren())
+                continue;
+            const PartRecords* records = next->getRecords();
+            std::vector<qint32> pending = { next->getRecord() };
+            while (!pending.empty()) {
+                const qint32 record = pending.back();
+                pending.pop_back();
+                for (quint32 i = 0; i < records->childCount(record); ++i) {
+                    const qint32 child = records->child(record, i);
+                    if (records->name(child).contains(text, Qt::CaseInsensitive))
+                        ++found;
+                    pending.push_back(child);
+                }
+            }
+        }
+        return found;
+    };
+
+    const QString target = partName(parts / 2).toLower();
+    bool agreed = true;
+
+    /* Types the target, comparing the index with a scan at each keystroke */
+    auto typeTarget = [&](bool printEach) {
+        double indexTotal = 0.0;
+        double scanTotal = 0.0;
+        for (int length = 1; length <= target.size(); ++length) {
+            const QString text = target.left(length);
+
+            timer.restart();
+            const qsizetype found = index.find(text).size();
+            const double indexMs = timer.nsecsElapsed() / 1.0e6;
+
+            timer.restart();
+            const qsizetype scanned = scan(text);
+            const double scanMs = timer.nsecsElapsed() / 1.0e6;
+
+            indexTotal += indexMs;
+            scanTotal += scanMs;
+            if (found != scanned) {
+                agreed = false;
+                out << "  \"" << text << "\": index found " << found << ", scan found " << scanned << Qt::endl;
+            }
+            if (printEach)
+                out << QString("  %1 %2 matches, index %3 ms, scan %4 ms")
+                           .arg(text, -20).arg(found, 7).arg(indexMs, 8, 'f', 3).arg(scanMs, 8, 'f', 3) << Qt::endl;
+        }
+        out << "index:     " << QString::number(indexTotal, 'f', 3) << " ms for " << target.size() << " keystrokes" << Qt::endl;
+        out << "scan:      " << QString::number(scanTotal, 'f', 3) << " ms for " << target.size() << " keystrokes" << Qt::endl;
+    };
+
+    out << "parts:     " << parts << " in " << assemblies.size() << " assemblies, as records" << Qt::endl;
+    out << "build:     " << buildTime << " ms" << Qt::endl;
+    out << "index:     " << indexTime << " ms for " << index.partCount() << " parts" << Qt::endl;
+    out << "typing:    " << target << Qt::endl;
+    typeTarget(true);
+
+    /* Make one assembly's branch, so its records become parts */
+    ModelPart* middle = assemblies[assemblies.size() / 2];
+    const QPersistentModelIndex middleIndex = model.indexOf(middle);
+    timer.restart();
+    model.fetchChildren(middle);
+    const qint64 fetchTime = timer.restart();
+    const int made = model.rowCount(middleIndex);
+
+    int renamed = 0;
+    for (int row = 0; row < made; row += 10, ++renamed)
+        model.setData(model.index(row, ModelPartList::NameColumn, middleIndex), partName(parts + row));
+    const qint64 renameTime = timer.restart();
+
+    const int insertCount = 1000;
+    QList<ModelPart*> inserted;
+    for (int i = 0; i < insertCount; ++i)
+        inserted.append(new ModelPart(partName(2 * parts + i)));
+    model.insertParts(middleIndex, 0, inserted);
+    const qint64 insertTime = timer.restart();
+
+    /* Half the inserted parts and as many made ones, then an assembly still held as records */
+    const int removeCount = qMin(insertCount, model.rowCount(middleIndex) - insertCount / 2);
+    model.removeRows(insertCount / 2, removeCount, middleIndex);
+    const bool removeAssembly = assemblies.size() > 1;
+    if (removeAssembly)
+        model.removeRows(0, 1);
+    const qint64 removeTime = timer.elapsed();
+
+    out << "changes:   made " << made << " parts in " << fetchTime << " ms, "
+        << "renamed " << renamed << " in " << renameTime << " ms, "
+        << "inserted " << insertCount << " in " << insertTime << " ms, "
+        << "removed " << removeCount << " parts" << (removeAssembly ? " and an unmade assembly" : "")
+        << " in " << removeTime << " ms" << Qt::endl;
+    out << "index:     " << index.partCount() << " parts after the changes" << Qt::endl;
+    typeTarget(false);
+
+    out << "peak RSS:  " << peakMemory() / (1024 * 1024) << " MB" << Qt::endl;
+    if (!agreed)
+        out << "The index and the scan found different numbers of parts" << Qt::endl;
+    return agreed ? 0 : 1;
+}
+
+/**
+ * @brief Benchmark::syntheticTree
+ * @param parts The number of parts below the assemblies.
+ * @param lazy True to keep the parts below the assemblies as PartRecords.
+ * @param withFiles True to give every part below the assemblies a geometry file named after it.
+ * @param partName Gives the name of each part below the assemblies, numbered from 0.
+ * @return The assemblies, owned by the caller.
+ */
+QList<ModelPart*> Benchmark::syntheticTree(int parts, bool lazy, bool withFiles,
+                                           const std::function<QString(int)>& partName) {
+    const int perAssembly = 5000;
+    QList<ModelPart*> assemblies;
+
+    if (lazy) {
+        std::shared_ptr<PartRecords> records = std::make_shared<PartRecords>(nullptr);
+        for (int i = 0; i < parts; i += perAssembly) {
+            PartRecords::Record assembly;
+            assembly.name = QString("Assembly %1").arg(i / perAssembly + 1);
+            assembly.flags = ModelPart::Visible;
+            const qint32 parent = qint32(records->size());
+            records->add(-1, assembly);
+            for (int j = i; j < qMin(parts, i + perAssembly); ++j) {
+                PartRecords::Record part;
+                part.name = partName(j);
+                part.flags = ModelPart::Visible;
+                if (withFiles)
+                    part.fileName = part.name;
+                records->add(parent, part);
+            }
+        }
+        records->finish();
+        return PartRecords::createChildren(records, -1);
+    }
+
+    for (int i = 0; i < parts; i += perAssembly) {
+        ModelPart* assembly = new ModelPart(QString("Assembly %1").arg(i / perAssembly + 1));
+        for (int j = i; j < qMin(parts, i + perAssembly); ++j) {
+            ModelPart* part = new ModelPart(partName(j));
+            if (withFiles) {
+                PartSource origin;
+                origin.fileName = part->name();
+                part->setGeometrySource(origin);
+            }
+            assembly->appendChild(part);
+        }
+        assemblies.append(assembly);
+    }
+    return assemblies;
+}
+
+/**
+ * @brief Benchmark::peakMemory
+ * @return Peak resident set size in bytes, or 0 if unavailable.
+ */
+qint64 Benchmark::peakMemory() {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss;           // bytes on macOS
+#else
+    return usage.ru_maxrss * 1024;    // kilobytes on Linux
+#endif
+#endif
+}
@@ -0,0 +1,71 @@
+/** @file Benchmark.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Command line benchmarks bundled with the viewer
+  */
+
+#ifndef VIEWER_BENCHMARK_H
+#define VIEWER_BENCHMARK_H
+
+#include <QList>
+#include <QString>
+
+#include <functional>
+
+class ModelPart;
+
+/**
+ * @class Benchmark
+ * @brief Benchmarks run from the command line instead of opening the main window.
+ *
+ * Each benchmark prints its results to stdout and returns a process exit code.
+ * Run with e.g. "FirstQt --benchmark-load part.stl --reader vtk" and again with
+ * "--reader fast", in separate processes so the peak memory figures are independent.
+ */
+class Benchmark {
+public:
+    /**
+     * @brief Times loading an STL file and reports the process's peak memory use.
+     * @param fileName The STL file to load.
+     * @param reader "vtk" for vtkSTLReader or "fast" for STLReader.
+     * @return 0 on success, 1 if the file could not be loaded.
+     */
+    static int loadSTL(const QString& fileName, const QString& reader);
+
+    /**
+     * @brief Times a QTreeView over a synthetic tree of flat subassemblies.
+     * @param parts The number of parts in the tree.
+     * @param lazy True to keep the parts as PartRecords until their assembly is expanded.
+     * @param open True to give the parts geometry files and list them for loading first, as opening a project does.
+     * @return 0 on success, 1 if the number of parts is not positive.
+     */
+    static int tree(int parts, bool lazy, bool open);
+
+    /**
+     * @brief Times searching the names of a synthetic tree, one keystroke at a time, then changes the tree and checks the index followed.
+     * @param parts The number of parts in the tree.
+     * @return 0 on success, 1 if the number of parts is not positive or the index and a scan disagree.
+     */
+    static int search(int parts);
+
+    /**
+     * @brief Returns the peak resident memory of this process.
+     * @return Peak resident set size in bytes, or 0 if unavailable.
+     */
+    static qint64 peakMemory();
+
+private:
+    /**
+     * @brief Builds a synthetic tree of flat subassemblies of 5000 parts each.
+     * @param parts The number of parts below the assemblies.
+     * @param lazy True to keep the parts below the assemblies as PartRecords, as an opened project does.
+     * @param withFiles True to give every part below the assemblies a geometry file named after it.
+     * @param partName Gives the name of each part below the assemblies, numbered from 0.
+     * @return The assemblies, owned by the caller.
+     */
+    static QList<ModelPart*> syntheticTree(int parts, bool lazy, bool withFiles,
+                                           const std::function<QString(int)>& partName);
+};
+
+#endif
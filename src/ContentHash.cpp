@@ -0,0 +1,158 @@
+/**
+  * @file ContentHash.cpp
+  * @brief Implementation of the ContentHash class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "ContentHash.h"
+
+#include <QFile>
+#include <QByteArray>
+
+#include <cstring>
+
+namespace {
+
+const quint64 prime1 = 0x9E3779B185EBCA87ull;
+const quint64 prime2 = 0xC2B2AE3D27D4EB4Full;
+const quint64 prime3 = 0x165667B19E3779F9ull;
+const quint64 prime4 = 0x85EBCA77C2B2AE63ull;
+const quint64 prime5 = 0x27D4EB2F165667C5ull;
+
+inline quint64 rotl(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline quint64 read64(const uchar* p) {
+    quint64 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline quint32 read32(const uchar* p) {
+    quint32 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline quint64 xxRound(quint64 acc, quint64 input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+inline quint64 mergeRound(quint64 acc, quint64 value) {
+    acc ^= xxRound(0, value);
+    return acc * prime1 + prime4;
+}
+
+} // namespace
+
+/**
+ * @brief ContentHash::hash
+ * The reference XXH64 algorithm, reading input as little endian.
+ * @param data Start of the data.
+ * @param size Size of the data in bytes.
+ * @param seed Hash seed.
+ * @return The XXH64 hash.
+ */
+quint64 ContentHash::hash(const uchar* data, qint64 size, quint64 seed) {
+    const uchar* p = data;
+    const uchar* end = data + size;
+    quint64 h;
+
+    if (size >= 32) {
+        quint64 v1 = seed + prime1 + prime2;
+        quint64 v2 = seed + prime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - prime1;
+
+        const uchar* limit = end - 32;
+        do {
+            v1 = xxRound(v1, read64(p));      p += 8;
+            v2 = xxRound(v2, read64(p));      p += 8;
+            v3 = xxRound(v3, read64(p));      p += 8;
+            v4 = xxRound(v4, read64(p));      p += 8;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + prime5;
+    }
+
+    h += static_cast<quint64>(size);
+
+    while (p + 8 <= end) {
+        h ^= xxRound(0, read64(p));
+        h = rotl(h, 27) * prime1 + prime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<quint64>(read32(p)) * prime1;
+        h = rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * prime5;
+        h = rotl(h, 11) * prime1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * @brief ContentHash::hashFile
+ * Maps the file and hashes its contents, falling back to reading it if it can't be mapped.
+ * @param fileName The file to hash.
+ * @param ok If not null, set to false if the file could not be read.
+ * @return The XXH64 hash of the file contents.
+ */
+quint64 ContentHash::hashFile(const QString& fileName, bool* ok) {
+    if (ok)
+        *ok = false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    const qint64 size = file.size();
+    if (size == 0) {
+        if (ok)
+            *ok = true;
+        return hash(nullptr, 0);
+    }
+
+    if (const uchar* data = file.map(0, size)) {
+        if (ok)
+            *ok = true;
+        return hash(data, size);
+    }
+
+    QByteArray contents = file.readAll();
+    if (contents.size() != size)
+        return 0;
+
+    if (ok)
+        *ok = true;
+    return hash(reinterpret_cast<const uchar*>(contents.constData()), size);
+}
+
+/**
+ * @brief ContentHash::toString
+ * @param hash The hash.
+ * @return The hash as 16 hex digits.
+ */
+QString ContentHash::toString(quint64 hash) {
+    return QString("%1").arg(hash, 16, 16, QChar('0'));
+}
@@ -0,0 +1,47 @@
+/** @file ContentHash.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Fast 64 bit hash used to identify geometry by its content
+  */
+
+#ifndef VIEWER_CONTENTHASH_H
+#define VIEWER_CONTENTHASH_H
+
+#include <QString>
+
+/**
+ * @class ContentHash
+ * @brief XXH64 hashing of files and memory.
+ *
+ * XXH64 runs at close to memory bandwidth, so hashing a mapped STL file costs
+ * far less than parsing it.
+ */
+class ContentHash {
+public:
+    /**
+     * @brief Hashes a block of memory.
+     * @param data Start of the data.
+     * @param size Size of the data in bytes.
+     * @param seed Hash seed.
+     * @return The XXH64 hash.
+     */
+    static quint64 hash(const uchar* data, qint64 size, quint64 seed = 0);
+
+    /**
+     * @brief Hashes the contents of a file by mapping it. Safe to call from any thread.
+     * @param fileName The file to hash.
+     * @param ok If not null, set to false if the file could not be read.
+     * @return The XXH64 hash of the file contents.
+     */
+    static quint64 hashFile(const QString& fileName, bool* ok = nullptr);
+
+    /**
+     * @brief Formats a hash as 16 hex digits, e.g. for use in file names.
+     * @param hash The hash.
+     * @return The hash as a string.
+     */
+    static QString toString(quint64 hash);
+};
+
+#endif
@@ -0,0 +1,278 @@
+/**
+  * @file GeometryCache.cpp
+  * @brief Implementation of the GeometryCache class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "GeometryCache.h"
+#include "ContentHash.h"
+#include "MeshFile.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const quint32 indexMagic = 0x46534349;  // "FSCI"
+const quint32 indexVersion = 1;
+const char indexFileName[] = "index.dat";
+const char entrySuffix[] = ".mesh";
+
+} // namespace
+
+/**
+ * @brief GeometryCache::GeometryCache
+ * @param directory The cache directory, created if it doesn't exist.
+ * @param maxBytes Size cap for the cache's entries.
+ */
+GeometryCache::GeometryCache(const QString& directory, qint64 maxBytes)
+    : directory(directory), maxBytes(maxBytes), totalBytes(0), hitCount(0), missCount(0) {
+    QDir().mkpath(directory);
+    loadIndex();
+}
+
+/**
+ * @brief GeometryCache::~GeometryCache
+ * Saves the index so that unchanged files aren't rehashed next session.
+ */
+GeometryCache::~GeometryCache() {
+    QMutexLocker lock(&mutex);
+    saveIndex();
+}
+
+/**
+ * @brief GeometryCache::key
+ * Looks the file up by path, modification time and size, and only hashes its
+ * contents if it hasn't been seen in that state before.
+ * @param fileName The STL file.
+ * @param weldTolerance The weld tolerance the geometry is built with.
+ * @return The key, or an empty string if the file can't be read.
+ */
+QString GeometryCache::key(const QString& fileName, double weldTolerance) {
+    QFileInfo info(fileName);
+    if (!info.isFile())
+        return QString();
+
+    const QString fileKey = QString("%1|%2|%3")
+                                .arg(info.absoluteFilePath())
+                                .arg(info.lastModified().toMSecsSinceEpoch())
+                                .arg(info.size());
+
+    quint64 contentHash = 0;
+    bool known;
+    {
+        QMutexLocker lock(&mutex);
+        auto it = contentHashes.constFind(fileKey);
+        known = (it != contentHashes.constEnd());
+        if (known)
+            contentHash = it.value();
+    }
+
+    if (!known) {
+        bool ok;
+        contentHash = ContentHash::hashFile(fileName, &ok);
+        if (!ok)
+            return QString();
+
+        QMutexLocker lock(&mutex);
+        contentHashes.insert(fileKey, contentHash);
+    }
+
+    QString key = ContentHash::toString(contentHash);
+    if (weldTolerance > 0.0)
+        key += QString("_%1").arg(weldTolerance, 0, 'g', 17);
+    return key;
+}
+
+/**
+ * @brief GeometryCache::find
+ * Maps an entry's mesh. Entries that fail to map are treated as corrupt and deleted.
+ * @param key Key returned by key().
+ * @param stats If not null, receives the welding statistics stored with the mesh.
+ * @return The mesh, or a null pointer on a miss.
+ */
+vtkSmartPointer<vtkPolyData> GeometryCache::find(const QString& key, WeldStats* stats) {
+    if (key.isEmpty())
+        return nullptr;
+
+    {
+        QMutexLocker lock(&mutex);
+        if (!entries.contains(key)) {
+            ++missCount;
+            return nullptr;
+        }
+    }
+
+    const QString path = entryPath(key);
+    vtkSmartPointer<vtkPolyData> polyData = MeshFile::map(path, stats);
+
+    QMutexLocker lock(&mutex);
+    if (!polyData) {
+        ++missCount;
+        totalBytes -= entries.take(key).bytes;
+        QFile::remove(path);
+        return nullptr;
+    }
+
+    ++hitCount;
+    auto it = entries.find(key);
+    if (it != entries.end())
+        it->lastUsed = QDateTime::currentMSecsSinceEpoch();
+    return polyData;
+}
+
+/**
+ * @brief GeometryCache::store
+ * Writes the mesh as a new entry, then evicts old entries if needed.
+ * @param key Key returned by key().
+ * @param polyData The welded mesh, with point normals.
+ * @param stats The welding statistics.
+ */
+void GeometryCache::store(const QString& key, vtkPolyData* polyData, const WeldStats& stats) {
+    if (key.isEmpty() || !polyData)
+        return;
+
+    const QString path = entryPath(key);
+    if (!MeshFile::write(path, polyData, stats))
+        return;
+
+    Entry entry;
+    entry.bytes = QFileInfo(path).size();
+    entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+
+    QMutexLocker lock(&mutex);
+    totalBytes -= entries.value(key).bytes;
+    entries.insert(key, entry);
+    totalBytes += entry.bytes;
+    evict();
+}
+
+/**
+ * @brief GeometryCache::clear
+ * Deletes every entry file. Meshes currently mapped from them stay valid.
+ */
+void GeometryCache::clear() {
+    QMutexLocker lock(&mutex);
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+        QFile::remove(entryPath(it.key()));
+    entries.clear();
+    totalBytes = 0;
+}
+
+/**
+ * @brief GeometryCache::hits
+ * @return The number of lookups that found an entry.
+ */
+int GeometryCache::hits() const {
+    QMutexLocker lock(&mutex);
+    return hitCount;
+}
+
+/**
+ * @brief GeometryCache::misses
+ * @return The number of lookups that did not find an entry.
+ */
+int GeometryCache::misses() const {
+    QMutexLocker lock(&mutex);
+    return missCount;
+}
+
+/**
+ * @brief GeometryCache::size
+ * @return The total size of the cache's entries in bytes.
+ */
+qint64 GeometryCache::size() const {
+    QMutexLocker lock(&mutex);
+    return totalBytes;
+}
+
+/**
+ * @brief GeometryCache::entryPath
+ * @param key The entry's key.
+ * @return The path of the entry's file.
+ */
+QString GeometryCache::entryPath(const QString& key) const {
+    return directory + "/" + key + entrySuffix;
+}
+
+/**
+ * @brief GeometryCache::evict
+ * Deletes entries, least recently used first, until the cache is under its cap.
+ * Entries whose files can't be deleted (e.g. still mapped on Windows) are skipped.
+ */
+void GeometryCache::evict() {
+    if (totalBytes <= maxBytes)
+        return;
+
+    std::vector<std::pair<qint64, QString>> byAge;
+    byAge.reserve(entries.size());
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+        byAge.emplace_back(it->lastUsed, it.key());
+    std::sort(byAge.begin(), byAge.end());
+
+    for (const auto& oldest : byAge) {
+        if (totalBytes <= maxBytes)
+            break;
+        if (QFile::remove(entryPath(oldest.second)))
+            totalBytes -= entries.take(oldest.second).bytes;
+    }
+}
+
+/**
+ * @brief GeometryCache::loadIndex
+ * Reads the content hash index and last use times, then lists the entries
+ * actually on disk. Entries missing from the index count as used when their
+ * file was last modified.
+ */
+void GeometryCache::loadIndex() {
+    QHash<QString, qint64> lastUsed;
+
+    QFile file(directory + "/" + indexFileName);
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);
+        quint32 magic, version;
+        in >> magic >> version;
+        if (magic == indexMagic && version == indexVersion)
+            in >> contentHashes >> lastUsed;
+        if (in.status() != QDataStream::Ok) {
+            contentHashes.clear();
+            lastUsed.clear();
+        }
+    }
+
+    const QFileInfoList files = QDir(directory).entryInfoList({ QString("*") + entrySuffix }, QDir::Files);
+    for (const QFileInfo& info : files) {
+        Entry entry;
+        entry.bytes = info.size();
+        entry.lastUsed = lastUsed.value(info.completeBaseName(), info.lastModified().toMSecsSinceEpoch());
+        entries.insert(info.completeBaseName(), entry);
+        totalBytes += entry.bytes;
+    }
+}
+
+/**
+ * @brief GeometryCache::saveIndex
+ * Writes the content hash index and last use times. Call with the mutex held.
+ */
+void GeometryCache::saveIndex() const {
+    QHash<QString, qint64> lastUsed;
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+        lastUsed.insert(it.key(), it->lastUsed);
+
+    QSaveFile file(directory + "/" + indexFileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out << indexMagic << indexVersion << contentHashes << lastUsed;
+    file.commit();
+}
@@ -0,0 +1,129 @@
+/** @file GeometryCache.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Persistent cache of processed part geometry
+  */
+
+#ifndef VIEWER_GEOMETRYCACHE_H
+#define VIEWER_GEOMETRYCACHE_H
+
+#include "MeshWelder.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+/**
+ * @class GeometryCache
+ * @brief Directory of processed (welded, with normals) meshes keyed by STL file content.
+ *
+ * Each entry is a MeshFile named after the XXH64 hash of the STL file it was
+ * built from and the weld tolerance used, so a renamed or copied file still
+ * hits. An index of path, modification time and size to content hash avoids
+ * rehashing files that haven't changed since they were last seen. Entries are
+ * mapped straight into VTK arrays on a hit. The directory is kept under a size
+ * cap by evicting the least recently used entries.
+ *
+ * All functions are thread safe, so the cache can be used from loader threads.
+ */
+class GeometryCache {
+public:
+    /**
+     * @brief Opens (creating if needed) a cache directory and loads its index.
+     * @param directory The cache directory.
+     * @param maxBytes Size cap for the cache's entries.
+     */
+    GeometryCache(const QString& directory, qint64 maxBytes);
+
+    /**
+     * @brief Saves the index.
+     */
+    ~GeometryCache();
+
+    /**
+     * @brief Returns the entry key for an STL file, hashing the file if it has changed.
+     * @param fileName The STL file.
+     * @param weldTolerance The weld tolerance the geometry is built with.
+     * @return The key, or an empty string if the file can't be read.
+     */
+    QString key(const QString& fileName, double weldTolerance);
+
+    /**
+     * @brief Maps a cached mesh. Counts a hit or a miss.
+     * @param key Key returned by key().
+     * @param stats If not null, receives the welding statistics stored with the mesh.
+     * @return The mesh, or a null pointer on a miss.
+     */
+    vtkSmartPointer<vtkPolyData> find(const QString& key, WeldStats* stats = nullptr);
+
+    /**
+     * @brief Stores a processed mesh and evicts old entries if the cache is over its cap.
+     * @param key Key returned by key().
+     * @param polyData The welded mesh, with point normals.
+     * @param stats The welding statistics.
+     */
+    void store(const QString& key, vtkPolyData* polyData, const WeldStats& stats);
+
+    /**
+     * @brief Deletes every entry.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of lookups that found an entry.
+     */
+    int hits() const;
+
+    /**
+     * @brief Returns the number of lookups that did not find an entry.
+     */
+    int misses() const;
+
+    /**
+     * @brief Returns the total size of the cache's entries in bytes.
+     */
+    qint64 size() const;
+
+private:
+    /**
+     * @brief Size and last use of a cache entry.
+     */
+    struct Entry {
+        qint64 bytes = 0;               /**< Size of the entry file */
+        qint64 lastUsed = 0;            /**< Last hit or store, in ms since the epoch */
+    };
+
+    /**
+     * @brief Returns the path of an entry's file.
+     */
+    QString entryPath(const QString& key) const;
+
+    /**
+     * @brief Deletes least recently used entries until the cache is under its cap. Call with the mutex held.
+     */
+    void evict();
+
+    /**
+     * @brief Loads the index and lists the entry files on disk.
+     */
+    void loadIndex();
+
+    /**
+     * @brief Writes the index to disk.
+     */
+    void saveIndex() const;
+
+    QString                                     directory;          /**< Cache directory */
+    qint64                                      maxBytes;           /**< Size cap for all entries */
+    mutable QMutex                              mutex;              /**< Guards everything below */
+    QHash<QString, quint64>                     contentHashes;      /**< "path|mtime|size" to content hash */
+    QHash<QString, Entry>                       entries;            /**< Entries on disk by key */
+    qint64                                      totalBytes;         /**< Total size of the entries */
+    int                                         hitCount;           /**< Lookups that found an entry */
+    int                                         missCount;          /**< Lookups that did not find an entry */
+};
+
+#endif
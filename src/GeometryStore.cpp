@@ -0,0 +1,148 @@
+/**
+  * @file GeometryStore.cpp
+  * @brief Implementation of the GeometryStore class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "GeometryStore.h"
+#include "ContentHash.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+/**
+ * @brief GeometryStore::GeometryStore
+ */
+GeometryStore::GeometryStore()
+    : duplicateCount(0), savedBytes(0) {
+}
+
+/**
+ * @brief GeometryStore::key
+ * Uses the same form of key as the GeometryCache.
+ * @param fileName The STL file.
+ * @param weldTolerance The weld tolerance the geometry is built with.
+ * @return The key, or an empty string if the file can't be read.
+ */
+QString GeometryStore::key(const QString& fileName, double weldTolerance) {
+    bool ok;
+    const quint64 contentHash = ContentHash::hashFile(fileName, &ok);
+    if (!ok)
+        return QString();
+
+    QString key = ContentHash::toString(contentHash);
+    if (weldTolerance > 0.0)
+        key += QString("_%1").arg(weldTolerance, 0, 'g', 17);
+    return key;
+}
+
+/**
+ * @brief GeometryStore::projectKey
+ * The project's modification time is included so that a project saved over
+ * while parts of the old one are still in use doesn't match them.
+ * @param projectFile The project file.
+ * @param offset Offset of the blob in the file.
+ * @return The key.
+ */
+QString GeometryStore::projectKey(const QString& projectFile, qint64 offset) {
+    const QFileInfo info(projectFile);
+    return QString("%1|%2@%3")
+        .arg(info.absoluteFilePath())
+        .arg(info.lastModified().toMSecsSinceEpoch())
+        .arg(offset);
+}
+
+/**
+ * @brief GeometryStore::find
+ * @param key Key returned by key() or projectKey().
+ * @param stats If not null, receives the welding statistics of the mesh.
+ * @param shapeKey If not null, receives the mesh's shape key.
+ * @param shapeOrigin If not null, receives the origin the shape key is relative to.
+ * @return The mesh, or a null pointer if no part uses one with this key.
+ */
+vtkSmartPointer<vtkPolyData> GeometryStore::find(const QString& key, WeldStats* stats,
+                                                 quint64* shapeKey, double* shapeOrigin) const {
+    QMutexLocker lock(&mutex);
+    auto it = entries.constFind(key);
+    if (it == entries.constEnd())
+        return nullptr;
+
+    if (stats)
+        *stats = it->stats;
+    if (shapeKey)
+        *shapeKey = it->shapeKey;
+    if (shapeOrigin)
+        std::copy(it->shapeOrigin, it->shapeOrigin + 3, shapeOrigin);
+    return it->mesh;
+}
+
+/**
+ * @brief GeometryStore::acquire
+ * Two loader threads may both miss the same key and load the file twice. The
+ * second mesh to arrive here is dropped in favour of the first.
+ * @param key Key returned by key() or projectKey().
+ * @param mesh The mesh that was loaded or found for the key.
+ * @param stats The mesh's welding statistics.
+ * @param shapeKey The mesh's shape key.
+ * @param shapeOrigin The origin the shape key is relative to.
+ * @return The mesh the part should use.
+ */
+vtkSmartPointer<vtkPolyData> GeometryStore::acquire(const QString& key, vtkPolyData* mesh, const WeldStats& stats,
+                                                    quint64 shapeKey, const double shapeOrigin[3]) {
+    QMutexLocker lock(&mutex);
+    Entry& entry = entries[key];
+    if (entry.users > 0) {
+        ++duplicateCount;
+        savedBytes += entry.mesh->GetActualMemorySize() * qint64(1024);
+    } else {
+        entry.mesh = mesh;
+        entry.stats = stats;
+        entry.shapeKey = shapeKey;
+        std::copy(shapeOrigin, shapeOrigin + 3, entry.shapeOrigin);
+    }
+
+    ++entry.users;
+    return entry.mesh;
+}
+
+/**
+ * @brief GeometryStore::release
+ * @param key The key the reference was taken with.
+ */
+void GeometryStore::release(const QString& key) {
+    QMutexLocker lock(&mutex);
+    auto it = entries.find(key);
+    if (it != entries.end() && --it->users <= 0)
+        entries.erase(it);
+}
+
+/**
+ * @brief GeometryStore::meshCount
+ * @return The number of meshes in use.
+ */
+int GeometryStore::meshCount() const {
+    QMutexLocker lock(&mutex);
+    return entries.size();
+}
+
+/**
+ * @brief GeometryStore::duplicateLoads
+ * @return The number of loads that were given a mesh already in use.
+ */
+int GeometryStore::duplicateLoads() const {
+    QMutexLocker lock(&mutex);
+    return duplicateCount;
+}
+
+/**
+ * @brief GeometryStore::bytesSaved
+ * @return The memory saved by sharing meshes, in bytes.
+ */
+qint64 GeometryStore::bytesSaved() const {
+    QMutexLocker lock(&mutex);
+    return savedBytes;
+}
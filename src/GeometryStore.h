@@ -0,0 +1,124 @@
+/** @file GeometryStore.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * In-memory store sharing one mesh between parts loaded from the same bytes
+  */
+
+#ifndef VIEWER_GEOMETRYSTORE_H
+#define VIEWER_GEOMETRYSTORE_H
+
+#include "MeshWelder.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+/**
+ * @class GeometryStore
+ * @brief Meshes currently in use, keyed by the content they were loaded from.
+ *
+ * STL files are keyed by the XXH64 hash of their contents and the weld
+ * tolerance, as in the GeometryCache, so the same file imported again under
+ * another name or from another folder is found here and not loaded at all.
+ * Geometry embedded in a project is keyed by the project and the blob's offset.
+ *
+ * Each entry counts the parts using it (see acquire() and release()) and is
+ * dropped when the last one lets go, so the mesh is freed with its last part.
+ * The entry also keeps the mesh's shape key for instancing, worked out when
+ * the mesh was loaded, as computing it again would read the mesh's bounds
+ * while it is being rendered.
+ * Loader threads only look meshes up; parts take and give back references on
+ * the GUI thread. All functions are thread safe.
+ */
+class GeometryStore {
+public:
+    /**
+     * @brief Constructor for the GeometryStore class.
+     */
+    GeometryStore();
+
+    /**
+     * @brief Returns the key of an STL file by hashing its contents.
+     * @param fileName The STL file.
+     * @param weldTolerance The weld tolerance the geometry is built with.
+     * @return The key, or an empty string if the file can't be read.
+     */
+    static QString key(const QString& fileName, double weldTolerance);
+
+    /**
+     * @brief Returns the key of a mesh blob embedded in a project file.
+     * @param projectFile The project file.
+     * @param offset Offset of the blob in the file.
+     * @return The key.
+     */
+    static QString projectKey(const QString& projectFile, qint64 offset);
+
+    /**
+     * @brief Looks up a mesh that is in use.
+     * @param key Key returned by key() or projectKey().
+     * @param stats If not null, receives the welding statistics of the mesh.
+     * @param shapeKey If not null, receives the mesh's shape key (see PartInstancer::shapeKey()).
+     * @param shapeOrigin If not null, receives the origin the shape key is relative to.
+     * @return The mesh, or a null pointer if no part uses one with this key.
+     */
+    vtkSmartPointer<vtkPolyData> find(const QString& key, WeldStats* stats = nullptr,
+                                      quint64* shapeKey = nullptr, double* shapeOrigin = nullptr) const;
+
+    /**
+     * @brief Takes a reference to the mesh with a key, adding the mesh if there is none.
+     *
+     * If the key is already in use its mesh is returned instead of the one
+     * given, and the load is counted as a duplicate.
+     * @param key Key returned by key() or projectKey().
+     * @param mesh The mesh that was loaded or found for the key.
+     * @param stats The mesh's welding statistics.
+     * @param shapeKey The mesh's shape key.
+     * @param shapeOrigin The origin the shape key is relative to.
+     * @return The mesh the part should use.
+     */
+    vtkSmartPointer<vtkPolyData> acquire(const QString& key, vtkPolyData* mesh, const WeldStats& stats,
+                                         quint64 shapeKey, const double shapeOrigin[3]);
+
+    /**
+     * @brief Gives back a reference taken by acquire(), dropping the mesh after its last one.
+     * @param key The key the reference was taken with.
+     */
+    void release(const QString& key);
+
+    /**
+     * @brief Returns the number of meshes in use.
+     */
+    int meshCount() const;
+
+    /**
+     * @brief Returns the number of loads that were given a mesh already in use.
+     */
+    int duplicateLoads() const;
+
+    /**
+     * @brief Returns the memory the duplicate loads would otherwise have used, in bytes.
+     */
+    qint64 bytesSaved() const;
+
+private:
+    /**
+     * @brief A mesh and the number of parts using it.
+     */
+    struct Entry {
+        vtkSmartPointer<vtkPolyData>    mesh;                   /**< The shared mesh */
+        WeldStats                       stats;                  /**< Welding statistics of the mesh */
+        quint64                         shapeKey = 0;           /**< Shape key of the mesh */
+        double                          shapeOrigin[3] = {};    /**< Origin the shape key is relative to */
+        int                             users = 0;              /**< Parts holding a reference */
+    };
+
+    mutable QMutex                              mutex;              /**< Guards everything below */
+    QHash<QString, Entry>                       entries;            /**< Meshes in use by key */
+    int                                         duplicateCount;     /**< Loads given a mesh already in use */
+    qint64                                      savedBytes;         /**< Memory of those meshes */
+};
+
+#endif
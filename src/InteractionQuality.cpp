@@ -0,0 +1,126 @@
+/**
+  * @file InteractionQuality.cpp
+  * @brief Implementation of the InteractionQuality class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "InteractionQuality.h"
+#include "LodManager.h"
+
+#include <vtkCommand.h>
+#include <vtkCullerCollection.h>
+#include <vtkFrustumCoverageCuller.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderWindowInteractor.h>
+
+namespace {
+
+/* Fraction of the view a part must cover to be drawn at each level */
+const double minimumCoverage[InteractionQuality::maxLevel + 1] = { 0.0, 0.0, 1e-4, 1e-3 };
+
+/* Frames in a row under half the budget before quality is raised again */
+const int framesToRecover = 30;
+
+} // namespace
+
+/**
+ * @brief InteractionQuality::InteractionQuality
+ * @param renderer The renderer whose small parts are culled.
+ * @param interactor The interactor the camera is moved with.
+ * @param lodManager The manager whose levels are coarsened.
+ * @param targetFps Frame rate to hold during interaction.
+ */
+InteractionQuality::InteractionQuality(vtkRenderer* renderer, vtkRenderWindowInteractor* interactor,
+                                       LodManager* lodManager, double targetFps)
+    : renderer(renderer), renderWindow(interactor->GetRenderWindow()), interactor(interactor),
+      lodManager(lodManager), culler(nullptr), budget(1.0 / targetFps), interactive(false),
+      smoothedTime(0.0), quality(0), fastFrames(0) {
+    /* The interactor styles switch the window to this rate while the camera moves */
+    interactor->SetDesiredUpdateRate(targetFps);
+
+    vtkCullerCollection* cullers = renderer->GetCullers();
+    cullers->InitTraversal();
+    while (vtkCuller* item = cullers->GetNextItem())
+        if ((culler = vtkFrustumCoverageCuller::SafeDownCast(item)))
+            break;
+
+    startObserver = renderWindow->AddObserver(vtkCommand::StartEvent, this, &InteractionQuality::onStartRender);
+    endObserver = renderWindow->AddObserver(vtkCommand::EndEvent, this, &InteractionQuality::onEndRender);
+}
+
+/**
+ * @brief InteractionQuality::~InteractionQuality
+ */
+InteractionQuality::~InteractionQuality() {
+    renderWindow->RemoveObserver(startObserver);
+    renderWindow->RemoveObserver(endObserver);
+    apply(0);
+}
+
+/**
+ * @brief InteractionQuality::level
+ * @return The level, 0 for full quality.
+ */
+int InteractionQuality::level() const {
+    return quality;
+}
+
+/**
+ * @brief InteractionQuality::frameTime
+ * @return The smoothed frame time, in milliseconds.
+ */
+double InteractionQuality::frameTime() const {
+    return smoothedTime * 1000.0;
+}
+
+/**
+ * @brief InteractionQuality::onStartRender
+ * The render window's StartEvent comes before the renderer's, where the
+ * LodManager picks the levels, so the bias set here applies to this frame.
+ */
+void InteractionQuality::onStartRender(vtkObject*, unsigned long, void*) {
+    interactive = renderWindow->GetDesiredUpdateRate() > interactor->GetStillUpdateRate();
+    apply(interactive ? quality : 0);
+    frameTimer.start();
+}
+
+/**
+ * @brief InteractionQuality::onEndRender
+ * The average restarts after every change of level, so one slow frame only
+ * moves the level by one step.
+ */
+void InteractionQuality::onEndRender(vtkObject*, unsigned long, void*) {
+    if (!interactive)
+        return;
+
+    const double seconds = frameTimer.nsecsElapsed() / 1e9;
+    smoothedTime = smoothedTime > 0.0 ? 0.7 * smoothedTime + 0.3 * seconds : seconds;
+
+    if (smoothedTime > budget) {
+        fastFrames = 0;
+        if (quality < maxLevel) {
+            ++quality;
+            smoothedTime = 0.0;
+        }
+    } else if (smoothedTime < budget / 2.0 && quality > 0) {
+        if (++fastFrames >= framesToRecover) {
+            --quality;
+            fastFrames = 0;
+            smoothedTime = 0.0;
+        }
+    } else {
+        fastFrames = 0;
+    }
+}
+
+/**
+ * @brief InteractionQuality::apply
+ * @param level The level, 0 for full quality.
+ */
+void InteractionQuality::apply(int level) {
+    lodManager->setLevelBias(level < maxLevel ? level : LodManager::maxLevels);
+    if (culler)
+        culler->SetMinimumCoverage(minimumCoverage[level]);
+}
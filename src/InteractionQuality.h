@@ -0,0 +1,103 @@
+/** @file InteractionQuality.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Lowers rendering quality while the camera is moving to hold a frame-time budget
+  */
+
+#ifndef VIEWER_INTERACTIONQUALITY_H
+#define VIEWER_INTERACTIONQUALITY_H
+
+#include <QElapsedTimer>
+
+class LodManager;
+class vtkFrustumCoverageCuller;
+class vtkObject;
+class vtkRenderer;
+class vtkRenderWindow;
+class vtkRenderWindowInteractor;
+
+/**
+ * @class InteractionQuality
+ * @brief Trades quality for frame rate while the user rotates, pans or zooms.
+ *
+ * VTK's interactor styles raise the render window's desired update rate to
+ * the interactor's while the camera is being moved and drop it back to the
+ * still rate when the mouse is released. Each render at the interactive rate
+ * is timed, and when the smoothed frame time goes over the budget (one frame
+ * at the target rate) the quality level steps down; after a run of frames
+ * comfortably inside it, it steps back up. The levels are:
+ *
+ *  - 1: every part is drawn one LodManager level coarser,
+ *  - 2: two levels coarser, and parts covering a tiny fraction of the view are culled,
+ *  - 3: the coarsest level of every part, and small parts are culled more aggressively.
+ *
+ * The level is only applied to interactive renders, so the render after the
+ * interaction stops is at full quality. It is kept between interactions, so
+ * the next drag starts at what the hardware needed last time.
+ */
+class InteractionQuality {
+public:
+    /**
+     * @brief Most quality levels the renderer is degraded by.
+     */
+    static const int maxLevel = 3;
+
+    /**
+     * @brief Constructor for the InteractionQuality class.
+     * @param renderer The renderer whose small parts are culled.
+     * @param interactor The interactor the camera is moved with.
+     * @param lodManager The manager whose levels are coarsened.
+     * @param targetFps Frame rate to hold during interaction.
+     */
+    InteractionQuality(vtkRenderer* renderer, vtkRenderWindowInteractor* interactor, LodManager* lodManager,
+                       double targetFps = 60.0);
+
+    /**
+     * @brief Destructor, restores full quality.
+     */
+    ~InteractionQuality();
+
+    /**
+     * @brief Returns the quality level interactive renders are drawn at, 0 being full quality.
+     */
+    int level() const;
+
+    /**
+     * @brief Returns the smoothed time of recent interactive frames, in milliseconds.
+     */
+    double frameTime() const;
+
+private:
+    /**
+     * @brief Render window StartEvent callback, applies the level for this frame.
+     */
+    void onStartRender(vtkObject* caller, unsigned long event, void* callData);
+
+    /**
+     * @brief Render window EndEvent callback, times the frame and adjusts the level.
+     */
+    void onEndRender(vtkObject* caller, unsigned long event, void* callData);
+
+    /**
+     * @brief Sets the LOD bias and small part culling for a level.
+     * @param level The level, 0 for full quality.
+     */
+    void apply(int level);
+
+    vtkRenderer*                                renderer;       /**< Renderer whose small parts are culled */
+    vtkRenderWindow*                            renderWindow;   /**< Window whose renders are timed */
+    vtkRenderWindowInteractor*                  interactor;     /**< Interactor the camera is moved with */
+    LodManager*                                 lodManager;     /**< Manager whose levels are coarsened */
+    vtkFrustumCoverageCuller*                   culler;         /**< The renderer's coverage culler, may be null */
+    unsigned long                               startObserver;  /**< StartEvent observer tag */
+    unsigned long                               endObserver;    /**< EndEvent observer tag */
+    double                                      budget;         /**< Frame-time budget, in seconds */
+    QElapsedTimer                               frameTimer;     /**< Times the current frame */
+    bool                                        interactive;    /**< True while the current frame is an interactive one */
+    double                                      smoothedTime;   /**< Smoothed interactive frame time, in seconds */
+    int                                         quality;        /**< Level applied to interactive renders */
+    int                                         fastFrames;     /**< Interactive frames in a row well inside the budget */
+};
+
+#endif
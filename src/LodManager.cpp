@@ -0,0 +1,408 @@
+/**
+  * @file LodManager.cpp
+  * @brief Implementation of the LodManager class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "LodManager.h"
+#include "ContentHash.h"
+#include "GeometryCache.h"
+#include "MeshFile.h"
+#include "ModelPart.h"
+
+#include <QMetaObject>
+#include <QThread>
+
+#include <vtkBillboardTextActor3D.h>
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkCommand.h>
+#include <vtkDataArray.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkRenderer.h>
+#include <vtkTextActor.h>
+#include <vtkTextProperty.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+/* Below this many triangles a part draws fast enough in full */
+const vtkIdType minTriangles = 5000;
+
+/**
+ * @brief Fraction of the triangles removed for each level, for 2, 3 or 4 levels.
+ */
+QList<double> reductionsFor(int levels) {
+    switch (levels) {
+    case 2:  return { 0.6, 0.9 };
+    case 3:  return { 0.5, 0.8, 0.95 };
+    default: return { 0.5, 0.75, 0.9, 0.97 };
+    }
+}
+
+/**
+ * @brief Hashes a mesh's points and connectivity, naming its levels in the cache.
+ */
+QString meshKey(vtkPolyData* mesh) {
+    vtkDataArray* points = mesh->GetPoints()->GetData();
+    vtkDataArray* connectivity = mesh->GetPolys()->GetConnectivityArray();
+
+    quint64 key = ContentHash::hash(static_cast<const uchar*>(connectivity->GetVoidPointer(0)),
+                                    connectivity->GetNumberOfValues() * connectivity->GetDataTypeSize());
+    key = ContentHash::hash(static_cast<const uchar*>(points->GetVoidPointer(0)),
+                            points->GetNumberOfValues() * points->GetDataTypeSize(), key);
+    return ContentHash::toString(key);
+}
+
+} // namespace
+
+/**
+ * @brief LodManager::LodManager
+ * @param renderer The renderer whose camera picks the levels.
+ * @param parent The parent object.
+ */
+LodManager::LodManager(vtkRenderer* renderer, QObject* parent)
+    : QObject(parent), renderer(renderer), cache(nullptr), cancelFlag(std::make_shared<std::atomic<bool>>(false)),
+      pixelThresholds({ 400.0, 150.0, 50.0 }), levelBias(0), overlayVisible(false) {
+    /* Decimation is slower than loading, so leave a core for the GUI and the loader */
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    observer = renderer->AddObserver(vtkCommand::StartEvent, this, &LodManager::onStartRender);
+}
+
+/**
+ * @brief LodManager::~LodManager
+ */
+LodManager::~LodManager() {
+    cancelFlag->store(true);
+    pool.clear();
+    pool.waitForDone();
+    renderer->RemoveObserver(observer);
+    setOverlayVisible(false);
+
+    for (auto it = partMeshes.constBegin(); it != partMeshes.constEnd(); ++it)
+        it.key()->setLodManager(nullptr);
+}
+
+/**
+ * @brief LodManager::setCache
+ * @param cache The cache, or nullptr for none.
+ */
+void LodManager::setCache(GeometryCache* cache) {
+    this->cache = cache;
+}
+
+/**
+ * @brief LodManager::addPart
+ * Parts whose mesh already has levels, or is already being decimated, share
+ * them rather than starting another job.
+ * @param part The part.
+ */
+void LodManager::addPart(ModelPart* part) {
+    removePart(part);
+
+    vtkSmartPointer<vtkPolyData> mesh = part->getSource();
+    if (!mesh || mesh->GetNumberOfPolys() < minTriangles ||
+        mesh->GetPolys()->GetNumberOfConnectivityIds() != 3 * mesh->GetNumberOfPolys())
+        return;     // small, or not all triangles as vtkQuadricDecimation needs
+
+    partMeshes.insert(part, mesh);
+    part->setLodManager(this);
+
+    if (ModelPart* other = partsByMesh.value(mesh)) {
+        part->setLodLevels(other->getLodLevels());
+        partsByMesh.insert(mesh, part);
+        return;
+    }
+
+    auto waiting = pending.find(mesh);
+    if (waiting != pending.end()) {
+        waiting->append(part);
+        return;
+    }
+    pending.insert(mesh, { part });
+
+    std::shared_ptr<std::atomic<bool>> cancelled = cancelFlag;
+    const QList<double> reductions = reductionsFor(pixelThresholds.size());
+    GeometryCache* levelCache = cache;
+
+    pool.start([this, mesh, reductions, levelCache, cancelled]() {
+        QList<vtkSmartPointer<vtkPolyData>> levels;
+        if (!cancelled->load())
+            levels = buildLevels(mesh, reductions, levelCache);
+
+        QMetaObject::invokeMethod(this, [this, mesh, levels, cancelled]() {
+            levelsReady(mesh, levels, cancelled);
+        }, Qt::QueuedConnection);
+    });
+}
+
+/**
+ * @brief LodManager::removePart
+ * @param part The part.
+ */
+void LodManager::removePart(ModelPart* part) {
+    auto found = partMeshes.find(part);
+    if (found == partMeshes.end())
+        return;
+
+    vtkPolyData* mesh = *found;
+    partMeshes.erase(found);
+    partsByMesh.remove(mesh, part);
+
+    auto waiting = pending.find(mesh);
+    if (waiting != pending.end()) {
+        waiting->removeOne(part);
+        if (waiting->isEmpty())
+            pending.erase(waiting);
+    }
+
+    if (vtkSmartPointer<vtkBillboardTextActor3D> label = labels.take(part))
+        renderer->RemoveActor(label);
+
+    part->setLodManager(nullptr);
+}
+
+/**
+ * @brief LodManager::clear
+ * Jobs that have not started are dropped, and the results of running ones are ignored.
+ */
+void LodManager::clear() {
+    cancelFlag->store(true);
+    pool.clear();
+    cancelFlag = std::make_shared<std::atomic<bool>>(false);
+
+    for (auto it = partMeshes.constBegin(); it != partMeshes.constEnd(); ++it)
+        it.key()->setLodManager(nullptr);
+    partMeshes.clear();
+    partsByMesh.clear();
+    pending.clear();
+
+    for (const auto& label : std::as_const(labels))
+        renderer->RemoveActor(label);
+    labels.clear();
+}
+
+/**
+ * @brief LodManager::setThresholds
+ * @param pixels 2 to 4 sizes, largest first.
+ * @return False if the thresholds are not valid.
+ */
+bool LodManager::setThresholds(const QList<double>& pixels) {
+    if (pixels.size() < 2 || pixels.size() > maxLevels)
+        return false;
+    for (int i = 0; i < pixels.size(); ++i)
+        if (pixels[i] <= 0.0 || (i > 0 && pixels[i] >= pixels[i - 1]))
+            return false;
+
+    pixelThresholds = pixels;
+    return true;
+}
+
+/**
+ * @brief LodManager::thresholds
+ * @return The projected sizes, in pixels, below which each level is used.
+ */
+QList<double> LodManager::thresholds() const {
+    return pixelThresholds;
+}
+
+/**
+ * @brief LodManager::setLevelBias
+ * @param levels 0 for the normal levels.
+ */
+void LodManager::setLevelBias(int levels) {
+    levelBias = qMax(0, levels);
+}
+
+/**
+ * @brief LodManager::setOverlayVisible
+ * @param visible True to label each part with its level.
+ */
+void LodManager::setOverlayVisible(bool visible) {
+    overlayVisible = visible;
+    if (visible) {
+        if (!overlayText) {
+            overlayText = vtkSmartPointer<vtkTextActor>::New();
+            overlayText->GetTextProperty()->SetFontSize(14);
+            overlayText->GetTextProperty()->SetColor(0.1, 0.1, 0.1);
+            overlayText->SetDisplayPosition(10, 10);
+        }
+        renderer->AddActor2D(overlayText);
+        return;
+    }
+
+    if (overlayText)
+        renderer->RemoveActor2D(overlayText);
+    for (const auto& label : std::as_const(labels))
+        renderer->RemoveActor(label);
+    labels.clear();
+}
+
+/**
+ * @brief LodManager::update
+ * A part's projected size is its bounding sphere's diameter over the height
+ * of the view at the sphere's distance, times the viewport height in pixels.
+ */
+void LodManager::update() {
+    const int* size = renderer->GetSize();
+    if (partsByMesh.isEmpty() || size[1] <= 0) {
+        if (overlayVisible) {
+            const int counts[maxLevels + 1] = {};
+            updateOverlay(counts);
+        }
+        return;
+    }
+
+    vtkCamera* camera = renderer->GetActiveCamera();
+    double eye[3];
+    camera->GetPosition(eye);
+    const double tanHalfAngle = std::tan(vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2.0);
+
+    int counts[maxLevels + 1] = {};
+    for (auto it = partsByMesh.constBegin(); it != partsByMesh.constEnd(); ++it) {
+        ModelPart* part = it.value();
+        vtkActor* actor = part->getActor();
+        if (!actor || !actor->GetVisibility())
+            continue;
+
+        double bounds[6];
+        actor->GetBounds(bounds);
+        const double centre[3] = { (bounds[0] + bounds[1]) / 2.0, (bounds[2] + bounds[3]) / 2.0, (bounds[4] + bounds[5]) / 2.0 };
+        const double corner[3] = { bounds[1], bounds[3], bounds[5] };
+        const double radius = std::sqrt(vtkMath::Distance2BetweenPoints(centre, corner));
+
+        double pixels;
+        if (camera->GetParallelProjection()) {
+            pixels = radius / camera->GetParallelScale() * size[1];
+        } else {
+            const double distance = std::sqrt(vtkMath::Distance2BetweenPoints(eye, centre));
+            pixels = distance > radius ? radius * size[1] / (distance * tanHalfAngle)
+                                       : std::numeric_limits<double>::max();
+        }
+
+        int level = 0;
+        while (level < pixelThresholds.size() && level < part->lodLevelCount() && pixels < pixelThresholds[level])
+            ++level;
+        part->setLodLevel(std::min(level + levelBias, part->lodLevelCount()));
+        ++counts[part->getLodLevel()];
+    }
+
+    if (overlayVisible)
+        updateOverlay(counts);
+}
+
+/**
+ * @brief LodManager::levelsReady
+ * @param mesh The mesh the levels were built from.
+ * @param levels The levels, coarsest last, or none if decimation failed.
+ * @param cancelled The cancel flag of the job.
+ */
+void LodManager::levelsReady(const vtkSmartPointer<vtkPolyData>& mesh, const QList<vtkSmartPointer<vtkPolyData>>& levels,
+                             const std::shared_ptr<std::atomic<bool>>& cancelled) {
+    if (cancelled->load())
+        return;
+
+    const QList<ModelPart*> parts = pending.take(mesh);
+    for (ModelPart* part : parts) {
+        if (levels.isEmpty()) {
+            partMeshes.remove(part);
+            part->setLodManager(nullptr);
+            continue;
+        }
+        part->setLodLevels(levels);
+        partsByMesh.insert(mesh, part);
+    }
+}
+
+/**
+ * @brief LodManager::buildLevels
+ * Each level is decimated from the full mesh rather than the previous level,
+ * which keeps the coarse levels closer to the original shape.
+ * @param mesh The mesh.
+ * @param reductions Fraction of the triangles to remove for each level.
+ * @param cache If not null, levels are taken from or added to this cache.
+ * @return The levels, or none if decimation failed.
+ */
+QList<vtkSmartPointer<vtkPolyData>> LodManager::buildLevels(vtkPolyData* mesh, const QList<double>& reductions,
+                                                            GeometryCache* cache) {
+    /* The decimation builds cell links on its input, so it gets its own
+     * object rather than the one being rendered */
+    vtkNew<vtkPolyData> input;
+    input->ShallowCopy(mesh);
+
+    const QString key = cache ? meshKey(input) : QString();
+
+    QList<vtkSmartPointer<vtkPolyData>> levels;
+    for (double reduction : reductions) {
+        const QString levelKey = key + QString("_lod%1").arg(reduction);
+        vtkSmartPointer<vtkPolyData> level = cache ? cache->find(levelKey) : nullptr;
+
+        if (!level) {
+            vtkNew<vtkQuadricDecimation> decimate;
+            decimate->SetInputData(input);
+            decimate->SetTargetReduction(reduction);
+            decimate->VolumePreservationOn();
+            decimate->Update();
+
+            level = vtkSmartPointer<vtkPolyData>::New();
+            level->ShallowCopy(decimate->GetOutput());
+            if (level->GetNumberOfPolys() == 0)
+                return {};
+
+            MeshFile::addNormals(level);
+            if (cache)
+                cache->store(levelKey, level, WeldStats());
+        }
+        levels.append(level);
+    }
+    return levels;
+}
+
+/**
+ * @brief LodManager::onStartRender
+ */
+void LodManager::onStartRender(vtkObject*, unsigned long, void*) {
+    update();
+}
+
+/**
+ * @brief LodManager::updateOverlay
+ * @param counts Number of visible parts drawn at each level.
+ */
+void LodManager::updateOverlay(const int counts[maxLevels + 1]) {
+    QString text = "LOD";
+    for (int level = 0; level <= pixelThresholds.size(); ++level)
+        text += QString("  L%1: %2").arg(level).arg(counts[level]);
+    overlayText->SetInput(text.toUtf8().constData());
+
+    for (auto it = partsByMesh.constBegin(); it != partsByMesh.constEnd(); ++it) {
+        ModelPart* part = it.value();
+        vtkActor* actor = part->getActor();
+        const bool shown = actor && actor->GetVisibility();
+
+        vtkSmartPointer<vtkBillboardTextActor3D>& label = labels[part];
+        if (!label) {
+            label = vtkSmartPointer<vtkBillboardTextActor3D>::New();
+            label->GetTextProperty()->SetFontSize(14);
+            label->GetTextProperty()->SetColor(0.8, 0.0, 0.0);
+            label->GetTextProperty()->SetJustificationToCentered();
+            renderer->AddActor(label);
+        }
+
+        label->SetVisibility(shown);
+        if (!shown)
+            continue;
+
+        double bounds[6];
+        actor->GetBounds(bounds);
+        label->SetPosition((bounds[0] + bounds[1]) / 2.0, (bounds[2] + bounds[3]) / 2.0, (bounds[4] + bounds[5]) / 2.0);
+        label->SetInput(QString("L%1").arg(part->getLodLevel()).toUtf8().constData());
+    }
+}
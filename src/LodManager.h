@@ -0,0 +1,160 @@
+/** @file LodManager.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Background generation of decimated part levels and per-frame level selection
+  */
+
+#ifndef VIEWER_LODMANAGER_H
+#define VIEWER_LODMANAGER_H
+
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QObject>
+#include <QSet>
+#include <QThreadPool>
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include <atomic>
+#include <memory>
+
+class GeometryCache;
+class ModelPart;
+class vtkBillboardTextActor3D;
+class vtkObject;
+class vtkRenderer;
+class vtkTextActor;
+
+/**
+ * @class LodManager
+ * @brief Gives parts decimated levels of detail and picks one per part each frame.
+ *
+ * Once a part has its geometry, addPart() queues a job that builds its levels
+ * with vtkQuadricDecimation on a worker thread, or maps them from the
+ * GeometryCache if the same mesh has been decimated before. Parts sharing a
+ * mesh share one job and one set of levels.
+ *
+ * Before every render the projected size of each part's bounding sphere is
+ * compared with the thresholds, in pixels, and the part draws the coarsest
+ * level whose threshold its size is still under. With thresholds of 400, 150
+ * and 50 a part over 400 pixels across is drawn in full and one under 50 uses
+ * the third level. The number of thresholds, 2 to 4, sets the number of
+ * levels built for parts loaded afterwards.
+ *
+ * The debug overlay labels every part with its level and counts the parts
+ * drawn at each level.
+ */
+class LodManager : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @brief Most levels a part can have, not counting its full geometry.
+     */
+    static const int maxLevels = 4;
+
+    /**
+     * @brief Constructor for the LodManager class.
+     * @param renderer The renderer whose camera picks the levels.
+     * @param parent The parent object.
+     */
+    explicit LodManager(vtkRenderer* renderer, QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor, cancels outstanding jobs and waits for running ones.
+     */
+    ~LodManager();
+
+    /**
+     * @brief Sets the cache the levels are stored in and mapped from.
+     * @param cache The cache, or nullptr for none. Must outlive the manager.
+     */
+    void setCache(GeometryCache* cache);
+
+    /**
+     * @brief Builds levels for a part that has just been given its geometry.
+     * @param part The part. Meshes too small to be worth decimating are skipped.
+     */
+    void addPart(ModelPart* part);
+
+    /**
+     * @brief Forgets a part, e.g. when it is deleted or its geometry is replaced.
+     * @param part The part.
+     */
+    void removePart(ModelPart* part);
+
+    /**
+     * @brief Cancels every job and forgets every part, e.g. when the tree is replaced.
+     */
+    void clear();
+
+    /**
+     * @brief Sets the projected sizes, in pixels, below which each level is used.
+     * @param pixels 2 to 4 sizes, largest first.
+     * @return False if the thresholds are not valid.
+     */
+    bool setThresholds(const QList<double>& pixels);
+
+    /**
+     * @brief Returns the projected sizes below which each level is used.
+     */
+    QList<double> thresholds() const;
+
+    /**
+     * @brief Draws every part this many levels coarser than its size calls for.
+     * @param levels 0 for the normal levels, e.g. more while the camera is moving.
+     */
+    void setLevelBias(int levels);
+
+    /**
+     * @brief Shows or hides the debug overlay.
+     * @param visible True to label each part with its level.
+     */
+    void setOverlayVisible(bool visible);
+
+    /**
+     * @brief Picks every part's level from its projected size. Called before each render.
+     */
+    void update();
+
+
+private:
+    /**
+     * @brief Called on the GUI thread when the levels of a mesh have been built.
+     */
+    void levelsReady(const vtkSmartPointer<vtkPolyData>& mesh, const QList<vtkSmartPointer<vtkPolyData>>& levels,
+                     const std::shared_ptr<std::atomic<bool>>& cancelled);
+
+    /**
+     * @brief Builds the levels of a mesh. Runs on a worker thread.
+     */
+    static QList<vtkSmartPointer<vtkPolyData>> buildLevels(vtkPolyData* mesh, const QList<double>& reductions,
+                                                           GeometryCache* cache);
+
+    /**
+     * @brief Renderer StartEvent callback.
+     */
+    void onStartRender(vtkObject* caller, unsigned long event, void* callData);
+
+    /**
+     * @brief Updates the overlay's labels and counts.
+     */
+    void updateOverlay(const int counts[maxLevels + 1]);
+
+    vtkRenderer*                                renderer;       /**< Renderer whose camera picks the levels */
+    unsigned long                               observer;       /**< StartEvent observer tag */
+    GeometryCache*                              cache;          /**< Cache for the levels, may be null */
+    QThreadPool                                 pool;           /**< Decimation workers */
+    std::shared_ptr<std::atomic<bool>>          cancelFlag;     /**< Cancel flag shared with the current jobs */
+    QList<double>                               pixelThresholds; /**< Projected sizes below which each level is used */
+    int                                         levelBias;      /**< Extra levels every part is coarsened by */
+    QHash<vtkPolyData*, QList<ModelPart*>>      pending;        /**< Parts waiting for the levels of each mesh, the jobs keep the meshes alive */
+    QMultiHash<vtkPolyData*, ModelPart*>        partsByMesh;    /**< Parts with levels, by the mesh they were built from */
+    QHash<ModelPart*, vtkPolyData*>             partMeshes;     /**< Mesh each part's levels were built from */
+    bool                                        overlayVisible; /**< True while the debug overlay is shown */
+    vtkSmartPointer<vtkTextActor>               overlayText;    /**< Parts drawn at each level */
+    QHash<ModelPart*, vtkSmartPointer<vtkBillboardTextActor3D>> labels; /**< Level label of each part */
+};
+
+#endif
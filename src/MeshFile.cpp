@@ -0,0 +1,397 @@
+/**
+  * @file MeshFile.cpp
+  * @brief Implementation of the MeshFile class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "MeshFile.h"
+
+#include <QFile>
+#include <QHash>
+#include <QIODevice>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <vtkCellArray.h>
+#include <vtkCellArrayIterator.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const char meshMagic[8] = { 'F', 'S', 'M', 'E', 'S', 'H', '\0', '\0' };
+const quint32 meshVersion = 1;
+
+/**
+ * @brief Fixed size header at the start of every mesh blob.
+ */
+struct MeshHeader {
+    char        magic[8];
+    quint32     version;
+    quint32     reserved;
+    qint64      numPoints;
+    qint64      numTriangles;
+    qint64      inputVertices;
+    qint64      bytesSaved;
+    qint64      blobSize;
+    qint64      padding;
+};
+static_assert(sizeof(MeshHeader) == 64, "MeshHeader must stay 64 bytes");
+
+/**
+ * @brief Byte offsets of the arrays within a blob.
+ */
+struct MeshLayout {
+    qint64      points;
+    qint64      normals;
+    qint64      offsets;
+    qint64      connectivity;
+    qint64      size;
+};
+
+inline qint64 align8(qint64 x) {
+    return (x + 7) & ~qint64(7);
+}
+
+MeshLayout layoutFor(qint64 numPoints, qint64 numTriangles) {
+    MeshLayout layout;
+    layout.points       = sizeof(MeshHeader);
+    layout.normals      = align8(layout.points + numPoints * 3 * qint64(sizeof(float)));
+    layout.offsets      = align8(layout.normals + numPoints * 3 * qint64(sizeof(float)));
+    layout.connectivity = align8(layout.offsets + (numTriangles + 1) * qint64(sizeof(qint32)));
+    layout.size         = align8(layout.connectivity + numTriangles * 3 * qint64(sizeof(qint32)));
+    return layout;
+}
+
+/* Mapped arrays are released through a plain function pointer, so the file
+ * each array was mapped from is looked up here by the array's address */
+QMutex mappingMutex;
+QHash<const void*, std::shared_ptr<QFile>> mappings;
+
+/* Files such as projects are shared by several parts' loader threads, and
+ * QFile's seek, read and map are not thread safe */
+QMutex fileMutex;
+
+void releaseMapping(void* array) {
+    std::shared_ptr<QFile> file;
+    {
+        QMutexLocker lock(&mappingMutex);
+        file = mappings.take(array);
+    }
+    // The file, and with it the mapping, is closed here if this was its last array
+}
+
+/**
+ * @brief Checks that a header's counts are ones write() could have stored,
+ * so that the layout computed from them cannot overflow.
+ */
+bool validCounts(const MeshHeader& header) {
+    return header.numPoints >= 0 && header.numPoints <= std::numeric_limits<qint32>::max()
+        && header.numTriangles >= 0 && header.numTriangles <= std::numeric_limits<qint32>::max() / 3;
+}
+
+/**
+ * @brief Checks that a mapped blob's offsets are 0, 3, 6, ... and that every
+ * connectivity id is a point of the mesh, so VTK never reads past the mapping.
+ */
+bool validTriangles(const uchar* data, const MeshLayout& layout, const MeshHeader& header) {
+    const qint32* offsets = reinterpret_cast<const qint32*>(data + layout.offsets);
+    const qint32* ids = reinterpret_cast<const qint32*>(data + layout.connectivity);
+    const qint32 numPoints = static_cast<qint32>(header.numPoints);
+
+    std::atomic<bool> valid(offsets[header.numTriangles] == 3 * header.numTriangles);
+    vtkSMPTools::For(0, header.numTriangles, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end && valid.load(std::memory_order_relaxed); ++i) {
+            if (offsets[i] != 3 * i
+                    || quint32(ids[3 * i]) >= quint32(numPoints)
+                    || quint32(ids[3 * i + 1]) >= quint32(numPoints)
+                    || quint32(ids[3 * i + 2]) >= quint32(numPoints))
+                valid = false;
+        }
+    });
+    return valid;
+}
+
+/**
+ * @brief Wraps mapped memory in a VTK array that keeps the mapping alive.
+ */
+template <typename ArrayType>
+vtkSmartPointer<ArrayType> wrapMapped(const std::shared_ptr<QFile>& file, uchar* data,
+                                      vtkIdType numTuples, int numComponents) {
+    using ValueType = typename ArrayType::ValueType;
+    ValueType* values = reinterpret_cast<ValueType*>(data);
+
+    {
+        QMutexLocker lock(&mappingMutex);
+        mappings.insert(values, file);
+    }
+
+    vtkSmartPointer<ArrayType> array = vtkSmartPointer<ArrayType>::New();
+    array->SetNumberOfComponents(numComponents);
+    array->SetArray(values, numTuples * numComponents, 0, ArrayType::VTK_DATA_ARRAY_USER_DEFINED);
+    array->SetArrayFreeFunction(releaseMapping);
+    return array;
+}
+
+} // namespace
+
+/**
+ * @brief MeshFile::write
+ * Writes the header and each array in turn, converting the connectivity to
+ * 32 bits in fixed size chunks so that no full copy of the mesh is made.
+ * @param device The device to write to, positioned at an 8 byte aligned offset.
+ * @param polyData The mesh to write.
+ * @param stats Welding statistics stored with the mesh.
+ * @return The number of bytes written, or -1 on failure.
+ */
+qint64 MeshFile::write(QIODevice& device, vtkPolyData* polyData, const WeldStats& stats) {
+    vtkCellArray* polys = polyData->GetPolys();
+    vtkFloatArray* points = polyData->GetPoints()
+        ? vtkFloatArray::SafeDownCast(polyData->GetPoints()->GetData()) : nullptr;
+    vtkFloatArray* normals = vtkFloatArray::SafeDownCast(polyData->GetPointData()->GetNormals());
+
+    if (!polys || !points || !normals || polys->IsHomogeneous() != 3)
+        return -1;
+
+    const qint64 numPoints = points->GetNumberOfTuples();
+    const qint64 numTriangles = polys->GetNumberOfCells();
+    if (numPoints > std::numeric_limits<qint32>::max() || 3 * numTriangles > std::numeric_limits<qint32>::max())
+        return -1;
+
+    const MeshLayout layout = layoutFor(numPoints, numTriangles);
+
+    MeshHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, meshMagic, sizeof(meshMagic));
+    header.version = meshVersion;
+    header.numPoints = numPoints;
+    header.numTriangles = numTriangles;
+    header.inputVertices = stats.inputVertices;
+    header.bytesSaved = stats.bytesSaved;
+    header.blobSize = layout.size;
+
+    qint64 written = 0;
+    auto writeBytes = [&](const void* data, qint64 size) {
+        if (device.write(static_cast<const char*>(data), size) != size)
+            return false;
+        written += size;
+        return true;
+    };
+    auto padTo = [&](qint64 offset) {
+        static const char zeros[8] = {};
+        return writeBytes(zeros, offset - written);
+    };
+
+    if (!writeBytes(&header, sizeof(header))
+            || !writeBytes(points->GetPointer(0), numPoints * 3 * sizeof(float))
+            || !padTo(layout.normals)
+            || !writeBytes(normals->GetPointer(0), numPoints * 3 * sizeof(float))
+            || !padTo(layout.offsets))
+        return -1;
+
+    const vtkIdType chunkSize = 1 << 16;
+    std::vector<qint32> buffer(chunkSize);
+
+    for (vtkIdType begin = 0; begin <= numTriangles; begin += chunkSize) {
+        const vtkIdType end = std::min<vtkIdType>(begin + chunkSize, numTriangles + 1);
+        for (vtkIdType i = begin; i < end; ++i)
+            buffer[i - begin] = static_cast<qint32>(3 * i);
+        if (!writeBytes(buffer.data(), (end - begin) * sizeof(qint32)))
+            return -1;
+    }
+    if (!padTo(layout.connectivity))
+        return -1;
+
+    const vtkIdType numIds = 3 * numTriangles;
+    for (vtkIdType begin = 0; begin < numIds; begin += chunkSize) {
+        const vtkIdType end = std::min<vtkIdType>(begin + chunkSize, numIds);
+        if (polys->IsStorage64Bit()) {
+            const vtkTypeInt64* ids = polys->GetConnectivityArray64()->GetPointer(0);
+            for (vtkIdType i = begin; i < end; ++i)
+                buffer[i - begin] = static_cast<qint32>(ids[i]);
+        } else {
+            const vtkTypeInt32* ids = polys->GetConnectivityArray32()->GetPointer(0);
+            std::memcpy(buffer.data(), ids + begin, (end - begin) * sizeof(qint32));
+        }
+        if (!writeBytes(buffer.data(), (end - begin) * sizeof(qint32)))
+            return -1;
+    }
+    if (!padTo(layout.size))
+        return -1;
+
+    return written;
+}
+
+/**
+ * @brief MeshFile::write
+ * Writes the mesh through a QSaveFile so a partly written file is never left behind.
+ * @param fileName The file to write.
+ * @param polyData The mesh to write.
+ * @param stats Welding statistics stored with the mesh.
+ * @return True on success.
+ */
+bool MeshFile::write(const QString& fileName, vtkPolyData* polyData, const WeldStats& stats) {
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    if (write(file, polyData, stats) < 0) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+/**
+ * @brief MeshFile::map
+ * Checks the blob's header, the sizes of its arrays and its triangles, then
+ * wraps each of its arrays in the matching VTK array.
+ * @param file The file, open for reading.
+ * @param offset Offset of the blob in the file, 8 byte aligned.
+ * @param stats If not null, receives the stored welding statistics.
+ * @return The mesh, or a null pointer if the blob is invalid.
+ */
+vtkSmartPointer<vtkPolyData> MeshFile::map(const std::shared_ptr<QFile>& file, qint64 offset, WeldStats* stats) {
+    MeshHeader header;
+    MeshLayout layout;
+    uchar* data;
+    {
+        QMutexLocker lock(&fileMutex);
+        if (!file->seek(offset) || file->read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+            return nullptr;
+
+        if (std::memcmp(header.magic, meshMagic, sizeof(meshMagic)) != 0 || header.version != meshVersion)
+            return nullptr;
+
+        if (offset < 0 || offset % 8 != 0 || !validCounts(header))
+            return nullptr;
+
+        layout = layoutFor(header.numPoints, header.numTriangles);
+        if (header.blobSize != layout.size || layout.size > file->size() - offset)
+            return nullptr;
+
+        /* A private mapping means nothing done to the arrays can ever reach the file */
+        data = file->map(offset, layout.size, QFileDevice::MapPrivateOption);
+        if (!data)
+            return nullptr;
+    }
+
+    /* A truncated cache entry or a damaged project must be reloaded from its STL file, not drawn */
+    if (!validTriangles(data, layout, header)) {
+        QMutexLocker lock(&fileMutex);
+        file->unmap(data);
+        return nullptr;
+    }
+
+    vtkNew<vtkPoints> points;
+    points->SetData(wrapMapped<vtkFloatArray>(file, data + layout.points, header.numPoints, 3));
+
+    vtkSmartPointer<vtkFloatArray> normals = wrapMapped<vtkFloatArray>(file, data + layout.normals, header.numPoints, 3);
+    normals->SetName("Normals");
+
+    vtkNew<vtkCellArray> polys;
+    polys->SetData(wrapMapped<vtkTypeInt32Array>(file, data + layout.offsets, header.numTriangles + 1, 1),
+                   wrapMapped<vtkTypeInt32Array>(file, data + layout.connectivity, 3 * header.numTriangles, 1));
+
+    vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
+    polyData->SetPoints(points);
+    polyData->SetPolys(polys);
+    polyData->GetPointData()->SetNormals(normals);
+
+    if (stats) {
+        stats->inputVertices = header.inputVertices;
+        stats->outputPoints = header.numPoints;
+        stats->bytesSaved = header.bytesSaved;
+    }
+
+    return polyData;
+}
+
+/**
+ * @brief MeshFile::map
+ * @param fileName The file to map.
+ * @param stats If not null, receives the stored welding statistics.
+ * @return The mesh, or a null pointer if the file is missing or invalid.
+ */
+vtkSmartPointer<vtkPolyData> MeshFile::map(const QString& fileName, WeldStats* stats) {
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly))
+        return nullptr;
+
+    return map(file, 0, stats);
+}
+
+/**
+ * @brief MeshFile::addNormals
+ * Sums each triangle's area weighted normal into its three points, then
+ * normalises the sums in parallel.
+ * @param polyData The mesh.
+ */
+void MeshFile::addNormals(vtkPolyData* polyData) {
+    vtkPoints* points = polyData->GetPoints();
+    vtkCellArray* polys = polyData->GetPolys();
+    if (!points || !polys)
+        return;
+
+    const vtkIdType numPoints = points->GetNumberOfPoints();
+
+    vtkNew<vtkFloatArray> normals;
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(numPoints);
+    normals->FillValue(0.0f);
+    float* n = normals->GetPointer(0);
+
+    auto iter = vtk::TakeSmartPointer(polys->NewIterator());
+    for (iter->GoToFirstCell(); !iter->IsDoneWithTraversal(); iter->GoToNextCell()) {
+        vtkIdType cellSize;
+        const vtkIdType* ids;
+        iter->GetCurrentCell(cellSize, ids);
+        if (cellSize != 3)
+            continue;
+
+        double a[3], b[3], c[3];
+        points->GetPoint(ids[0], a);
+        points->GetPoint(ids[1], b);
+        points->GetPoint(ids[2], c);
+
+        const double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        const float face[3] = { static_cast<float>(u[1] * v[2] - u[2] * v[1]),
+                                static_cast<float>(u[2] * v[0] - u[0] * v[2]),
+                                static_cast<float>(u[0] * v[1] - u[1] * v[0]) };
+
+        for (int corner = 0; corner < 3; ++corner)
+            for (int i = 0; i < 3; ++i)
+                n[3 * ids[corner] + i] += face[i];
+    }
+
+    vtkSMPTools::For(0, numPoints, [n](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType p = begin; p < end; ++p) {
+            float* normal = n + 3 * p;
+            const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 0.0f) {
+                normal[0] /= length;
+                normal[1] /= length;
+                normal[2] /= length;
+            }
+        }
+    });
+
+    polyData->GetPointData()->SetNormals(normals);
+}
@@ -0,0 +1,80 @@
+/** @file MeshFile.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Compact binary mesh layout that can be memory mapped straight into VTK arrays
+  */
+
+#ifndef VIEWER_MESHFILE_H
+#define VIEWER_MESHFILE_H
+
+#include "MeshWelder.h"
+
+#include <QString>
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include <memory>
+
+class QFile;
+class QIODevice;
+
+/**
+ * @class MeshFile
+ * @brief Reads and writes processed triangle meshes in a mappable binary layout.
+ *
+ * A mesh blob is a 64 byte header followed by float point coordinates, float
+ * point normals, 32 bit cell offsets and 32 bit triangle connectivity, each
+ * aligned to 8 bytes. Every array is stored exactly as VTK holds it in memory,
+ * so mapping a blob wraps the mapped memory in VTK arrays without copying or
+ * parsing anything. The mapping stays alive until the last array using it is
+ * deleted.
+ */
+class MeshFile {
+public:
+    /**
+     * @brief Writes a mesh blob at the device's current position.
+     *
+     * The mesh must be made of triangles, with float points and point normals.
+     * @param device The device to write to, positioned at an 8 byte aligned offset.
+     * @param polyData The mesh to write.
+     * @param stats Welding statistics stored with the mesh.
+     * @return The number of bytes written, or -1 on failure.
+     */
+    static qint64 write(QIODevice& device, vtkPolyData* polyData, const WeldStats& stats);
+
+    /**
+     * @brief Writes a mesh to its own file, replacing it atomically.
+     * @param fileName The file to write.
+     * @param polyData The mesh to write.
+     * @param stats Welding statistics stored with the mesh.
+     * @return True on success.
+     */
+    static bool write(const QString& fileName, vtkPolyData* polyData, const WeldStats& stats);
+
+    /**
+     * @brief Maps a mesh blob from an open file. Safe to call from any thread.
+     * @param file The file, open for reading. Shared with the arrays that use the mapping.
+     * @param offset Offset of the blob in the file, 8 byte aligned.
+     * @param stats If not null, receives the stored welding statistics.
+     * @return The mesh, or a null pointer if the blob is invalid.
+     */
+    static vtkSmartPointer<vtkPolyData> map(const std::shared_ptr<QFile>& file, qint64 offset,
+                                            WeldStats* stats = nullptr);
+
+    /**
+     * @brief Maps a mesh file written by write(). Safe to call from any thread.
+     * @param fileName The file to map.
+     * @param stats If not null, receives the stored welding statistics.
+     * @return The mesh, or a null pointer if the file is missing or invalid.
+     */
+    static vtkSmartPointer<vtkPolyData> map(const QString& fileName, WeldStats* stats = nullptr);
+
+    /**
+     * @brief Adds area weighted point normals to a triangle mesh.
+     * @param polyData The mesh.
+     */
+    static void addNormals(vtkPolyData* polyData);
+};
+
+#endif
@@ -0,0 +1,243 @@
+/**
+  * @file MeshWelder.cpp
+  * @brief Implementation of the MeshWelder class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "MeshWelder.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const qint64 vertexBytes = 3 * sizeof(float);
+const int shardBits = 8;                      /**< Top hash bits used to pick a shard */
+const int numShards = 1 << shardBits;
+const int numBlocks = 64;                     /**< Contiguous vertex ranges counted in parallel when bucketing */
+
+/**
+ * @brief Grid cell, or exact bit pattern, identifying a welded vertex.
+ */
+struct WeldKey {
+    qint64 c[3];
+
+    bool operator==(const WeldKey& other) const {
+        return c[0] == other.c[0] && c[1] == other.c[1] && c[2] == other.c[2];
+    }
+};
+
+/**
+ * @brief Returns the bit pattern of a float, treating -0 and +0 as the same value.
+ */
+inline qint64 floatBits(float value) {
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits == 0x80000000u) ? 0 : bits;
+}
+
+/**
+ * @brief Mixes the three key components into a 32 bit hash.
+ */
+inline quint32 hashKey(const WeldKey& key) {
+    quint64 h = 0x9E3779B97F4A7C15ull;
+    for (qint64 c : key.c)
+        h ^= static_cast<quint64>(c) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return static_cast<quint32>(h);
+}
+
+inline int shardOf(quint32 hash) {
+    return static_cast<int>(hash >> (32 - shardBits));
+}
+
+} // namespace
+
+/**
+ * @brief MeshWelder::weld
+ * Welds the soup in five passes, all but the last two in parallel:
+ * hash every vertex, bucket vertices by shard, weld each shard with an open
+ * addressing table, number the welded points in order of first use (so that
+ * triangles reference nearby points), then drop triangles that collapsed.
+ * @param source The triangle soup.
+ * @param tolerance Grid spacing for welding, 0 to weld identical vertices only.
+ * @param stats If not null, receives the vertex counts and memory saved.
+ * @return The indexed mesh, or a null pointer if no non-degenerate triangles remain.
+ */
+vtkSmartPointer<vtkPolyData> MeshWelder::weld(const VertexSource& source, double tolerance, WeldStats* stats) {
+    const vtkIdType numVertices = source.numTriangles * 3;
+    if (numVertices == 0)
+        return nullptr;
+
+    auto vertexAt = [&source](vtkIdType v, float* xyz) {
+        std::memcpy(xyz, source.base + (v / 3) * source.triangleStride + (v % 3) * vertexBytes, vertexBytes);
+    };
+
+    const double scale = (tolerance > 0.0) ? 1.0 / tolerance : 0.0;
+    auto keyOf = [&](vtkIdType v) {
+        float xyz[3];
+        vertexAt(v, xyz);
+        WeldKey key;
+        for (int i = 0; i < 3; ++i)
+            key.c[i] = (scale > 0.0) ? static_cast<qint64>(std::floor(xyz[i] * scale)) : floatBits(xyz[i]);
+        return key;
+    };
+
+    /* 1. Hash every vertex */
+    std::vector<quint32> hashes(numVertices);
+    vtkSMPTools::For(0, numVertices, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType v = begin; v < end; ++v)
+            hashes[v] = hashKey(keyOf(v));
+    });
+
+    /* 2. Bucket vertices by shard, keeping their original order within each shard */
+    auto blockBegin = [numVertices](vtkIdType block) { return numVertices * block / numBlocks; };
+
+    std::vector<vtkIdType> cursor(numBlocks * numShards, 0);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType b = first; b < last; ++b)
+            for (vtkIdType v = blockBegin(b); v < blockBegin(b + 1); ++v)
+                ++cursor[b * numShards + shardOf(hashes[v])];
+    });
+
+    std::vector<vtkIdType> shardStart(numShards + 1);
+    vtkIdType position = 0;
+    for (int s = 0; s < numShards; ++s) {
+        shardStart[s] = position;
+        for (int b = 0; b < numBlocks; ++b) {
+            const vtkIdType count = cursor[b * numShards + s];
+            cursor[b * numShards + s] = position;
+            position += count;
+        }
+    }
+    shardStart[numShards] = position;
+
+    std::vector<vtkIdType> bucketed(numVertices);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType b = first; b < last; ++b)
+            for (vtkIdType v = blockBegin(b); v < blockBegin(b + 1); ++v)
+                bucketed[cursor[b * numShards + shardOf(hashes[v])]++] = v;
+    });
+    std::vector<vtkIdType>().swap(cursor);
+
+    /* 3. Weld each shard. localId maps a vertex to its point within the shard,
+     * and representatives holds the first vertex of each of the shard's points */
+    std::vector<vtkIdType> localId(numVertices);
+    std::vector<std::vector<vtkIdType>> representatives(numShards);
+    vtkSMPTools::For(0, numShards, 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType s = first; s < last; ++s) {
+            const vtkIdType count = shardStart[s + 1] - shardStart[s];
+            size_t capacity = 16;
+            while (capacity < static_cast<size_t>(2 * count))
+                capacity *= 2;
+            const size_t mask = capacity - 1;
+
+            std::vector<vtkIdType> table(capacity, -1);
+            std::vector<vtkIdType>& points = representatives[s];
+            points.reserve(count / 4);
+
+            for (vtkIdType i = shardStart[s]; i < shardStart[s + 1]; ++i) {
+                const vtkIdType v = bucketed[i];
+                const WeldKey key = keyOf(v);
+
+                /* The top bits picked the shard, so probe using the rest */
+                size_t slot = (hashes[v] * 0x9E3779B1u) & mask;
+                for (;;) {
+                    const vtkIdType id = table[slot];
+                    if (id < 0) {
+                        table[slot] = localId[v] = static_cast<vtkIdType>(points.size());
+                        points.push_back(v);
+                        break;
+                    }
+                    if (keyOf(points[id]) == key) {
+                        localId[v] = id;
+                        break;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+            }
+        }
+    });
+    std::vector<vtkIdType>().swap(bucketed);
+
+    std::vector<vtkIdType> shardBase(numShards + 1, 0);
+    for (int s = 0; s < numShards; ++s)
+        shardBase[s + 1] = shardBase[s] + static_cast<vtkIdType>(representatives[s].size());
+    const vtkIdType numPoints = shardBase[numShards];
+
+    vtkNew<vtkIdTypeArray> connectivity;
+    connectivity->SetNumberOfValues(numVertices);
+    vtkIdType* ids = connectivity->GetPointer(0);
+    vtkSMPTools::For(0, numVertices, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType v = begin; v < end; ++v)
+            ids[v] = shardBase[shardOf(hashes[v])] + localId[v];
+    });
+    std::vector<quint32>().swap(hashes);
+    std::vector<vtkIdType>().swap(localId);
+
+    /* 4. Number points in order of first use */
+    std::vector<vtkIdType> renumber(numPoints, -1);
+    vtkIdType next = 0;
+    for (vtkIdType v = 0; v < numVertices; ++v) {
+        vtkIdType& id = renumber[ids[v]];
+        if (id < 0)
+            id = next++;
+        ids[v] = id;
+    }
+
+    vtkNew<vtkFloatArray> coords;
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(numPoints);
+    float* pointData = coords->GetPointer(0);
+    vtkSMPTools::For(0, numShards, 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType s = first; s < last; ++s) {
+            const std::vector<vtkIdType>& points = representatives[s];
+            for (size_t i = 0; i < points.size(); ++i)
+                vertexAt(points[i], pointData + 3 * renumber[shardBase[s] + i]);
+        }
+    });
+
+    /* 5. Drop triangles that collapsed onto fewer than three points */
+    vtkIdType kept = 0;
+    for (vtkIdType t = 0; t < numVertices; t += 3) {
+        if (ids[t] == ids[t + 1] || ids[t + 1] == ids[t + 2] || ids[t] == ids[t + 2])
+            continue;
+        ids[kept++] = ids[t];
+        ids[kept++] = ids[t + 1];
+        ids[kept++] = ids[t + 2];
+    }
+    if (kept == 0)
+        return nullptr;
+    connectivity->Resize(kept);
+
+    if (stats) {
+        stats->inputVertices = numVertices;
+        stats->outputPoints = numPoints;
+        stats->bytesSaved = (numVertices - numPoints) * vertexBytes;
+    }
+
+    vtkNew<vtkPoints> pts;
+    pts->SetData(coords);
+
+    vtkNew<vtkCellArray> polys;
+    polys->SetData(3, connectivity);
+
+    vtkSmartPointer<vtkPolyData> polyData = vtkSmartPointer<vtkPolyData>::New();
+    polyData->SetPoints(pts);
+    polyData->SetPolys(polys);
+    return polyData;
+}
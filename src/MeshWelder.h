@@ -0,0 +1,62 @@
+/** @file MeshWelder.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Import stage that welds the independent vertices of STL triangles into an indexed mesh
+  */
+
+#ifndef VIEWER_MESHWELDER_H
+#define VIEWER_MESHWELDER_H
+
+#include <QtGlobal>
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+/**
+ * @struct VertexSource
+ * @brief Describes where the vertices of a triangle soup are in memory.
+ *
+ * Triangle t's vertices are the 3 consecutive float triples starting at
+ * base + t * triangleStride. Neither the base nor the stride need to be
+ * aligned, so a mapped binary STL file can be welded without copying it.
+ */
+struct VertexSource {
+    const uchar*                                base = nullptr;     /**< First vertex of the first triangle */
+    qint64                                      triangleStride = 0; /**< Bytes from one triangle's first vertex to the next */
+    vtkIdType                                   numTriangles = 0;   /**< Number of triangles */
+};
+
+/**
+ * @struct WeldStats
+ * @brief Result of welding a part's vertices.
+ */
+struct WeldStats {
+    vtkIdType                                   inputVertices = 0;  /**< Vertices in the triangle soup (3 per triangle) */
+    vtkIdType                                   outputPoints = 0;   /**< Points left after welding */
+    qint64                                      bytesSaved = 0;     /**< Point memory saved compared to the soup */
+};
+
+/**
+ * @class MeshWelder
+ * @brief Welds coincident vertices of a triangle soup with a parallel hash table.
+ *
+ * Vertices are hashed and bucketed into shards in parallel, then each shard is
+ * welded with its own open addressing table, also in parallel. With a tolerance
+ * of 0 only bit-identical vertices are welded. Otherwise coordinates are
+ * snapped to a grid with the tolerance as its spacing, and vertices landing in
+ * the same grid cell are welded.
+ */
+class MeshWelder {
+public:
+    /**
+     * @brief Welds a triangle soup into an indexed triangle mesh. Safe to call from any thread.
+     * @param source The triangle soup.
+     * @param tolerance Grid spacing for welding, 0 to weld identical vertices only.
+     * @param stats If not null, receives the vertex counts and memory saved.
+     * @return The indexed mesh, or a null pointer if no non-degenerate triangles remain.
+     */
+    static vtkSmartPointer<vtkPolyData> weld(const VertexSource& source, double tolerance = 0.0,
+                                             WeldStats* stats = nullptr);
+};
+
+#endif
@@ -9,11 +9,32 @@
   */
 
 #include "ModelPart.h"
+#include "STLReader.h"
+#include "MeshFile.h"
+#include "PartInstancer.h"
+#include "LodManager.h"
+#include "OverviewBatch.h"
 #include <vtkProperty.h>
 #include <vtkShrinkPolyData.h>
 #include <vtkClipPolyData.h>
 #include <vtkPlane.h>
+#include <vtkNew.h>
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkImplicitBoolean.h>
 #include <vtkActor.h>
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkOpenGLPolyDataMapper.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkShaderProperty.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+#include <vtkUniforms.h>
 
 
 /* Commented out for now, will be uncommented later when you have
@@ -22,18 +43,104 @@
 #include <vtkSmartPointer.h>
 #include <vtkDataSetMapper.h>
 
+#include <algorithm>
 
 
+bool ModelPart::gpuShrinkEnabled = true;
+
+/**
+ * @brief explodeTriangles
+ * Copies a triangle mesh so that no two triangles share a point, and gives each
+ * point its triangle's centroid as the "Centroid" attribute used by the vertex
+ * shader shrink. Built once when the shrink is first switched on.
+ * @param mesh The triangle mesh, with optional point normals.
+ * @return The exploded mesh.
+ */
+static vtkSmartPointer<vtkPolyData> explodeTriangles(vtkPolyData* mesh) {
+    vtkPoints* points = mesh->GetPoints();
+    vtkCellArray* polys = mesh->GetPolys();
+    vtkDataArray* normals = mesh->GetPointData()->GetNormals();
+    const vtkIdType numTriangles = polys->GetNumberOfCells();
+    const vtkIdType numPoints = 3 * numTriangles;
+
+    vtkNew<vtkFloatArray> positions;
+    positions->SetNumberOfComponents(3);
+    positions->SetNumberOfTuples(numPoints);
+
+    vtkNew<vtkFloatArray> centroids;
+    centroids->SetName("Centroid");
+    centroids->SetNumberOfComponents(3);
+    centroids->SetNumberOfTuples(numPoints);
+
+    vtkNew<vtkFloatArray> pointNormals;
+    pointNormals->SetName("Normals");
+    pointNormals->SetNumberOfComponents(3);
+    pointNormals->SetNumberOfTuples(normals ? numPoints : 0);
+
+    vtkNew<vtkIdTypeArray> connectivity;
+    connectivity->SetNumberOfTuples(numPoints);
+
+    float* position = positions->GetPointer(0);
+    float* centroid = centroids->GetPointer(0);
+    float* normal = pointNormals->GetPointer(0);
+    vtkIdType* connection = connectivity->GetPointer(0);
+
+    vtkSMPThreadLocalObject<vtkIdList> cellPoints;
+    vtkSMPTools::For(0, numTriangles, [&](vtkIdType first, vtkIdType last) {
+        vtkIdList* ids = cellPoints.Local();
+        for (vtkIdType t = first; t < last; ++t) {
+            vtkIdType npts;
+            const vtkIdType* pts;
+            polys->GetCellAtId(t, npts, pts, ids);
+
+            double p[3][3];
+            for (int k = 0; k < 3; ++k)
+                points->GetPoint(pts[k], p[k]);
+
+            for (int k = 0; k < 3; ++k) {
+                const vtkIdType v = 3 * t + k;
+                connection[v] = v;
+                for (int j = 0; j < 3; ++j) {
+                    position[3 * v + j] = static_cast<float>(p[k][j]);
+                    centroid[3 * v + j] = static_cast<float>((p[0][j] + p[1][j] + p[2][j]) / 3.0);
+                }
+                if (normals) {
+                    double n[3];
+                    normals->GetTuple(pts[k], n);
+                    for (int j = 0; j < 3; ++j)
+                        normal[3 * v + j] = static_cast<float>(n[j]);
+                }
+            }
+        }
+    });
+
+    vtkNew<vtkPoints> explodedPoints;
+    explodedPoints->SetData(positions);
+
+    vtkNew<vtkCellArray> explodedPolys;
+    explodedPolys->SetData(3, connectivity);
+
+    vtkSmartPointer<vtkPolyData> exploded = vtkSmartPointer<vtkPolyData>::New();
+    exploded->SetPoints(explodedPoints);
+    exploded->SetPolys(explodedPolys);
+    exploded->GetPointData()->AddArray(centroids);
+    if (normals)
+        exploded->GetPointData()->SetNormals(pointNormals);
+    return exploded;
+}
 
 /**
  * @brief ModelPart::ModelPart
- * @param data The data for the model part.
+ * @param name The name shown in the tree.
  * @param parent The parent item.
  */
-ModelPart::ModelPart(const QList<QVariant>& data, ModelPart* parent )
-    : m_itemData(data), m_parentItem(parent) {
+ModelPart::ModelPart(const QString& name, ModelPart* parent )
+    : m_name(name), m_parentItem(parent), m_row(0), m_flags(Visible), record(-1), childrenPending(false), pendingShrinkFactor(-1.0),
+      shrinkOnGpu(false), shrinkActive(false), shrinkFactor(0.7), colour(qRgb(255, 255, 0)),
+      position{ 0.0, 0.0, 0.0 }, instancer(nullptr), drawnByInstancer(false), batch(nullptr), drawnByBatch(false), store(nullptr),
+      lodLevel(0), lodManager(nullptr), subtreeBoxValid(false) {
 
-    /* You probably want to give the item a default colour */
+    /* Parts default to visible and yellow until they are changed */
 }
 
 /**
@@ -41,6 +148,12 @@ ModelPart::ModelPart(const QList<QVariant>& data, ModelPart* parent )
  * Destructor for the ModelPart class.
  */
 ModelPart::~ModelPart() {
+    if (instancer)
+        instancer->removePart(this);
+    if (batch)
+        batch->removePart(this);
+    clearLodLevels();
+    releaseStoredSource();
     qDeleteAll(m_childItems);
 }
 
@@ -54,7 +167,145 @@ void ModelPart::appendChild( ModelPart* item ) {
      * (it will appear as a sub-branch in the treeview)
      */
     item->m_parentItem = this;
+    item->m_row = m_childItems.size();
     m_childItems.append(item);
+    invalidateBounds();
+}
+
+/**
+ * @brief ModelPart::insertChildren
+ * The items go in with one move of the later children, and each child's row
+ * is stored once, so inserting n items costs O(n + children) however many
+ * there are.
+ * @param row The row the first child is inserted at.
+ * @param items The child items to insert.
+ */
+void ModelPart::insertChildren(int row, const QList<ModelPart*>& items) {
+    if (items.isEmpty())
+        return;
+
+    row = qBound(0, row, int(m_childItems.size()));
+    for (ModelPart* item : items)
+        item->m_parentItem = this;
+    m_childItems.insert(row, items.size(), nullptr);
+    std::copy(items.cbegin(), items.cend(), m_childItems.begin() + row);
+    renumberChildren(row);
+    invalidateBounds();
+}
+
+/**
+ * @brief ModelPart::takeChildren
+ * @param row The row of the first child item.
+ * @param count The number of child items.
+ * @return The child items, now owned by the caller, or an empty list if the rows are invalid.
+ */
+QList<ModelPart*> ModelPart::takeChildren(int row, int count) {
+    if (row < 0 || count <= 0 || row + count > m_childItems.size())
+        return {};
+
+    QList<ModelPart*> items = m_childItems.mid(row, count);
+    m_childItems.remove(row, count);
+    for (ModelPart* item : items) {
+        item->m_parentItem = nullptr;
+        item->m_row = 0;
+    }
+    renumberChildren(row);
+    invalidateBounds();
+    return items;
+}
+
+/**
+ * @brief ModelPart::clearChildren
+ * Removes and deletes all children of this item.
+ */
+void ModelPart::clearChildren() {
+    qDeleteAll(m_childItems);
+    m_childItems.clear();
+    invalidateBounds();
+}
+
+/**
+ * @brief ModelPart::setRecord
+ * The records are kept for as long as the part, so that the part's record can
+ * still be found, e.g. by the part search, once its children have been made.
+ * @param records The records of the project the part came from.
+ * @param record The part's own record.
+ */
+void ModelPart::setRecord(std::shared_ptr<const PartRecords> records, qint32 record) {
+    this->records = std::move(records);
+    this->record = record;
+    childrenPending = this->records && this->records->childCount(record) > 0;
+}
+
+/**
+ * @brief ModelPart::getRecords
+ * @return The records, or nullptr.
+ */
+const PartRecords* ModelPart::getRecords() const {
+    return records.get();
+}
+
+/**
+ * @brief ModelPart::getRecord
+ * @return The record, or -1.
+ */
+qint32 ModelPart::getRecord() const {
+    return record;
+}
+
+/**
+ * @brief ModelPart::hasPendingChildren
+ * @return True if the part has children that haven't been made yet.
+ */
+bool ModelPart::hasPendingChildren() const {
+    return childrenPending;
+}
+
+/**
+ * @brief ModelPart::pendingChildrenVisible
+ * @return True if a part not yet made below this one is visible and has geometry to load.
+ */
+bool ModelPart::pendingChildrenVisible() const {
+    return childrenPending && records->hasVisibleGeometry(record);
+}
+
+/**
+ * @brief ModelPart::setPendingShrinkFactor
+ * The records are shared and can't hold the factor, so it is kept here and
+ * handed down as the branch is made.
+ * @param factor Fraction of its size each triangle keeps, 0 to 1.
+ */
+void ModelPart::setPendingShrinkFactor(double factor) {
+    pendingShrinkFactor = factor;
+}
+
+/**
+ * @brief ModelPart::createPendingChildren
+ * @return The new parts, owned by the caller.
+ */
+QList<ModelPart*> ModelPart::createPendingChildren() const {
+    if (!childrenPending)
+        return {};
+
+    QList<ModelPart*> parts = PartRecords::createChildren(records, record);
+    if (pendingShrinkFactor >= 0.0) {
+        for (ModelPart* part : parts) {
+            if (part->hasFlag(Shrink))
+                part->setShrinkFactor(pendingShrinkFactor);
+            part->setPendingShrinkFactor(pendingShrinkFactor);
+        }
+    }
+    return parts;
+}
+
+/**
+ * @brief ModelPart::takePendingChildren
+ * @return The new parts, owned by the caller.
+ */
+QList<ModelPart*> ModelPart::takePendingChildren() {
+    QList<ModelPart*> parts = createPendingChildren();
+    childrenPending = false;
+    return parts;
 }
 
 /**
@@ -83,46 +334,40 @@ int ModelPart::childCount() const {
 }
 
 /**
- * @brief ModelPart::columnCount
- * Returns the number of columns (properties) of this item.
- * @return The number of columns.
+ * @brief ModelPart::name
+ * @return The name shown in the tree.
  */
-int ModelPart::columnCount() const {
-    /* Count number of columns (properties) that this item has.
-     */
-    return m_itemData.count();
+const QString& ModelPart::name() const {
+    return m_name;
 }
 
 /**
- * @brief ModelPart::data
- * Returns the data associated with the specified column.
- * @param column The column index.
- * @return The data for the column, or a null QVariant if the column is invalid.
+ * @brief ModelPart::setName
+ * @param name The new name.
  */
-QVariant ModelPart::data(int column) const {
-    /* Return the data associated with a column of this item
-     * Note on the QVariant type - it is a generic placeholder type
-     * that can take on the type of most Qt classes. It allows each
-     * column or property to store data of an arbitrary type.
-     */
-    if (column < 0 || column >= m_itemData.size())
-        return QVariant();
-    return m_itemData.at(column);
+void ModelPart::setName(const QString& name) {
+    m_name = name;
 }
 
 /**
- * @brief ModelPart::set
- * Sets the data associated with the specified column.
- * @param column The column index.
- * @param value The data to set.
+ * @brief ModelPart::hasFlag
+ * @param flag The flag.
+ * @return True if the flag is set.
  */
-void ModelPart::set(int column, const QVariant &value) {
-    /* Set the data associated with a column of this item
-     */
-    if (column < 0 || column >= m_itemData.size())
-        return;
+bool ModelPart::hasFlag(Flag flag) const {
+    return m_flags & flag;
+}
 
-    m_itemData.replace(column, value);
+/**
+ * @brief ModelPart::setFlag
+ * @param flag The flag.
+ * @param on True to set the flag.
+ */
+void ModelPart::setFlag(Flag flag, bool on) {
+    if (on)
+        m_flags |= flag;
+    else
+        m_flags &= ~flag;
 }
 
 /**
@@ -140,11 +385,20 @@ ModelPart* ModelPart::parentItem() {
  * @return The row index.
  */
 int ModelPart::row() const {
-    /* Return the row index of this item, relative to it's parent.
+    /* Return the row index of this item, relative to it's parent. The row is
+     * stored rather than searched for, as the tree view asks for the parent
+     * of an index (and so its row) on every lookup.
      */
-    if (m_parentItem)
-        return m_parentItem->m_childItems.indexOf(const_cast<ModelPart*>(this));
-    return 0;
+    return m_row;
+}
+
+/**
+ * @brief ModelPart::renumberChildren
+ * @param first The first row whose child may have moved.
+ */
+void ModelPart::renumberChildren(int first) {
+    for (int i = first; i < m_childItems.size(); ++i)
+        m_childItems[i]->m_row = i;
 }
 
 /**
@@ -155,24 +409,11 @@ int ModelPart::row() const {
  * @param B The blue component of the color (0-255).
  */
 void ModelPart::setColour(const unsigned char R, const unsigned char G, const unsigned char B) {
+    colour = qRgb(R, G, B);
     if (actor) {
         actor->GetProperty()->SetColor(R / 255.0, G / 255.0, B / 255.0);
     }
-}
-
-/**
- * @brief ModelPart::propagateColour
- * Propagates the color to this item and all its children.
- * @param R The red component of the color (0-255).
- * @param G The green component of the color (0-255).
- * @param B The blue component of the color (0-255).
- */
-void ModelPart::propagateColour(unsigned char R, unsigned char G, unsigned char B) {
-    setColour(R, G, B);
-
-    for (ModelPart* child : m_childItems) {
-        child->propagateColour(R, G, B);
-    }
+    notifyChanged();
 }
 
 /**
@@ -180,11 +421,8 @@ void ModelPart::propagateColour(unsigned char R, unsigned char G, unsigned char
  * Returns the red component of the actor's color.
  * @return The red component of the color.
  */
-unsigned char ModelPart::getColourR() {
-    /* This is a placeholder function that you will need to modify if you want to use it */
-
-    /* As the name suggests ... */
-    return 0;   // needs updating
+unsigned char ModelPart::getColourR() const {
+    return qRed(colour);
 }
 
 /**
@@ -192,11 +430,8 @@ unsigned char ModelPart::getColourR() {
  * Returns the green component of the actor's color.
  * @return The green component of the color.
  */
-unsigned char ModelPart::getColourG() {
-    /* This is a placeholder function that you will need to modify if you want to use it */
-
-    /* As the name suggests ... */
-    return 0;   // needs updating
+unsigned char ModelPart::getColourG() const {
+    return qGreen(colour);
 }
 
 /**
@@ -204,11 +439,16 @@ unsigned char ModelPart::getColourG() {
  * Returns the blue component of the actor's color.
  * @return The blue component of the color.
  */
-unsigned char ModelPart::getColourB() {
-    /* This is a placeholder function that you will need to modify if you want to use it */
+unsigned char ModelPart::getColourB() const {
+    return qBlue(colour);
+}
 
-    /* As the name suggests ... */
-    return 0;   // needs updating
+/**
+ * @brief ModelPart::getColour
+ * @return The colour as an opaque QRgb.
+ */
+QRgb ModelPart::getColour() const {
+    return colour;
 }
 
 /**
@@ -217,10 +457,11 @@ unsigned char ModelPart::getColourB() {
  * @param visible True to show the actor, false to hide it.
  */
 void ModelPart::setVisible(bool visible) {
-    isVisible = visible;
+    setFlag(Visible, visible);
     if (actor) {
-        actor->SetVisibility(visible);
+        actor->SetVisibility(visible && !drawnByInstancer && !drawnByBatch);
     }
+    notifyChanged();
 }
 
 /**
@@ -228,8 +469,8 @@ void ModelPart::setVisible(bool visible) {
  * Returns the visibility status of the actor.
  * @return True if the actor is visible, false otherwise.
  */
-bool ModelPart::visible() {
-    return isVisible;
+bool ModelPart::visible() const {
+    return hasFlag(Visible);
 }
 
 /**
@@ -238,98 +479,490 @@ bool ModelPart::visible() {
  * @param fileName The name of the STL file.
  */
 void ModelPart::loadSTL(QString fileName) {
-    // Load STL file
-    file = vtkSmartPointer<vtkSTLReader>::New();
-    file->SetFileName(fileName.toStdString().c_str());
-    file->Update();
-
-    // === SHRINK FILTER ===
-    shrinkFilter = vtkSmartPointer<vtkShrinkPolyData>::New();
-    shrinkFilter->SetInputConnection(file->GetOutputPort());
-    shrinkFilter->SetShrinkFactor(1.0);  // Default: no shrink
-    shrinkFilter->Update();
-
-    // === CLIP FILTER ===
-    clipPlane = vtkSmartPointer<vtkPlane>::New();
-
-    // Center the clip plane in Z bounds
-    double bounds[6];
-    file->GetOutput()->GetBounds(bounds);
-    double zMid = (bounds[4] + bounds[5]) / 2.0;
-
-    clipPlane->SetOrigin(0.0, 0.0, zMid);      // Mid-height of model
-    clipPlane->SetNormal(0.0, 0.0, 1.0);       // Clipping from bottom
-
-    clipFilter = vtkSmartPointer<vtkClipPolyData>::New();
-    clipFilter->SetInputConnection(shrinkFilter->GetOutputPort());
-    clipFilter->SetClipFunction(clipPlane.Get());
-    clipFilter->SetInsideOut(true);           // Show front half
-    clipFilter->SetValue(0.0);
-    clipFilter->Update();
+    setPipeline(buildPipeline(fileName));
+}
+
+/**
+ * @brief ModelPart::buildPipeline
+ * Builds the pipeline for an STL file.
+ * @param fileName The name of the STL file.
+ * @param weldTolerance Grid spacing for vertex welding, 0 to weld identical vertices only.
+ * @param cache If not null, processed geometry is taken from or added to this cache.
+ * @param store If not null, geometry already in use by another part is shared from this store.
+ * @return The pipeline, with a null source if the file could not be read.
+ */
+PartPipeline ModelPart::buildPipeline(const QString& fileName, double weldTolerance, GeometryCache* cache,
+                                      GeometryStore* store) {
+    PartSource origin;
+    origin.fileName = fileName;
+    return buildPipeline(origin, weldTolerance, cache, store);
+}
+
+/**
+ * @brief ModelPart::buildPipeline
+ * Loads the geometry, from a project, the cache or the STL file itself, unless
+ * a part is already using geometry from the same bytes, which is then shared.
+ * @param origin Where to load the geometry from.
+ * @param weldTolerance Grid spacing for vertex welding of STL files.
+ * @param cache If not null, processed geometry of STL files is taken from or added to this cache.
+ * @param store If not null, geometry already in use by another part is shared from this store.
+ * @return The pipeline, with a null source if the geometry could not be loaded.
+ */
+PartPipeline ModelPart::buildPipeline(const PartSource& origin, double weldTolerance, GeometryCache* cache,
+                                      GeometryStore* store) {
+    PartPipeline pipeline;
+    pipeline.origin = origin;
+
+    // The cache's key is the store's key for an STL file, so the file is hashed once
+    QString cacheKey;
+    if (origin.projectFile)
+        pipeline.storeKey = GeometryStore::projectKey(origin.projectFile->fileName(), origin.offset);
+    else if (cache)
+        pipeline.storeKey = cacheKey = cache->key(origin.fileName, weldTolerance);
+    else if (store)
+        pipeline.storeKey = GeometryStore::key(origin.fileName, weldTolerance);
+
+    if (store && !pipeline.storeKey.isEmpty()) {
+        pipeline.store = store;
+        pipeline.source = store->find(pipeline.storeKey, &pipeline.weldStats,
+                                      &pipeline.shapeKey, pipeline.shapeOrigin);
+    }
+    const bool stored = pipeline.source != nullptr;
+
+    if (pipeline.source) {
+        // Already in use by another part, nothing to load
+    } else {
+        // Geometry embedded in a project is already processed, map it directly,
+        // otherwise map previously processed geometry from the cache if there is any
+        if (origin.projectFile)
+            pipeline.source = MeshFile::map(origin.projectFile, origin.offset, &pipeline.weldStats);
+        else if (cache)
+            pipeline.source = cache->find(cacheKey, &pipeline.weldStats);
+
+        // Otherwise, or if the blob was damaged, load the STL file, welding its vertices into an indexed mesh
+        if (!pipeline.source && !origin.fileName.isEmpty()) {
+            pipeline.source = STLReader::read(origin.fileName, weldTolerance, &pipeline.weldStats);
+            if (pipeline.source) {
+                MeshFile::addNormals(pipeline.source);
+                if (cache && !cacheKey.isEmpty())
+                    cache->store(cacheKey, pipeline.source, pipeline.weldStats);
+            }
+        }
+    }
+
+    /* A stored mesh may already be drawn, so its shape key comes from the store
+     * rather than from reading its bounds here */
+    if (pipeline.source && !stored)
+        pipeline.shapeKey = PartInstancer::shapeKey(pipeline.source, pipeline.shapeOrigin);
+
+    return pipeline;
+}
+
+/**
+ * @brief ModelPart::setPipeline
+ * Takes ownership of a pipeline built by buildPipeline() and creates the mapper
+ * and actor that render it. With no filters on, the mapper draws the source
+ * itself so the part holds a single copy of its geometry.
+ * @param pipeline The pipeline to adopt.
+ */
+void ModelPart::setPipeline(const PartPipeline& pipeline) {
+    if (!pipeline.source)
+        return;
+
+    clearLodLevels();
+    releaseStoredSource();
+    source         = pipeline.source;
+    weldStats      = pipeline.weldStats;
+    if (pipeline.store) {
+        store    = pipeline.store;
+        storeKey = pipeline.storeKey;
+        source   = store->acquire(storeKey, pipeline.source, pipeline.weldStats,
+                                  pipeline.shapeKey, pipeline.shapeOrigin);
+    }
+    geometrySource = pipeline.origin;
+    shrinkFilter   = nullptr;
+    explodedSource = nullptr;
+    shrinkOnGpu    = false;
+    shrinkActive   = false;
+    clipPlane      = nullptr;
+
+    invalidateBounds();
 
     // === Mapper ===
     mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-    mapper->SetInputConnection(clipFilter->GetOutputPort());  // ✅ USE FILTERS
+    mapper->SetInputDataObject(source);
 
     // === Actor ===
     actor = vtkSmartPointer<vtkActor>::New();
     actor->SetMapper(mapper);
-    actor->GetProperty()->SetColor(1.0, 1.0, 0.0);
-    actor->SetVisibility(true);
-    isVisible = true;
+    actor->GetProperty()->SetColor(qRed(colour) / 255.0, qGreen(colour) / 255.0, qBlue(colour) / 255.0);
+    actor->SetVisibility(visible() && !drawnByInstancer && !drawnByBatch);
+    actor->SetPosition(position);
+    updateClippingPlanes();
+
+    // Parts restored from a project may already have filters switched on
+    if (hasFlag(Shrink))
+        applyShrink(true);
+    if (hasFlag(Clip))
+        applyClip(true);
 }
 
 /**
-  * @brief ModelPart::setData
-  * Sets the data for a specified column.
-  * @param column The column index.
-  * @param value The data to set for the column.
-  * @return True if the data was successfully set, false otherwise.
-  */
-bool ModelPart::setData(int column, const QVariant &value)
-{
-    if (column < 0 || column >= m_itemData.size())
+ * @brief ModelPart::getSource
+ * Returns the part's loaded geometry.
+ * @return The geometry, or a null pointer if none has been loaded.
+ */
+vtkSmartPointer<vtkPolyData> ModelPart::getSource() {
+    return source;
+}
+
+/**
+ * @brief ModelPart::getOutput
+ * Returns the shrunk geometry, running vtkShrinkPolyData once if the shrink is
+ * only being done in the vertex shader, and moved to the part's position.
+ * @return The filtered geometry, or a null pointer if none has been loaded.
+ */
+vtkSmartPointer<vtkPolyData> ModelPart::getOutput() {
+    vtkSmartPointer<vtkPolyData> output = source;
+    if (shrinkActive && shrinkFilter) {
+        output = shrinkFilter->GetOutput();
+    } else if (shrinkActive && shrinkOnGpu) {
+        vtkNew<vtkShrinkPolyData> shrink;
+        shrink->SetInputData(source);
+        shrink->SetShrinkFactor(shrinkFactor);
+        shrink->Update();
+        output = shrink->GetOutput();
+    }
+
+    if (!output || (position[0] == 0.0 && position[1] == 0.0 && position[2] == 0.0))
+        return output;
+
+    vtkNew<vtkTransform> translation;
+    translation->Translate(position);
+
+    vtkNew<vtkTransformPolyDataFilter> transform;
+    transform->SetInputData(output);
+    transform->SetTransform(translation);
+    transform->Update();
+    return transform->GetOutput();
+}
+
+/**
+ * @brief ModelPart::getClippedOutput
+ * Runs the mapper's clipping planes through vtkClipPolyData, keeping the part
+ * of the mesh on the positive side of every plane as the GPU does.
+ * @return The clipped geometry, or the filter output itself if nothing is clipped.
+ */
+vtkSmartPointer<vtkPolyData> ModelPart::getClippedOutput() {
+    vtkSmartPointer<vtkPolyData> output = getOutput();
+    vtkPlaneCollection* planes = mapper ? mapper->GetClippingPlanes() : nullptr;
+    if (!output || !planes || planes->GetNumberOfItems() == 0)
+        return output;
+
+    /* The union of the planes is their minimum, so it is positive only where
+     * every plane is */
+    vtkNew<vtkImplicitBoolean> keep;
+    keep->SetOperationTypeToUnion();
+    for (int i = 0; i < planes->GetNumberOfItems(); ++i)
+        keep->AddFunction(planes->GetItem(i));
+
+    vtkNew<vtkClipPolyData> clip;
+    clip->SetInputData(output);
+    clip->SetClipFunction(keep);
+    clip->SetInsideOut(false);
+    clip->SetValue(0.0);
+    clip->Update();
+    return clip->GetOutput();
+}
+
+/**
+ * @brief ModelPart::setSectionPlanes
+ * @param planes The planes, or nullptr for none.
+ */
+void ModelPart::setSectionPlanes(vtkPlaneCollection* planes) {
+    sectionPlanes = planes;
+    updateClippingPlanes();
+}
+
+/**
+ * @brief ModelPart::updateClippingPlanes
+ * The planes are shared, not copied, so moving a section plane only needs a render.
+ */
+void ModelPart::updateClippingPlanes() {
+    if (!mapper) return;
+
+    mapper->RemoveAllClippingPlanes();
+    if (clipPlane)
+        mapper->AddClippingPlane(clipPlane);
+    if (sectionPlanes) {
+        for (int i = 0; i < sectionPlanes->GetNumberOfItems(); ++i)
+            mapper->AddClippingPlane(sectionPlanes->GetItem(i));
+    }
+}
+
+/**
+ * @brief ModelPart::setPosition
+ * @param position The translation.
+ */
+void ModelPart::setPosition(const double position[3]) {
+    std::copy(position, position + 3, this->position);
+    if (actor)
+        actor->SetPosition(this->position);
+    invalidateBounds();
+    notifyChanged();
+}
+
+/**
+ * @brief ModelPart::getPosition
+ * @param position Receives the translation.
+ */
+void ModelPart::getPosition(double position[3]) const {
+    std::copy(this->position, this->position + 3, position);
+}
+
+/**
+ * @brief ModelPart::shareSource
+ * The mesh is the same shape, so a clip plane at mid-height stays where it is.
+ * @param mesh The shared mesh.
+ * @param position The translation that puts the shared mesh where the part's own mesh was.
+ */
+void ModelPart::shareSource(vtkPolyData* mesh, const double position[3]) {
+    if (!source || mesh == source)
+        return;
+
+    const bool shrunk = shrinkActive;
+    applyShrink(false);
+    clearLodLevels();
+    releaseStoredSource();
+    source = mesh;
+    setPosition(position);
+    connectPipeline();
+    if (shrunk)
+        applyShrink(true);
+}
+
+/**
+ * @brief ModelPart::setInstancer
+ * @param instancer The instancer, or nullptr for none.
+ */
+void ModelPart::setInstancer(PartInstancer* instancer) {
+    this->instancer = instancer;
+}
+
+/**
+ * @brief ModelPart::setDrawnByInstancer
+ * @param drawn True while the part is drawn by its instancer.
+ */
+void ModelPart::setDrawnByInstancer(bool drawn) {
+    if (drawn == drawnByInstancer)
+        return;
+
+    drawnByInstancer = drawn;
+    if (actor)
+        actor->SetVisibility(visible() && !drawnByInstancer && !drawnByBatch);
+
+    /* Not the instancer, which is the one telling us */
+    if (batch)
+        batch->partChanged(this);
+}
+
+/**
+ * @brief ModelPart::isDrawnByInstancer
+ * @return True while the instancer draws the part.
+ */
+bool ModelPart::isDrawnByInstancer() const {
+    return drawnByInstancer;
+}
+
+/**
+ * @brief ModelPart::setBatch
+ * @param batch The batch, or nullptr for none.
+ */
+void ModelPart::setBatch(OverviewBatch* batch) {
+    this->batch = batch;
+}
+
+/**
+ * @brief ModelPart::setDrawnByBatch
+ * @param drawn True while the part is drawn by the batch.
+ */
+void ModelPart::setDrawnByBatch(bool drawn) {
+    drawnByBatch = drawn;
+    if (actor)
+        actor->SetVisibility(visible() && !drawnByInstancer && !drawnByBatch);
+}
+
+/**
+ * @brief ModelPart::isInstanceable
+ * @return True if the part can be drawn as an instance of a shared mesh.
+ */
+bool ModelPart::isInstanceable() const {
+    return visible() && source && !shrinkActive && !clipPlane;
+}
+
+/**
+ * @brief ModelPart::notifyChanged
+ */
+void ModelPart::notifyChanged() {
+    if (instancer)
+        instancer->partChanged(this);
+    if (batch)
+        batch->partChanged(this);
+}
+
+/**
+ * @brief ModelPart::releaseStoredSource
+ */
+void ModelPart::releaseStoredSource() {
+    if (store)
+        store->release(storeKey);
+    store = nullptr;
+    storeKey.clear();
+}
+
+/**
+ * @brief ModelPart::getBounds
+ * The source's bounds are cached by VTK, so this is cheap.
+ * @param bounds Receives xmin, xmax, ymin, ymax, zmin, zmax.
+ * @return False if the part has no geometry.
+ */
+bool ModelPart::getBounds(double bounds[6]) const {
+    if (!source || source->GetNumberOfPoints() == 0)
         return false;
 
-    m_itemData[column] = value;
+    source->GetBounds(bounds);
+    for (int i = 0; i < 6; ++i)
+        bounds[i] += position[i / 2];
     return true;
 }
 
 /**
- * @brief ModelPart::propagateVisibility
- * Propagates visibility changes to this item and all its children.
- * @param visible The visibility status to set.
+ * @brief ModelPart::getSubtreeBounds
+ * @param bounds Receives xmin, xmax, ymin, ymax, zmin, zmax.
+ * @return False if there is no geometry in the subtree.
  */
-void ModelPart::propagateVisibility(bool visible) {
-    setVisible(visible);
-    set(1, visible ? "true" : "false");
-    for (ModelPart* child : m_childItems) {
-        child->propagateVisibility(visible);
+bool ModelPart::getSubtreeBounds(double bounds[6]) {
+    if (!subtreeBoxValid) {
+        subtreeBox.Reset();
+
+        double childBounds[6];
+        if (getBounds(childBounds))
+            subtreeBox.AddBounds(childBounds);
+        for (ModelPart* child : std::as_const(m_childItems))
+            if (child->getSubtreeBounds(childBounds))
+                subtreeBox.AddBounds(childBounds);
+
+        subtreeBoxValid = true;
     }
+
+    if (!subtreeBox.IsValid())
+        return false;
+    subtreeBox.GetBounds(bounds);
+    return true;
 }
 
 /**
- * @brief ModelPart::propagateClip
- * Propagates clipping changes to this item and all its children.
- * @param clip The clipping status to set.
+ * @brief ModelPart::invalidateBounds
+ * A stale part always has stale ancestors, so the walk up stops at the first
+ * one that is already stale.
  */
-void ModelPart::propagateClip(bool clip) {
-    set(3, clip ? "true" : "false");
-    for (ModelPart* child : m_childItems) {
-        child->propagateClip(clip);
-    }
+void ModelPart::invalidateBounds() {
+    for (ModelPart* part = this; part && part->subtreeBoxValid; part = part->m_parentItem)
+        part->subtreeBoxValid = false;
 }
 
 /**
- * @brief ModelPart::propagateShrink
- * Propagates shrinking changes to this item and all its children.
- * @param shrink The shrink status to set.
+ * @brief ModelPart::clearLodLevels
  */
-void ModelPart::propagateShrink(bool shrink) {
-    set(2, shrink ? "true" : "false");
-    for (ModelPart* child : m_childItems) {
-        child->propagateShrink(shrink);
-    }
+void ModelPart::clearLodLevels() {
+    if (lodManager)
+        lodManager->removePart(this);
+    lodLevels.clear();
+    setLodLevel(0);
+}
+
+/**
+ * @brief ModelPart::setLodManager
+ * @param lodManager The manager, or nullptr for none.
+ */
+void ModelPart::setLodManager(LodManager* lodManager) {
+    this->lodManager = lodManager;
+}
+
+/**
+ * @brief ModelPart::setLodLevels
+ * @param levels The levels, coarsest last.
+ */
+void ModelPart::setLodLevels(const QList<vtkSmartPointer<vtkPolyData>>& levels) {
+    lodLevels = levels;
+    setLodLevel(0);
+}
+
+/**
+ * @brief ModelPart::getLodLevels
+ * @return The levels, coarsest last.
+ */
+const QList<vtkSmartPointer<vtkPolyData>>& ModelPart::getLodLevels() const {
+    return lodLevels;
+}
+
+/**
+ * @brief ModelPart::lodLevelCount
+ * @return The number of decimated levels.
+ */
+int ModelPart::lodLevelCount() const {
+    return lodLevels.size();
+}
+
+/**
+ * @brief ModelPart::setLodLevel
+ * The shrink and the exploded mesh work on the full geometry, so while the
+ * shrink is on the level is remembered but the mapper is left alone.
+ * @param level 0 for the full geometry, otherwise the decimated level to draw.
+ */
+void ModelPart::setLodLevel(int level) {
+    level = std::clamp(level, 0, int(lodLevels.size()));
+    if (level == lodLevel)
+        return;
+
+    lodLevel = level;
+    if (mapper && !shrinkActive)
+        mapper->SetInputDataObject(lodLevel ? lodLevels[lodLevel - 1].Get() : source.Get());
+}
+
+/**
+ * @brief ModelPart::getLodLevel
+ * @return The level drawn, 0 for the full geometry.
+ */
+int ModelPart::getLodLevel() const {
+    return lodLevel;
+}
+
+/**
+ * @brief ModelPart::setGeometrySource
+ * Sets where the part's geometry will be loaded from.
+ * @param origin Where to load the geometry from.
+ */
+void ModelPart::setGeometrySource(const PartSource& origin) {
+    geometrySource = origin;
+}
+
+/**
+ * @brief ModelPart::getGeometrySource
+ * Returns where the part's geometry is, or will be, loaded from.
+ * @return The geometry source.
+ */
+const PartSource& ModelPart::getGeometrySource() const {
+    return geometrySource;
+}
+
+/**
+ * @brief ModelPart::getWeldStats
+ * Returns how much welding reduced the part's vertices when it was loaded.
+ * @return The welding statistics.
+ */
+const WeldStats& ModelPart::getWeldStats() const {
+    return weldStats;
 }
 
 /**
@@ -368,26 +1001,168 @@ vtkSmartPointer<vtkActor> ModelPart::getActor() {
 
 /**
  * @brief ModelPart::applyShrink
- * Applies a shrink filter to the model part.
- * @param enable True to enable the shrink filter, false to disable it.
+ * Switches the shrink on in the vertex shader if the mapper is an OpenGL one,
+ * otherwise inserts a shrink filter after the source. Switching it off drops
+ * the filter or exploded mesh, releasing its memory.
+ * @param enable True to enable the shrink, false to disable it.
  */
 void ModelPart::applyShrink(bool enable) {
-    if (!shrinkFilter) return;
-    shrinkFilter->SetShrinkFactor(enable ? 0.7 : 1.0);
-    shrinkFilter->Modified();
-    shrinkFilter->Update();
+    if (!source || enable == shrinkActive) return;
+
+    prepareShrink(enable);
+    shrinkActive = enable;
+    if (!enable) {
+        shrinkFilter = nullptr;
+        explodedSource = nullptr;
+        shrinkOnGpu = false;
+    }
+    connectPipeline();
+    notifyChanged();
+}
+
+/**
+ * @brief ModelPart::prepareShrink
+ * Builds the exploded mesh for a GPU shrink, or creates and runs the shrink
+ * filter for a CPU one. Only writes this part's own objects, so it can run
+ * for many parts at once, and applyShrink() then just connects the result.
+ * The exploded mesh only depends on the source, so parts sharing a source can
+ * share it too.
+ * @param enable True if the shrink is about to be enabled.
+ * @param exploded Exploded mesh of the same source, or nullptr to build one.
+ */
+void ModelPart::prepareShrink(bool enable, vtkPolyData* exploded) {
+    if (!source || !enable || shrinkActive) return;
+
+    const bool triangles = source->GetPolys()->GetNumberOfConnectivityIds() == 3 * source->GetNumberOfPolys();
+    if (gpuShrinkEnabled && triangles && vtkOpenGLPolyDataMapper::SafeDownCast(mapper)) {
+        shrinkOnGpu = true;
+        if (!explodedSource)
+            explodedSource = exploded;
+        if (!explodedSource)
+            explodedSource = explodeTriangles(source);
+    } else {
+        if (!shrinkFilter) {
+            shrinkFilter = vtkSmartPointer<vtkShrinkPolyData>::New();
+            shrinkFilter->SetInputData(source);
+        }
+        shrinkFilter->SetShrinkFactor(shrinkFactor);
+        shrinkFilter->Update();
+    }
+}
+
+/**
+ * @brief ModelPart::getExplodedSource
+ * @return The exploded mesh, or nullptr if the part isn't shrunk on the GPU.
+ */
+vtkPolyData* ModelPart::getExplodedSource() const {
+    return explodedSource;
+}
+
+/**
+ * @brief ModelPart::setShrinkFactor
+ * On the GPU only the shader's uniform changes, so this is cheap enough to
+ * call for every step of a slider. The CPU fallback re-runs its filter.
+ * @param factor Fraction of its size each triangle keeps, 0 to 1.
+ */
+void ModelPart::setShrinkFactor(double factor) {
+    shrinkFactor = factor;
+
+    if (shrinkOnGpu) {
+        actor->GetShaderProperty()->GetVertexCustomUniforms()->SetUniformf("shrinkFactor", static_cast<float>(factor));
+    } else if (shrinkFilter) {
+        shrinkFilter->SetShrinkFactor(factor);
+        shrinkFilter->Update();
+    }
+}
+
+/**
+ * @brief ModelPart::getShrinkFactor
+ * @return The fraction of its size each triangle keeps when shrunk.
+ */
+double ModelPart::getShrinkFactor() const {
+    return shrinkFactor;
+}
+
+/**
+ * @brief ModelPart::setGpuShrinkEnabled
+ * @param enabled False to always use vtkShrinkPolyData.
+ */
+void ModelPart::setGpuShrinkEnabled(bool enabled) {
+    gpuShrinkEnabled = enabled;
 }
 
 /**
   * @brief ModelPart::applyClip
-  * Applies a clip filter to the model part.
-  * @param enable True to enable the clip filter, false to disable it.
+  * Adds or removes a clipping plane at the middle of the part's height, keeping
+  * the upper half. The cut is done by the GPU, so the mesh is not touched.
+  * @param enable True to enable the clip, false to disable it.
   */
 void ModelPart::applyClip(bool enable) {
-    if (!clipFilter) return;
-    clipFilter->SetInsideOut(false);
-    clipFilter->Modified();
-    clipFilter->Update();
+    if (!source || enable == (clipPlane != nullptr)) return;
+
+    if (enable) {
+        double bounds[6];
+        source->GetBounds(bounds);
+
+        clipPlane = vtkSmartPointer<vtkPlane>::New();
+        clipPlane->SetOrigin(0.0, 0.0, (bounds[4] + bounds[5]) / 2.0 + position[2]);
+        clipPlane->SetNormal(0.0, 0.0, 1.0);
+    } else {
+        clipPlane = nullptr;
+    }
+    updateClippingPlanes();
+    notifyChanged();
 }
 
+/**
+ * @brief ModelPart::connectPipeline
+ * Feeds the mapper from the exploded mesh and switches the shrink shader on
+ * for a GPU shrink, or from the shrink filter or the source itself. The CPU
+ * filter is updated so that the work is done now rather than on the next
+ * render. A dropped filter or exploded mesh is no longer referenced, so its
+ * memory is freed.
+ */
+void ModelPart::connectPipeline() {
+    if (!mapper) return;
+
+    vtkOpenGLPolyDataMapper* glMapper = vtkOpenGLPolyDataMapper::SafeDownCast(mapper);
+    vtkShaderProperty* shaderProperty = actor->GetShaderProperty();
+
+    if (shrinkActive && shrinkOnGpu) {
+        if (!explodedSource)
+            explodedSource = explodeTriangles(source);
+
+        glMapper->SetInputDataObject(explodedSource);
+        glMapper->MapDataArrayToVertexAttribute("centroidMC", "Centroid", vtkDataObject::FIELD_ASSOCIATION_POINTS, -1);
+
+        /* Every later use of vertexMC, including the clipping planes, sees the
+         * shrunk position */
+        shaderProperty->ClearAllVertexShaderReplacements();
+        shaderProperty->AddVertexShaderReplacement("//VTK::PositionVC::Dec", true,
+            "//VTK::PositionVC::Dec\n"
+            "in vec3 centroidMC;\n"
+            "vec4 shrinkVertex() { return vec4(mix(centroidMC, vertexMC.xyz, shrinkFactor), vertexMC.w); }\n"
+            "vec4 shrunkVertexMC;\n"
+            "#define vertexMC shrunkVertexMC\n",
+            false);
+        shaderProperty->AddVertexShaderReplacement("//VTK::Color::Impl", true,
+            "shrunkVertexMC = shrinkVertex();\n"
+            "//VTK::Color::Impl\n",
+            false);
+        shaderProperty->GetVertexCustomUniforms()->SetUniformf("shrinkFactor", static_cast<float>(shrinkFactor));
+        return;
+    }
+
+    shaderProperty->ClearAllVertexShaderReplacements();
+    shaderProperty->GetVertexCustomUniforms()->RemoveAllUniforms();
+    if (glMapper)
+        glMapper->RemoveAllVertexAttributeMappings();
+
+    if (shrinkActive && shrinkFilter) {
+        shrinkFilter->SetInputData(source);
+        shrinkFilter->Update();
+        mapper->SetInputConnection(shrinkFilter->GetOutputPort());
+    } else {
+        mapper->SetInputDataObject(lodLevel ? lodLevels[lodLevel - 1].Get() : source.Get());
+    }
 }
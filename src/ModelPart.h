@@ -10,9 +10,14 @@
 #ifndef VIEWER_MODELPART_H
 #define VIEWER_MODELPART_H
 
+#include "MeshWelder.h"
+#include "GeometryCache.h"
+#include "GeometryStore.h"
+#include "PartRecords.h"
+
 #include <QString>
 #include <QList>
-#include <QVariant>
+#include <QRgb>
 #include <vtkSmartPointer.h>
 #include <vtkSTLReader.h>
 #include <vtkPolyDataMapper.h>
@@ -20,6 +25,17 @@
 #include <QVTKOpenGLNativeWidget.h>
 #include <vtkShrinkPolyData.h>
 #include <vtkClipPolyData.h>
+#include <vtkPolyData.h>
+#include <vtkPlane.h>
+#include <vtkPlaneCollection.h>
+#include <vtkBoundingBox.h>
+
+#include <memory>
+
+class QFile;
+class PartInstancer;
+class LodManager;
+class OverviewBatch;
 
 
 /* VTK headers - will be needed when VTK used in next worksheet,
@@ -35,6 +51,43 @@
 //#include <vtkSTLReader.h>
 //#include <vtkColor.h>
 
+/**
+ * @struct PartSource
+ * @brief Where a part's geometry is loaded from.
+ *
+ * Either an STL file, or a mesh blob embedded in a project file. The STL file
+ * name is kept in both cases so a project can be saved again without embedding.
+ */
+struct PartSource {
+    QString                                     fileName;           /**< STL file the part was loaded from, may be empty */
+    std::shared_ptr<QFile>                      projectFile;        /**< Open project file holding the embedded geometry, or null */
+    qint64                                      offset = -1;        /**< Offset of the embedded MeshFile blob in the project file */
+
+    /**
+     * @brief Returns true if there is somewhere to load geometry from.
+     */
+    bool isValid() const { return projectFile || !fileName.isEmpty(); }
+};
+
+/**
+ * @struct PartPipeline
+ * @brief A part's loaded geometry, ready to be given to the part.
+ *
+ * A pipeline is built by ModelPart::buildPipeline(), which does not touch any
+ * ModelPart state and so can run on a worker thread. The finished pipeline is
+ * then handed to ModelPart::setPipeline() on the GUI thread. Filters are not
+ * part of it, the part inserts them only when they are switched on.
+ */
+struct PartPipeline {
+    vtkSmartPointer<vtkPolyData>                source;             /**< Welded geometry with normals, null if loading failed */
+    WeldStats                                   weldStats;          /**< Result of welding the source's vertices */
+    PartSource                                  origin;             /**< Where the geometry was loaded from */
+    GeometryStore*                              store = nullptr;    /**< Store the source is shared through, may be null */
+    QString                                     storeKey;           /**< The source's key in the store */
+    quint64                                     shapeKey = 0;       /**< Shape key for instancing, see PartInstancer::shapeKey() */
+    double                                      shapeOrigin[3] = { 0.0, 0.0, 0.0 };  /**< Origin the shape key is relative to */
+};
+
 /**
  * @class ModelPart
  * @brief Represents a model part in the CAD viewer application.
@@ -46,11 +99,20 @@
 class ModelPart {
 public:
     /**
-     * @brief Constructor for the ModelPart class.
-     * @param data List of properties for this item (part name and visibility).
+     * @brief On/off state of a part, held together in one byte.
+     */
+    enum Flag : quint8 {
+        Visible = 1 << 0,   /**< The part is shown */
+        Shrink  = 1 << 1,   /**< The shrink filter is switched on */
+        Clip    = 1 << 2    /**< The clip filter is switched on */
+    };
+
+    /**
+     * @brief Constructor for the ModelPart class. Parts start visible, yellow and unfiltered.
+     * @param name The name shown in the tree.
      * @param parent The parent item in the tree.
      */
-    ModelPart(const QList<QVariant>& data, ModelPart* parent = nullptr);
+    explicit ModelPart(const QString& name, ModelPart* parent = nullptr);
 
     /**
      * @brief Destructor for the ModelPart class.
@@ -65,6 +127,69 @@ public:
      */
     void appendChild(ModelPart* item);
 
+    /**
+     * @brief Inserts child items before the given row, renumbering the later children once.
+     * @param row The row the first child is inserted at.
+     * @param items The child items to insert, which become owned by this item.
+     */
+    void insertChildren(int row, const QList<ModelPart*>& items);
+
+    /**
+     * @brief Removes consecutive child items without deleting them.
+     * @param row The row of the first child item.
+     * @param count The number of child items.
+     * @return The child items, now owned by the caller, or an empty list if the rows are invalid.
+     */
+    QList<ModelPart*> takeChildren(int row, int count);
+
+    /**
+     * @brief Records which record the part was made from, leaving its children as records until they are needed.
+     * @param records The records of the project the part came from.
+     * @param record The part's own record.
+     */
+    void setRecord(std::shared_ptr<const PartRecords> records, qint32 record);
+
+    /**
+     * @brief Returns the records the part was made from, or nullptr if it wasn't made from a record.
+     */
+    const PartRecords* getRecords() const;
+
+    /**
+     * @brief Returns the record the part was made from, or -1 if it wasn't made from a record.
+     */
+    qint32 getRecord() const;
+
+    /**
+     * @brief Returns true if the part has children that haven't been made yet.
+     */
+    bool hasPendingChildren() const;
+
+    /**
+     * @brief Returns true if a part not yet made below this one is visible and has geometry to load.
+     */
+    bool pendingChildrenVisible() const;
+
+    /**
+     * @brief Sets the shrink factor the shrunk parts still held as records below this one take when they are made.
+     * @param factor Fraction of its size each triangle keeps, 0 to 1.
+     */
+    void setPendingShrinkFactor(double factor);
+
+    /**
+     * @brief Makes the parts for the children still held as records, without adding them.
+     * @return The new parts, owned by the caller.
+     */
+    QList<ModelPart*> createPendingChildren() const;
+
+    /**
+     * @brief Makes the parts for the children still held as records and drops the records.
+     *
+     * The parts are not added as children, so that the tree model can insert
+     * them with the right notifications.
+     * @return The new parts, owned by the caller.
+     */
+    QList<ModelPart*> takePendingChildren();
+
     /**
      * @brief Returns the child item at the specified row.
      * @param row The row number of the child item.
@@ -79,25 +204,33 @@ public:
     int childCount() const;
 
     /**
-     * @brief Returns the number of data items (columns) for this item.
-     * @return The number of data columns.
+     * @brief Returns the part's name.
+     * @return The name shown in the tree.
      */
-    int columnCount() const;
+    const QString& name() const;
 
     /**
-     * @brief Returns the data item at the specified column.
-     * @param column The column index.
-     * @return The data item at the specified column.
+     * @brief Renames the part.
+     * @param name The new name.
      */
-    QVariant data(int column) const;
+    void setName(const QString& name);
 
     /**
-      * @brief Sets the data item at a specified column.
-      * @param column The index of the property to set
-      * @param value The value to apply
-      * @return  True if the data was set, false otherwise
-      */
-    bool setData( int column, const QVariant& value );
+     * @brief Returns true if a flag is set.
+     * @param flag The flag.
+     * @return True if the flag is set.
+     */
+    bool hasFlag(Flag flag) const;
+
+    /**
+     * @brief Records whether the shrink or clip filter is switched on, without applying it.
+     *
+     * The filters are applied with applyShrink() and applyClip(), and setPipeline()
+     * applies them for parts that have their flags set. Use setVisible() for Visible.
+     * @param flag The flag.
+     * @param on True to set the flag.
+     */
+    void setFlag(Flag flag, bool on);
 
 
     /**
@@ -107,7 +240,7 @@ public:
     ModelPart* parentItem();
 
     /**
-     * @brief Returns the row index of this item relative to its parent.
+     * @brief Returns the row index of this item relative to its parent, in constant time.
      * @return The row index.
      */
     int row() const;
@@ -124,17 +257,23 @@ public:
       * @brief Gets the red component of the model part's color.
       * @return Red component (0-255).
       */
-    unsigned char getColourR();
+    unsigned char getColourR() const;
     /**
       * @brief Gets the green component of the model part's color.
       * @return Green component (0-255).
       */
-    unsigned char getColourG();
+    unsigned char getColourG() const;
     /**
       * @brief Gets the blue component of the model part's color.
       * @return Blue component (0-255).
       */
-    unsigned char getColourB();
+    unsigned char getColourB() const;
+
+    /**
+      * @brief Gets the model part's colour packed into one value.
+      * @return The colour as an opaque QRgb.
+      */
+    QRgb getColour() const;
 
     /**
       * @brief Sets the visibility of the model part.
@@ -146,7 +285,7 @@ public:
       * @brief Gets the visibility of the model part.
       * @return True if the part is visible, false otherwise.
       */
-    bool visible();
+    bool visible() const;
 
     /**
       * @brief Loads the geometry of the model part from an STL file.
@@ -154,6 +293,198 @@ public:
       */
     void loadSTL(QString fileName);
 
+    /**
+      * @brief Reads an STL file into a pipeline.
+      *
+      * Does not modify any ModelPart, so it is safe to call from a worker thread.
+      * @param fileName The name of the STL file.
+      * @param weldTolerance Grid spacing for vertex welding, 0 to weld identical vertices only.
+      * @param cache If not null, processed geometry is taken from or added to this cache.
+      * @param store If not null, geometry already in use by another part is shared from this store.
+      * @return The built pipeline, with a null source if the file could not be read.
+      */
+    static PartPipeline buildPipeline(const QString& fileName, double weldTolerance = 0.0,
+                                      GeometryCache* cache = nullptr, GeometryStore* store = nullptr);
+
+    /**
+      * @brief Loads geometry from an STL file or embedded in a project into a pipeline.
+      *
+      * Does not modify any ModelPart, so it is safe to call from a worker thread.
+      * @param origin Where to load the geometry from.
+      * @param weldTolerance Grid spacing for vertex welding of STL files.
+      * @param cache If not null, processed geometry of STL files is taken from or added to this cache.
+      * @param store If not null, geometry already in use by another part is shared from this store.
+      * @return The built pipeline, with a null source if the geometry could not be loaded.
+      */
+    static PartPipeline buildPipeline(const PartSource& origin, double weldTolerance = 0.0,
+                                      GeometryCache* cache = nullptr, GeometryStore* store = nullptr);
+
+    /**
+      * @brief Adopts a pipeline built by buildPipeline() and creates the mapper and actor.
+      *
+      * The mapper reads the geometry directly, and the part's current colour,
+      * visibility, shrink and clip settings are applied. Must be called on the GUI thread.
+      * @param pipeline The pipeline to adopt.
+      */
+    void setPipeline(const PartPipeline& pipeline);
+
+    /**
+      * @brief Returns the part's loaded geometry.
+      * @return The geometry, or a null pointer if none has been loaded.
+      */
+    vtkSmartPointer<vtkPolyData> getSource();
+
+    /**
+      * @brief Returns the geometry after shrinking. Clipping planes are not applied.
+      *
+      * When the shrink is done on the GPU the shrunk mesh is built on the CPU here.
+      * @return The filtered geometry, or a null pointer if none has been loaded.
+      */
+    vtkSmartPointer<vtkPolyData> getOutput();
+
+    /**
+      * @brief Returns exactly the geometry that is shown, clipping it on the CPU if needed.
+      * @return The geometry, which is a new mesh if any clipping planes are active,
+      *         or a null pointer if none has been loaded.
+      */
+    vtkSmartPointer<vtkPolyData> getClippedOutput();
+
+    /**
+      * @brief Sets the section planes shared by all parts, applied to the mapper as clipping planes.
+      * @param planes The planes, or nullptr for none.
+      */
+    void setSectionPlanes(vtkPlaneCollection* planes);
+
+    /**
+      * @brief Sets the translation the part's geometry is drawn with.
+      * @param position The translation.
+      */
+    void setPosition(const double position[3]);
+
+    /**
+      * @brief Returns the translation the part's geometry is drawn with.
+      * @param position Receives the translation.
+      */
+    void getPosition(double position[3]) const;
+
+    /**
+      * @brief Replaces the part's geometry with an identical mesh shared with other parts.
+      *
+      * The part's own copy is released. Filters that are on are rebuilt from the shared mesh.
+      * @param mesh The shared mesh.
+      * @param position The translation that puts the shared mesh where the part's own mesh was.
+      */
+    void shareSource(vtkPolyData* mesh, const double position[3]);
+
+    /**
+      * @brief Sets the instancer told about changes to the part, or nullptr for none.
+      */
+    void setInstancer(PartInstancer* instancer);
+
+    /**
+      * @brief Hides the part's own actor while an instanced mapper draws the part.
+      * @param drawn True while the part is drawn by its instancer.
+      */
+    void setDrawnByInstancer(bool drawn);
+
+    /**
+      * @brief Returns true while an instanced mapper draws the part.
+      */
+    bool isDrawnByInstancer() const;
+
+    /**
+      * @brief Sets the overview batch told about changes to the part, or nullptr for none.
+      */
+    void setBatch(OverviewBatch* batch);
+
+    /**
+      * @brief Hides the part's own actor while the overview batch draws the part.
+      * @param drawn True while the part is drawn by the batch.
+      */
+    void setDrawnByBatch(bool drawn);
+
+    /**
+      * @brief Returns true if the part is visible and its geometry is drawn unfiltered,
+      *        so it can be drawn as an instance of a shared mesh.
+      */
+    bool isInstanceable() const;
+
+    /**
+      * @brief Returns the world bounds of the part's own geometry.
+      * @param bounds Receives xmin, xmax, ymin, ymax, zmin, zmax.
+      * @return False if the part has no geometry.
+      */
+    bool getBounds(double bounds[6]) const;
+
+    /**
+      * @brief Returns the world bounds of the part and everything below it.
+      *
+      * Cached, and only recomputed for the branches that have changed since
+      * the last call.
+      * @param bounds Receives xmin, xmax, ymin, ymax, zmin, zmax.
+      * @return False if there is no geometry in the subtree.
+      */
+    bool getSubtreeBounds(double bounds[6]);
+
+    /**
+      * @brief Marks the cached subtree bounds of this part and its ancestors as stale.
+      */
+    void invalidateBounds();
+
+    /**
+      * @brief Sets the LOD manager the part's levels were built by, or nullptr for none.
+      */
+    void setLodManager(LodManager* lodManager);
+
+    /**
+      * @brief Gives the part its decimated levels of detail and draws it in full.
+      * @param levels The levels, coarsest last.
+      */
+    void setLodLevels(const QList<vtkSmartPointer<vtkPolyData>>& levels);
+
+    /**
+      * @brief Returns the part's decimated levels, coarsest last.
+      */
+    const QList<vtkSmartPointer<vtkPolyData>>& getLodLevels() const;
+
+    /**
+      * @brief Returns the number of decimated levels the part has.
+      */
+    int lodLevelCount() const;
+
+    /**
+      * @brief Chooses the mesh the part is drawn with while no filter is on.
+      * @param level 0 for the full geometry, otherwise the decimated level to draw.
+      */
+    void setLodLevel(int level);
+
+    /**
+      * @brief Returns the level of detail the part is drawn at, 0 being its full geometry.
+      */
+    int getLodLevel() const;
+
+    /**
+      * @brief Sets where the part's geometry will be loaded from, for parts restored from a project.
+      * @param origin Where to load the geometry from.
+      */
+    void setGeometrySource(const PartSource& origin);
+
+    /**
+      * @brief Returns where the part's geometry is, or will be, loaded from.
+      */
+    const PartSource& getGeometrySource() const;
+
+    /**
+      * @brief Removes and deletes all children of this item.
+      */
+    void clearChildren();
+
+    /**
+      * @brief Returns how much welding reduced the part's vertices when it was loaded.
+      * @return The welding statistics.
+      */
+    const WeldStats& getWeldStats() const;
+
     /**
       * @brief Returns the actor used to render this model part.
       * @return Pointer to the vtkActor.
@@ -167,60 +498,128 @@ public:
     vtkActor* getNewActor();
 
     /**
-      * @brief Propagates visibility changes to this item and its children.
-      * @param visible The new visibility state.
+      * @brief Shrinks each triangle of the part towards its centroid by the shrink factor.
+      *
+      * Done in the vertex shader where possible, otherwise with vtkShrinkPolyData.
+      * @param enable True to enable the shrink, false to disable it.
       */
-    void propagateVisibility(bool visible);
+    void applyShrink(bool enable);
+
     /**
-      * @brief Propagates clipping changes to this item and its children.
-      * @param clip The new clipping state.
+      * @brief Does the work of enabling the shrink ahead of applyShrink(), i.e.
+      *        builds the exploded mesh or runs the shrink filter.
+      *
+      * Only touches this part and reads its source, so it may be called for
+      * many parts in parallel as long as parts sharing a source are prepared
+      * on the same thread (see ModelPartList::enableShrink()). applyShrink()
+      * must still be called afterwards on the GUI thread.
+      * @param enable True if the shrink is about to be enabled, otherwise does nothing.
+      * @param exploded Exploded mesh already built from the same source by another part, or nullptr to build one.
       */
-    void propagateClip(bool clip);
+    void prepareShrink(bool enable, vtkPolyData* exploded = nullptr);
+
     /**
-      * @brief Propagates shrinking changes to this item and its children.
-      * @param shrink The new shrink state.
+      * @brief Returns the exploded mesh used by the GPU shrink, or nullptr if there isn't one.
       */
-    void propagateShrink(bool shrink);
+    vtkPolyData* getExplodedSource() const;
 
     /**
-      * @brief Propagates colour changes to this item and its children.
-      * @param R Red component (0-255).
-      * @param G Green component (0-255).
-      * @param B Blue component (0-255).
+      * @brief Sets how far triangles are shrunk. On the GPU this only changes a uniform.
+      * @param factor Fraction of its size each triangle keeps, 0 to 1.
       */
-    void propagateColour(unsigned char R, unsigned char G, unsigned char B);
+    void setShrinkFactor(double factor);
 
     /**
-      * @brief Applies a shrink filter to the model part.
-      * @param enable True to enable the shrink filter, false to disable it.
+      * @brief Returns the shrink factor.
       */
-    void applyShrink(bool enable);
+    double getShrinkFactor() const;
+
+    /**
+      * @brief Chooses whether parts may shrink in the vertex shader, e.g. to work
+      *        around driver problems. Applies to shrinks switched on afterwards.
+      * @param enabled False to always use vtkShrinkPolyData.
+      */
+    static void setGpuShrinkEnabled(bool enabled);
     /**
-      * @brief Applies a clip filter to the model part.
-      * @param enable True to enable the clip filter, false to disable it.
+      * @brief Clips the part at its mid-height with a GPU clipping plane.
+      * @param enable True to enable the clip, false to disable it.
       */
     void applyClip(bool enable);
 
-
 private:
+    /**
+      * @brief Connects the source, the shrink filter if it is on, and the mapper.
+      */
+    void connectPipeline();
+
+    /**
+      * @brief Gives the mapper the part's own clip plane and the section planes.
+      */
+    void updateClippingPlanes();
+
+    /**
+      * @brief Tells the instancer and the overview batch, if any, that the part has changed.
+      */
+    void notifyChanged();
+
+    /**
+      * @brief Gives back the part's reference to its mesh in the geometry store, if it has one.
+      */
+    void releaseStoredSource();
+
+    /**
+      * @brief Drops the part's levels of detail, e.g. when its geometry is replaced.
+      */
+    void clearLodLevels();
+
+    /**
+      * @brief Stores the rows of the children from the given row on, after children were inserted or removed.
+      * @param first The first row whose child may have moved.
+      */
+    void renumberChildren(int first);
+
     QList<ModelPart*>                           m_childItems;       /**< List (array) of child items */
-    QList<QVariant>                             m_itemData;         /**< List (array) of column data for item */
+    QString                                     m_name;             /**< Name shown in the tree */
     ModelPart* m_parentItem;       /**< Pointer to parent */
-    bool                                        isVisible;          /**< True/false to indicate if should be visible in model rendering */
+    int                                         m_row;              /**< Row of this item in its parent's children */
+    quint8                                      m_flags;            /**< Set of Flag values */
+    std::shared_ptr<const PartRecords>          records;            /**< Records the part was made from, or null */
+    qint32                                      record;             /**< The part's own record in records */
+    bool                                        childrenPending;    /**< True until the children held as records are made */
+    double                                      pendingShrinkFactor;/**< Shrink factor for the shrunk parts held as records below, or -1 for the default */
 
     /* These are vtk properties that will be used to load/render a model of this part,
      * commented out for now but will be used later
      */
-    vtkSmartPointer<vtkSTLReader>               file;               /**< Datafile from which part loaded */
+    vtkSmartPointer<vtkPolyData>                source;             /**< Geometry loaded from the part's STL file */
+    WeldStats                                   weldStats;          /**< Result of welding the geometry on load */
     vtkSmartPointer<vtkMapper>                  mapper;             /**< Mapper for rendering */
     vtkSmartPointer<vtkActor>                   actor;              /**< Actor for rendering */
 
-    vtkSmartPointer<vtkShrinkPolyData>          shrinkFilter;
-    vtkSmartPointer<vtkClipPolyData>            clipFilter;
-    vtkSmartPointer<vtkPlane>                   clipPlane;
-
-
-    // vtkColor3<unsigned char>                    colour;             /**< User defineable colour */
+    vtkSmartPointer<vtkShrinkPolyData>          shrinkFilter;       /**< CPU shrink filter, only while shrink is on */
+    vtkSmartPointer<vtkPolyData>                explodedSource;     /**< Unshared triangles with centroids for the GPU shrink */
+    bool                                        shrinkOnGpu;        /**< True while the shrink is done in the vertex shader */
+    bool                                        shrinkActive;       /**< True while the shrink is connected to the mapper */
+    double                                      shrinkFactor;       /**< Fraction of its size each triangle keeps when shrunk */
+    static bool                                 gpuShrinkEnabled;   /**< False to always shrink on the CPU */
+    vtkSmartPointer<vtkPlane>                   clipPlane;          /**< Mid-height clip plane, only while clip is on */
+    vtkSmartPointer<vtkPlaneCollection>         sectionPlanes;      /**< Section planes shared by all parts */
+
+
+    QRgb                                        colour;             /**< User defineable colour, packed RGBA */
+    PartSource                                  geometrySource;     /**< Where the geometry is loaded from */
+    double                                      position[3];        /**< Translation of the geometry */
+    PartInstancer*                              instancer;          /**< Instancer sharing the part's mesh, may be null */
+    bool                                        drawnByInstancer;   /**< True while the instancer draws the part */
+    OverviewBatch*                              batch;              /**< Overview batch holding the part's geometry, may be null */
+    bool                                        drawnByBatch;       /**< True while the overview batch draws the part */
+    GeometryStore*                              store;              /**< Store the source is shared through, may be null */
+    QString                                     storeKey;           /**< The source's key in the store */
+    QList<vtkSmartPointer<vtkPolyData>>         lodLevels;          /**< Decimated copies of the source, coarsest last */
+    int                                         lodLevel;           /**< Level drawn, 0 for the source */
+    LodManager*                                 lodManager;         /**< Manager that built the levels, may be null */
+    vtkBoundingBox                              subtreeBox;         /**< Cached world bounds of the part and its descendants */
+    bool                                        subtreeBoxValid;    /**< False when subtreeBox must be recomputed */
 };
 
 
@@ -12,6 +12,11 @@
 #include "ModelPartList.h"
 #include "ModelPart.h"
 
+#include <QHash>
+#include <QSet>
+
+#include <vtkSMPTools.h>
+
 /**
  * @brief ModelPartList::ModelPartList
  * @param data The header data for the tree view.
@@ -21,7 +26,7 @@ ModelPartList::ModelPartList(const QString& data, QObject* parent) : QAbstractIt
     /* Have option to specify number of visible properties for each item in tree - the root item
      * acts as the column headers
      */
-    rootItem = new ModelPart({tr("Part"), tr("Visible?"), tr("Shrink?"), tr("Clip?")});
+    rootItem = new ModelPart(tr("Parts"));
 }
 
 /**
@@ -40,7 +45,7 @@ ModelPartList::~ModelPartList() {
  */
 int ModelPartList::columnCount(const QModelIndex& parent) const {
     Q_UNUSED(parent);
-    return rootItem->columnCount();
+    return ColumnCount;
 }
 
 /**
@@ -56,18 +61,18 @@ QVariant ModelPartList::data(const QModelIndex& index, int role) const {
     if (!index.isValid())
         return QVariant();
 
-    /* Role represents what this data will be used for, we only need deal with the case
-     * when QT is asking for data to create and display the treeview. Return a new,
-     * empty QVariant if any other request comes through. */
-    if (role != Qt::DisplayRole)
-        return QVariant();
-
     /* Get a pointer to the item referred to by the QModelIndex */
     ModelPart* item = static_cast<ModelPart*>(index.internalPointer());
 
-    /* Each item in the tree has a number of columns ("Part" and "Visible" in this
-     * initial example) return the column requested by the QModelIndex */
-    return item->data(index.column());
+    /* Role represents what this data will be used for. The name column is text and
+     * the other columns are checkboxes; return a new, empty QVariant for anything else. */
+    if (index.column() == NameColumn)
+        return (role == Qt::DisplayRole || role == Qt::EditRole) ? QVariant(item->name()) : QVariant();
+
+    if (role != Qt::CheckStateRole)
+        return QVariant();
+
+    return item->hasFlag(columnFlag(index.column())) ? Qt::Checked : Qt::Unchecked;
 }
 
 /**
@@ -80,6 +85,9 @@ Qt::ItemFlags ModelPartList::flags(const QModelIndex& index) const {
     if (!index.isValid())
         return Qt::NoItemFlags;
 
+    if (index.column() != NameColumn)
+        return QAbstractItemModel::flags(index) | Qt::ItemIsUserCheckable;
+
     return QAbstractItemModel::flags(index);
 }
 
@@ -92,8 +100,15 @@ Qt::ItemFlags ModelPartList::flags(const QModelIndex& index) const {
  * @return The header data for the given section, orientation, and role.
  */
 QVariant ModelPartList::headerData(int section, Qt::Orientation orientation, int role) const {
-    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
-        return rootItem->data(section);
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case NameColumn:    return tr("Part");
+    case VisibleColumn: return tr("Visible?");
+    case ShrinkColumn:  return tr("Shrink?");
+    case ClipColumn:    return tr("Clip?");
+    }
 
     return QVariant();
 }
@@ -137,6 +152,7 @@ QModelIndex ModelPartList::parent(const QModelIndex& index) const {
     if (parentItem == rootItem)
         return QModelIndex();
 
+    /* The row is stored in the part, so this doesn't search the parent's children */
     return createIndex(parentItem->row(), 0, parentItem);
 }
 
@@ -159,6 +175,69 @@ int ModelPartList::rowCount(const QModelIndex& parent) const {
     return parentItem->childCount();
 }
 
+/**
+ * @brief ModelPartList::hasChildren
+ * @param parent The parent index.
+ * @return True if the item has children, made or not.
+ */
+bool ModelPartList::hasChildren(const QModelIndex& parent) const {
+    if (parent.column() > 0)
+        return false;
+
+    ModelPart* parentItem = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
+    return parentItem->childCount() > 0 || parentItem->hasPendingChildren();
+}
+
+/**
+ * @brief ModelPartList::canFetchMore
+ * @param parent The parent index.
+ * @return True if the item's children are still held as records.
+ */
+bool ModelPartList::canFetchMore(const QModelIndex& parent) const {
+    ModelPart* parentItem = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
+    return parentItem->hasPendingChildren();
+}
+
+/**
+ * @brief ModelPartList::fetchMore
+ * @param parent The parent index.
+ */
+void ModelPartList::fetchMore(const QModelIndex& parent) {
+    fetchChildren(parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem);
+}
+
+/**
+ * @brief ModelPartList::fetchChildren
+ * Only the one level is made, the new parts keep their own children as records.
+ * @param part The item.
+ */
+void ModelPartList::fetchChildren(ModelPart* part) {
+    if (!part->hasPendingChildren())
+        return;
+
+    insertParts(indexOf(part), part->childCount(), part->takePendingChildren());
+}
+
+/**
+ * @brief ModelPartList::visibleGeometryParts
+ * @param part The root of the subtree.
+ * @return The visible parts with geometry to load.
+ */
+QList<ModelPart*> ModelPartList::visibleGeometryParts(ModelPart* part) {
+    QList<ModelPart*> parts;
+    QList<ModelPart*> stack = { part };
+    while (!stack.isEmpty()) {
+        ModelPart* next = stack.takeLast();
+        if (next->pendingChildrenVisible())
+            fetchChildren(next);
+        if (next->visible() && next->getGeometrySource().isValid())
+            parts.append(next);
+        for (int i = 0; i < next->childCount(); ++i)
+            stack.append(next->child(i));
+    }
+    return parts;
+}
+
 /**
  * @brief ModelPartList::getRootItem
  * Returns the root item of the model.
@@ -172,34 +251,113 @@ ModelPart* ModelPartList::getRootItem() {
  * @brief ModelPartList::appendChild
  * Appends a child to the parent
  * @param parent the parent item
- * @param data the data for the child
+ * @param name the name of the child
  * @return QModelIndex
  */
-QModelIndex ModelPartList::appendChild(QModelIndex& parent, const QList<QVariant>& data) {
+QModelIndex ModelPartList::appendChild(const QModelIndex& parent, const QString& name) {
     ModelPart* parentPart;
 
+    /* Top level items have an invalid parent index, as in index() and parent() */
     if (parent.isValid())
         parentPart = static_cast<ModelPart*>(parent.internalPointer());
-    else {
+    else
         parentPart = rootItem;
-        parent = createIndex(0, 0, rootItem);
-    }
 
-    beginInsertRows(parent, rowCount(parent), rowCount(parent));
+    const int row = parentPart->childCount();
+    beginInsertRows(parent, row, row);
 
-    ModelPart* childPart = new ModelPart(data, parentPart);
+    ModelPart* childPart = new ModelPart(name, parentPart);
 
     parentPart->appendChild(childPart);
 
-    QModelIndex child = createIndex(0, 0, childPart);
+    QModelIndex child = createIndex(row, 0, childPart);
 
+    /* Inserting the row is all the views need to know; a layout change would
+     * make them remap every persistent index and relayout the whole tree
+     */
     endInsertRows();
 
-    emit layoutChanged();
-
     return child;
 }
 
+/**
+ * @brief ModelPartList::insertParts
+ * The parts can be whole subtrees built off the model, e.g. a folder import,
+ * as the views only hear about the top level rows and fetch the rest when
+ * they are expanded.
+ * @param parent The parent item, or an invalid index for top level parts.
+ * @param row The row the first part is inserted at.
+ * @param parts The parts, which become owned by the model.
+ * @return True if the parts were inserted.
+ */
+bool ModelPartList::insertParts(const QModelIndex& parent, int row, const QList<ModelPart*>& parts) {
+    ModelPart* parentPart = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
+    if (parts.isEmpty() || row < 0 || row > parentPart->childCount())
+        return false;
+
+    beginInsertRows(parent, row, row + parts.size() - 1);
+    parentPart->insertChildren(row, parts);
+    endInsertRows();
+    return true;
+}
+
+/**
+ * @brief ModelPartList::removeRows
+ * @param row The first row to remove.
+ * @param count The number of rows.
+ * @param parent The parent item, or an invalid index for top level parts.
+ * @return True if the rows were removed.
+ */
+bool ModelPartList::removeRows(int row, int count, const QModelIndex& parent) {
+    ModelPart* parentPart = parent.isValid() ? static_cast<ModelPart*>(parent.internalPointer()) : rootItem;
+    if (row < 0 || count <= 0 || row + count > parentPart->childCount())
+        return false;
+
+    /* The parts are deleted after the views have let go of their rows */
+    beginRemoveRows(parent, row, row + count - 1);
+    const QList<ModelPart*> parts = parentPart->takeChildren(row, count);
+    endRemoveRows();
+
+    qDeleteAll(parts);
+    return true;
+}
+
+/**
+ * @brief ModelPartList::moveRows
+ * Persistent indexes, e.g. the current item, follow the moved parts.
+ * @param sourceParent The current parent of the rows.
+ * @param sourceRow The first row to move.
+ * @param count The number of rows.
+ * @param destinationParent The new parent.
+ * @param destinationChild The row of the new parent the parts are moved before.
+ * @return True if the rows were moved.
+ */
+bool ModelPartList::moveRows(const QModelIndex& sourceParent, int sourceRow, int count,
+                             const QModelIndex& destinationParent, int destinationChild) {
+    ModelPart* from = sourceParent.isValid() ? static_cast<ModelPart*>(sourceParent.internalPointer()) : rootItem;
+    ModelPart* to = destinationParent.isValid() ? static_cast<ModelPart*>(destinationParent.internalPointer()) : rootItem;
+    if (sourceRow < 0 || count <= 0 || sourceRow + count > from->childCount() ||
+        destinationChild < 0 || destinationChild > to->childCount())
+        return false;
+
+    /* A part can't be moved below itself */
+    for (ModelPart* ancestor = to; ancestor; ancestor = ancestor->parentItem())
+        if (ancestor->parentItem() == from && ancestor->row() >= sourceRow && ancestor->row() < sourceRow + count)
+            return false;
+
+    /* Also refuses a move within a parent that leaves the rows where they are */
+    if (!beginMoveRows(sourceParent, sourceRow, sourceRow + count - 1, destinationParent, destinationChild))
+        return false;
+
+    const QList<ModelPart*> parts = from->takeChildren(sourceRow, count);
+    if (from == to && destinationChild > sourceRow)
+        destinationChild -= count;
+    to->insertChildren(destinationChild, parts);
+
+    endMoveRows();
+    return true;
+}
+
 /**
  * @brief ModelPartList::setData
  * Sets the data for the item at the given index and role.
@@ -209,20 +367,280 @@ QModelIndex ModelPartList::appendChild(QModelIndex& parent, const QList<QVariant
  * @return True if the data was set successfully, false otherwise.
  */
 bool ModelPartList::setData(const QModelIndex& index, const QVariant& value, int role) {
-    if (!index.isValid() || role != Qt::EditRole)
+    if (!index.isValid())
         return false;
 
     ModelPart* item = static_cast<ModelPart*>(index.internalPointer());
     if (!item)
         return false;
 
-    bool result = item->setData(index.column(), value);
-
-    if (result) {
-        emit dataChanged(index, index, {role});
+    if (index.column() == NameColumn) {
+        if (role != Qt::EditRole)
+            return false;
+        item->setName(value.toString());
+        emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
         return true;
     }
 
-    return false;
+    if (role != Qt::CheckStateRole)
+        return false;
+
+    const bool checked = value.value<Qt::CheckState>() == Qt::Checked;
+    switch (index.column()) {
+    case VisibleColumn: setSubtreeVisible({ index }, checked); break;
+    case ShrinkColumn:  setSubtreeShrink({ index }, checked);  break;
+    case ClipColumn:    setSubtreeClip({ index }, checked);    break;
+    default:            return false;
+    }
+
+    emit subtreeChecked(index, index.column(), checked);
+    return true;
+}
+
+
+/**
+ * @brief ModelPartList::replaceParts
+ * Deletes every item in the tree and adds new top level items in their place.
+ * @param parts The new top level items, which become owned by the model.
+ */
+void ModelPartList::replaceParts(const QList<ModelPart*>& parts) {
+    beginResetModel();
+
+    rootItem->clearChildren();
+    for (ModelPart* part : parts)
+        rootItem->appendChild(part);
+
+    endResetModel();
 }
 
+/**
+ * @brief ModelPartList::setSubtreeVisible
+ * @param items The items, or an invalid index for every item in the tree.
+ * @param visible The new visibility.
+ */
+void ModelPartList::setSubtreeVisible(const QModelIndexList& items, bool visible) {
+    const QModelIndexList tops = topItems(items);
+    for (ModelPart* part : subtreeParts(tops))
+        part->setVisible(visible);
+    emitSubtreeChanged(tops, VisibleColumn, VisibleColumn);
+}
+
+/**
+ * @brief ModelPartList::setSubtreeShrink
+ * @param items The items, or an invalid index for every item in the tree.
+ * @param shrink The new shrink state.
+ */
+void ModelPartList::setSubtreeShrink(const QModelIndexList& items, bool shrink) {
+    const QModelIndexList tops = topItems(items);
+    const QList<ModelPart*> parts = subtreeParts(tops);
+    for (ModelPart* part : parts)
+        part->setFlag(ModelPart::Shrink, shrink);
+
+    if (shrink) {
+        enableShrink(parts);
+    } else {
+        for (ModelPart* part : parts)
+            part->applyShrink(false);
+    }
+    emitSubtreeChanged(tops, ShrinkColumn, ShrinkColumn);
+}
+
+/**
+ * @brief ModelPartList::setSubtreeClip
+ * The clip is a single GPU clipping plane per part, so there is nothing worth
+ * doing in parallel.
+ * @param items The items, or an invalid index for every item in the tree.
+ * @param clip The new clip state.
+ */
+void ModelPartList::setSubtreeClip(const QModelIndexList& items, bool clip) {
+    const QModelIndexList tops = topItems(items);
+    for (ModelPart* part : subtreeParts(tops)) {
+        part->setFlag(ModelPart::Clip, clip);
+        part->applyClip(clip);
+    }
+    emitSubtreeChanged(tops, ClipColumn, ClipColumn);
+}
+
+/**
+ * @brief ModelPartList::setSubtreeColour
+ * @param items The items, or an invalid index for every item in the tree.
+ * @param R The red component (0-255).
+ * @param G The green component (0-255).
+ * @param B The blue component (0-255).
+ */
+void ModelPartList::setSubtreeColour(const QModelIndexList& items, unsigned char R, unsigned char G, unsigned char B) {
+    const QModelIndexList tops = topItems(items);
+    for (ModelPart* part : subtreeParts(tops))
+        part->setColour(R, G, B);
+    emitSubtreeChanged(tops, NameColumn, NameColumn);
+}
+
+/**
+ * @brief ModelPartList::setSubtreeShrinkFactor
+ * Only parts whose shrink is already on are changed, which on the GPU is just
+ * a uniform, so this is cheap enough to follow a slider. Branches still held
+ * as records are not made; their shrunk parts take the factor when they are.
+ * @param items The items, or an invalid index for every item in the tree.
+ * @param factor The fraction of its size each triangle keeps, 0 to 1.
+ */
+void ModelPartList::setSubtreeShrinkFactor(const QModelIndexList& items, double factor) {
+    QList<ModelPart*> parts;
+    for (const QModelIndex& item : topItems(items))
+        parts.append(item.isValid() ? static_cast<ModelPart*>(item.internalPointer()) : rootItem);
+
+    /* parts grows as it is walked, so each item's children are appended after it */
+    for (qsizetype i = 0; i < parts.size(); ++i) {
+        ModelPart* part = parts[i];
+        if (part != rootItem && part->hasFlag(ModelPart::Shrink))
+            part->setShrinkFactor(factor);
+        if (part->hasPendingChildren())
+            part->setPendingShrinkFactor(factor);
+        for (int c = 0; c < part->childCount(); ++c)
+            parts.append(part->child(c));
+    }
+}
+
+/**
+ * @brief ModelPartList::indexOf
+ * @param part The item.
+ * @return The index of the item's first column, or an invalid index for the root.
+ */
+QModelIndex ModelPartList::indexOf(ModelPart* part) const {
+    if (!part || part == rootItem)
+        return QModelIndex();
+    return createIndex(part->row(), NameColumn, part);
+}
+
+/**
+ * @brief ModelPartList::topItems
+ * Items below another of the items are dropped, as their parent's subtree
+ * already covers them, so e.g. selecting every match of a search changes each
+ * part once.
+ * @param items The items, e.g. the selected rows.
+ * @return The items not below another of them, or just an invalid index if one of them is.
+ */
+QModelIndexList ModelPartList::topItems(const QModelIndexList& items) const {
+    QSet<ModelPart*> parts;
+    for (const QModelIndex& item : items) {
+        if (!item.isValid())
+            return { QModelIndex() };
+        parts.insert(static_cast<ModelPart*>(item.internalPointer()));
+    }
+
+    QModelIndexList tops;
+    QSet<ModelPart*> added;
+    for (const QModelIndex& item : items) {
+        ModelPart* part = static_cast<ModelPart*>(item.internalPointer());
+        bool covered = false;
+        for (ModelPart* ancestor = part->parentItem(); ancestor && !covered; ancestor = ancestor->parentItem())
+            covered = parts.contains(ancestor);
+        if (!covered && !added.contains(part)) {
+            added.insert(part);
+            tops.append(item.siblingAtColumn(NameColumn));
+        }
+    }
+    return tops;
+}
+
+/**
+ * @brief ModelPartList::subtreeParts
+ * The root item is never included. Children still held as records are made
+ * first, so that the change applies to them too.
+ * @param items Items none of which is below another, or an invalid index for every item below the root.
+ * @return The items, parents before their children.
+ */
+QList<ModelPart*> ModelPartList::subtreeParts(const QModelIndexList& items) {
+    QList<ModelPart*> parts;
+    for (const QModelIndex& item : items) {
+        if (item.isValid()) {
+            parts.append(static_cast<ModelPart*>(item.internalPointer()));
+        } else {
+            fetchChildren(rootItem);
+            for (int i = 0; i < rootItem->childCount(); ++i)
+                parts.append(rootItem->child(i));
+        }
+    }
+
+    /* parts grows as it is walked, so each item's children are appended after it */
+    for (qsizetype i = 0; i < parts.size(); ++i) {
+        fetchChildren(parts[i]);
+        for (int c = 0; c < parts[i]->childCount(); ++c)
+            parts.append(parts[i]->child(c));
+    }
+    return parts;
+}
+
+/**
+ * @brief ModelPartList::enableShrink
+ * Building the exploded meshes or running the shrink filters is the slow part.
+ * Parts loaded from the same bytes share one source mesh, and VTK doesn't
+ * allow one mesh to be read by several threads at once, so the work is done
+ * one source per task: its parts are prepared in turn and share one exploded
+ * mesh. Connecting the results to the mappers stays on the GUI thread.
+ * @param parts The parts to shrink.
+ */
+void ModelPartList::enableShrink(const QList<ModelPart*>& parts) {
+    QHash<vtkPolyData*, QList<ModelPart*>> bySource;
+    for (ModelPart* part : parts)
+        bySource[part->getSource().Get()].append(part);
+    const QList<QList<ModelPart*>> groups = bySource.values();
+
+    vtkSMPTools::For(0, groups.size(), 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType g = first; g < last; ++g) {
+            vtkPolyData* exploded = nullptr;
+            for (ModelPart* part : groups[g]) {
+                part->prepareShrink(true, exploded);
+                if (!exploded)
+                    exploded = part->getExplodedSource();
+            }
+        }
+    });
+
+    for (ModelPart* part : parts)
+        part->applyShrink(true);
+}
+
+/**
+ * @brief ModelPartList::columnFlag
+ * @param column VisibleColumn, ShrinkColumn or ClipColumn.
+ * @return The part flag shown in the column.
+ */
+ModelPart::Flag ModelPartList::columnFlag(int column) {
+    switch (column) {
+    case ShrinkColumn: return ModelPart::Shrink;
+    case ClipColumn:   return ModelPart::Clip;
+    default:           return ModelPart::Visible;
+    }
+}
+
+/**
+ * @brief ModelPartList::emitSubtreeChanged
+ * A dataChanged() range can only cover siblings, so this emits one signal for
+ * each item and one for each item's whole block of children, rather than one per item.
+ * @param items Items none of which is below another, or an invalid index for every item below the root.
+ * @param firstColumn The first column that changed.
+ * @param lastColumn The last column that changed.
+ */
+void ModelPartList::emitSubtreeChanged(const QModelIndexList& items, int firstColumn, int lastColumn) {
+    QList<QModelIndex> parents;
+    for (const QModelIndex& item : items) {
+        if (item.isValid()) {
+            emit dataChanged(item.siblingAtColumn(firstColumn), item.siblingAtColumn(lastColumn));
+            parents.append(item.siblingAtColumn(0));
+        } else {
+            parents.append(QModelIndex());
+        }
+    }
+
+    for (qsizetype i = 0; i < parents.size(); ++i) {
+        const QModelIndex parent = parents[i];
+        const int rows = rowCount(parent);
+        if (rows == 0)
+            continue;
+
+        emit dataChanged(index(0, firstColumn, parent), index(rows - 1, lastColumn, parent));
+        for (int row = 0; row < rows; ++row)
+            if (rowCount(index(row, 0, parent)) > 0)
+                parents.append(index(row, 0, parent));
+    }
+}
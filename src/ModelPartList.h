@@ -24,6 +24,16 @@ class ModelPart;
 class ModelPartList : public QAbstractItemModel {
     Q_OBJECT        /**< A special Qt tag used to indicate that this is a special Qt class that might require preprocessing before compiling. */
 public:
+    /** The columns of the tree view. The name column is text, the others are checkboxes
+      */
+    enum Column {
+        NameColumn,         /**< Part name */
+        VisibleColumn,      /**< Visibility checkbox */
+        ShrinkColumn,       /**< Shrink filter checkbox */
+        ClipColumn,         /**< Clip filter checkbox */
+        ColumnCount         /**< Number of columns */
+    };
+
     /** Constructor
       *  Arguments are standard arguments for this type of class but are not used in this example.
       * @param data is not used
@@ -38,16 +48,17 @@ public:
 
     /** Return column count
       * @param parent is not used
-      * @return number of columns in the tree view - "Part" and "Visible", i.e. 2 in this case
+      * @return number of columns in the tree view, ColumnCount
       */
     int columnCount( const QModelIndex& parent ) const;
 
     /** This returns the value of a particular row (i.e. the item index) and 
-      *  columns (i.e. either the "Part" or "Visible" property).
-      *  It is used by QT internally - this is how Qt retrieves the text to display in the TreeView
+      *  column (i.e. the part name or one of its checkboxes).
+      *  It is used by QT internally - this is how Qt retrieves the text and check states to display in the TreeView.
+      *  The values are made from the part's state only when asked for
       * @param index in a stucture Qt uses to specify the row and column it wants data for
       * @param role is how Qt specifies what it wants to do with the data
-      * @return a QVariant which is a generic variable used to represent any Qt class type, in this case the QVariant will be a string
+      * @return the name for the display and edit roles of the name column, a Qt::CheckState for the check state role of the other columns
       */
     QVariant data( const QModelIndex& index, int role ) const;
 
@@ -86,20 +97,163 @@ public:
       */
     int rowCount( const QModelIndex& parent ) const;
 
+    /** Say whether an item has children, counting those still held as records so the view shows an expand arrow
+      * @param parent is the item
+      * @return true if the item has children
+      */
+    bool hasChildren( const QModelIndex& parent = QModelIndex() ) const override;
+
+    /** Say whether an item's children are still held as records
+      * @param parent is the item
+      * @return true if fetchMore() would add rows
+      */
+    bool canFetchMore( const QModelIndex& parent ) const override;
+
+    /** Make the parts for an item's children still held as records and insert them, e.g. when the view expands it
+      * @param parent is the item
+      */
+    void fetchMore( const QModelIndex& parent ) override;
+
+    /** Make the parts for an item's children still held as records and insert them
+      * @param part is the item
+      */
+    void fetchChildren( ModelPart* part );
+
+    /** List the visible parts with geometry to load in a subtree, making the
+      *  branches still held as records that have any. Every part that will be
+      *  drawn needs its own actor, so a project with everything shown has all
+      *  its parts made by this; only hidden branches stay as records.
+      * @param part is the root of the subtree
+      * @return the parts, whether or not their geometry is loaded yet
+      */
+    QList<ModelPart*> visibleGeometryParts( ModelPart* part );
+
     /** Get a pointer to the root item of the tree
       * @return the root item pointer
       */
     ModelPart* getRootItem();
 
-    /**
+    /** Add a new part at the end of an item's children
+      * @param parent of the new part, or an invalid index for a top level part
+      * @param name of the new part
+      * @return the index of the new part
+      */
+    QModelIndex appendChild( const QModelIndex& parent, const QString& name );
+
+    /** Insert parts, e.g. whole subtrees built off the model, with one notification
+      * @param parent of the new parts, or an invalid index for top level parts
+      * @param row is where the first part goes in the parent's children
+      * @param parts are the new parts, ownership passes to the model
+      * @return true if the parts were inserted
       */
-    QModelIndex appendChild( QModelIndex& parent, const QList<QVariant>& data );
+    bool insertParts( const QModelIndex& parent, int row, const QList<ModelPart*>& parts );
 
+    /** Remove and delete consecutive parts and everything below them, with one notification
+      * @param row of the first part
+      * @param count is the number of parts
+      * @param parent of the parts, or an invalid index for top level parts
+      * @return true if the parts were removed
+      */
+    bool removeRows( int row, int count, const QModelIndex& parent = QModelIndex() ) override;
+
+    /** Move consecutive parts and everything below them to another place in the tree, with one notification
+      * @param sourceParent is the current parent of the parts
+      * @param sourceRow is the row of the first part
+      * @param count is the number of parts
+      * @param destinationParent is the new parent, which must not be one of the parts or below them
+      * @param destinationChild is the row of the new parent the parts go before
+      * @return true if the parts were moved
+      */
+    bool moveRows( const QModelIndex& sourceParent, int sourceRow, int count,
+                   const QModelIndex& destinationParent, int destinationChild ) override;
+
+    /** Rename a part with the edit role, or tick a checkbox with the check state role.
+      *  Ticking a checkbox applies to the item and everything below it, as in the context menu
+      * @param index of the item
+      * @param value is the new name or Qt::CheckState
+      * @param role is Qt::EditRole or Qt::CheckStateRole
+      * @return true if the item was changed
+      */
     bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
 
+    /** Replace the whole tree, e.g. when a project is opened
+      * @param parts are the new top level items, ownership passes to the model
+      */
+    void replaceParts( const QList<ModelPart*>& parts );
+
+    /** Get the index of a part, e.g. one found by a search
+      * @param part is the item
+      * @return the index of the item's name column, or an invalid index for the root
+      */
+    QModelIndex indexOf( ModelPart* part ) const;
+
+    /** Show or hide items and everything below them
+      * @param items are the items, or an invalid index for every item in the tree
+      * @param visible is the new visibility
+      */
+    void setSubtreeVisible( const QModelIndexList& items, bool visible );
+
+    /** Switch the shrink of items and everything below them on or off. The
+      *  exploded meshes or shrink filters are built for all the parts in parallel.
+      * @param items are the items, or an invalid index for every item in the tree
+      * @param shrink is the new shrink state
+      */
+    void setSubtreeShrink( const QModelIndexList& items, bool shrink );
+
+    /** Switch the clip of items and everything below them on or off
+      * @param items are the items, or an invalid index for every item in the tree
+      * @param clip is the new clip state
+      */
+    void setSubtreeClip( const QModelIndexList& items, bool clip );
+
+    /** Colour items and everything below them
+      * @param items are the items, or an invalid index for every item in the tree
+      */
+    void setSubtreeColour( const QModelIndexList& items, unsigned char R, unsigned char G, unsigned char B );
+
+    /** Set the shrink factor of the parts with shrink on among items and everything below them.
+      *  Shrink is not switched on, and branches still held as records are not made
+      * @param items are the items, or an invalid index for every item in the tree
+      * @param factor is the fraction of its size each triangle keeps, 0 to 1
+      */
+    void setSubtreeShrinkFactor( const QModelIndexList& items, double factor );
+
+signals:
+    /** Emitted when a checkbox is ticked or cleared through setData(), e.g. by clicking it
+      * @param index of the item, whose subtree has changed
+      * @param column is VisibleColumn, ShrinkColumn or ClipColumn
+      * @param checked is the new state
+      */
+    void subtreeChecked( const QModelIndex& index, int column, bool checked );
 
 
 private:
+    /** Drop the items that are below another of the items, so each part is changed once
+      * @param items are the items, e.g. the selected rows
+      * @return the remaining items, or just an invalid index if one of the items is
+      */
+    QModelIndexList topItems( const QModelIndexList& items ) const;
+
+    /** List items and everything below them, parents before their children
+      * @param items are from topItems()
+      */
+    QList<ModelPart*> subtreeParts( const QModelIndexList& items );
+
+    /** Switch the shrink of the parts on, doing the heavy work for all of them in parallel
+      */
+    void enableShrink( const QList<ModelPart*>& parts );
+
+    /** Tell the views that columns of items and everything below them changed
+      * @param items are from topItems()
+      */
+    void emitSubtreeChanged( const QModelIndexList& items, int firstColumn, int lastColumn );
+
+    /** Get the part flag shown in a checkbox column
+      * @param column is VisibleColumn, ShrinkColumn or ClipColumn
+      * @return the flag
+      */
+    static ModelPart::Flag columnFlag( int column );
+
     ModelPart *rootItem;    /**< This is a pointer to the item at the base of the tree */
 };
 #endif
@@ -0,0 +1,285 @@
+/**
+  * @file OverviewBatch.cpp
+  * @brief Implementation of the OverviewBatch class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "OverviewBatch.h"
+#include "ModelPart.h"
+
+#include <vtkCommand.h>
+#include <vtkCompositeDataDisplayAttributes.h>
+#include <vtkCompositePolyDataMapper2.h>
+#include <vtkMultiBlockDataSet.h>
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+#include <vtkTransform.h>
+#include <vtkTransformPolyDataFilter.h>
+
+#include <algorithm>
+
+/**
+ * @brief OverviewBatch::OverviewBatch
+ * @param renderer The renderer the batch's actor is added to.
+ */
+OverviewBatch::OverviewBatch(vtkRenderer* renderer)
+    : renderer(renderer), root(nullptr), enabled(false), structureDirty(false) {
+    observer = renderer->AddObserver(vtkCommand::StartEvent, this, &OverviewBatch::onStartRender);
+}
+
+/**
+ * @brief OverviewBatch::~OverviewBatch
+ */
+OverviewBatch::~OverviewBatch() {
+    setEnabled(false, nullptr);
+    renderer->RemoveObserver(observer);
+}
+
+/**
+ * @brief OverviewBatch::setEnabled
+ * @param enabled True to batch the tree's parts.
+ * @param root The root of the part tree.
+ */
+void OverviewBatch::setEnabled(bool enabled, ModelPart* root) {
+    this->root = root;
+    if (enabled == this->enabled)
+        return;
+
+    this->enabled = enabled;
+    if (enabled) {
+        attributes = vtkSmartPointer<vtkCompositeDataDisplayAttributes>::New();
+        mapper = vtkSmartPointer<vtkCompositePolyDataMapper2>::New();
+        mapper->SetCompositeDataDisplayAttributes(attributes);
+        mapper->SetClippingPlanes(sectionPlanes);
+        actor = vtkSmartPointer<vtkActor>::New();
+        actor->SetMapper(mapper);
+        renderer->AddActor(actor);
+        structureDirty = true;
+        return;
+    }
+
+    for (ModelPart* part : std::as_const(members)) {
+        part->setBatch(nullptr);
+        part->setDrawnByBatch(false);
+    }
+    members.clear();
+    blocks.clear();
+    changed.clear();
+    structureDirty = false;
+
+    if (actor)
+        renderer->RemoveActor(actor);
+    actor = nullptr;
+    mapper = nullptr;
+    attributes = nullptr;
+    dataSet = nullptr;
+}
+
+/**
+ * @brief OverviewBatch::isEnabled
+ * @return True while the overview is on.
+ */
+bool OverviewBatch::isEnabled() const {
+    return enabled;
+}
+
+/**
+ * @brief OverviewBatch::addPart
+ * @param part The part.
+ */
+void OverviewBatch::addPart(ModelPart*) {
+    if (enabled)
+        structureDirty = true;
+}
+
+/**
+ * @brief OverviewBatch::removePart
+ * The block is hidden straight away and dropped at the next rebuild.
+ * @param part The part.
+ */
+void OverviewBatch::removePart(ModelPart* part) {
+    if (!members.remove(part))
+        return;
+
+    part->setBatch(nullptr);
+    changed.remove(part);
+
+    auto found = blocks.find(part);
+    if (found == blocks.end())
+        return;
+
+    mapper->SetBlockVisibility(found->index, false);
+    blocks.erase(found);
+    structureDirty = true;
+}
+
+/**
+ * @brief OverviewBatch::partChanged
+ * A part without a block that can now be drawn by the batch, e.g. one that
+ * has been shown, needs the blocks rebuilt to get one.
+ * @param part The part.
+ */
+void OverviewBatch::partChanged(ModelPart* part) {
+    if (blocks.contains(part))
+        changed.insert(part);
+    else if (members.contains(part) && batchable(part))
+        structureDirty = true;
+}
+
+/**
+ * @brief OverviewBatch::setSectionPlanes
+ * @param planes The planes, or nullptr for none.
+ */
+void OverviewBatch::setSectionPlanes(vtkPlaneCollection* planes) {
+    sectionPlanes = planes;
+    if (mapper)
+        mapper->SetClippingPlanes(planes);
+}
+
+/**
+ * @brief OverviewBatch::batchedParts
+ * @return The number of parts whose block is shown.
+ */
+int OverviewBatch::batchedParts() const {
+    return std::count_if(blocks.cbegin(), blocks.cend(), [](const Block& block) { return block.drawn; });
+}
+
+/**
+ * @brief OverviewBatch::update
+ * A part that has been moved or given new geometry needs its block rebuilt;
+ * anything else is a change of attributes.
+ */
+void OverviewBatch::update() {
+    if (!enabled)
+        return;
+
+    for (ModelPart* part : std::as_const(changed)) {
+        const Block& block = blocks[part];
+        double position[3];
+        part->getPosition(position);
+        if (part->getSource() != block.source || !std::equal(position, position + 3, block.position))
+            structureDirty = true;
+    }
+
+    if (structureDirty) {
+        rebuild();
+    } else {
+        for (ModelPart* part : std::as_const(changed))
+            refresh(part);
+    }
+    changed.clear();
+}
+
+/**
+ * @brief OverviewBatch::onStartRender
+ */
+void OverviewBatch::onStartRender(vtkObject*, unsigned long, void*) {
+    update();
+}
+
+/**
+ * @brief OverviewBatch::rebuild
+ * Blocks of parts that haven't moved or changed geometry are reused, so only
+ * new parts cost a copy, and that only for parts away from the origin. Parts
+ * the batch wouldn't draw get no block at all, so hidden, filtered and
+ * instanced parts away from the origin don't hold a translated copy.
+ */
+void OverviewBatch::rebuild() {
+    QHash<ModelPart*, Block> previous;
+    previous.swap(blocks);
+    QSet<ModelPart*> previousMembers;
+    previousMembers.swap(members);
+
+    dataSet = vtkSmartPointer<vtkMultiBlockDataSet>::New();
+    QList<ModelPart*> stack;
+    if (root)
+        stack.append(root);
+
+    while (!stack.isEmpty()) {
+        ModelPart* part = stack.takeLast();
+        for (int i = 0; i < part->childCount(); ++i)
+            stack.append(part->child(i));
+
+        vtkPolyData* source = part->getSource();
+        if (!source)
+            continue;
+
+        /* Still told about changes, so that it gets a block once it can be drawn */
+        members.insert(part);
+        part->setBatch(this);
+        if (!batchable(part)) {
+            part->setDrawnByBatch(false);
+            continue;
+        }
+
+        double position[3];
+        part->getPosition(position);
+
+        Block block = previous.take(part);
+        if (block.source != source || !std::equal(position, position + 3, block.position)) {
+            block.source = source;
+            std::copy(position, position + 3, block.position);
+
+            /* Each block needs its own object, as the attributes are keyed by it */
+            if (position[0] == 0.0 && position[1] == 0.0 && position[2] == 0.0) {
+                block.mesh = vtkSmartPointer<vtkPolyData>::New();
+                block.mesh->ShallowCopy(source);
+            } else {
+                vtkNew<vtkTransform> translation;
+                translation->Translate(position);
+
+                vtkNew<vtkTransformPolyDataFilter> transform;
+                transform->SetInputData(source);
+                transform->SetTransform(translation);
+                transform->Update();
+                block.mesh = transform->GetOutput();
+            }
+        }
+
+        const unsigned int blockNumber = dataSet->GetNumberOfBlocks();
+        dataSet->SetBlock(blockNumber, block.mesh);
+        block.index = blockNumber + 1;      // flat index 0 is the dataset itself
+        block.drawn = false;
+        blocks.insert(part, block);
+    }
+
+    /* Parts no longer in the tree have already been removed */
+    for (ModelPart* part : std::as_const(previousMembers)) {
+        if (!members.contains(part)) {
+            part->setBatch(nullptr);
+            part->setDrawnByBatch(false);
+        }
+    }
+
+    mapper->RemoveBlockVisibilities();
+    mapper->RemoveBlockColors();
+    mapper->SetInputDataObject(dataSet);
+    for (auto it = blocks.constBegin(); it != blocks.constEnd(); ++it)
+        refresh(it.key());
+
+    structureDirty = false;
+}
+
+/**
+ * @brief OverviewBatch::refresh
+ * @param part The part.
+ */
+void OverviewBatch::refresh(ModelPart* part) {
+    Block& block = blocks[part];
+    block.drawn = batchable(part);
+
+    const double colour[3] = { part->getColourR() / 255.0, part->getColourG() / 255.0, part->getColourB() / 255.0 };
+    mapper->SetBlockVisibility(block.index, block.drawn);
+    mapper->SetBlockColor(block.index, colour);
+    part->setDrawnByBatch(block.drawn);
+}
+
+/**
+ * @brief OverviewBatch::batchable
+ * @param part The part.
+ * @return True if the part is shown, has no shrink or clip and isn't drawn by the instancer.
+ */
+bool OverviewBatch::batchable(ModelPart* part) {
+    return part->isInstanceable() && !part->isDrawnByInstancer();
+}
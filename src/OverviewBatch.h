@@ -0,0 +1,153 @@
+/** @file OverviewBatch.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Batched overview mode drawing many parts through one composite mapper
+  */
+
+#ifndef VIEWER_OVERVIEWBATCH_H
+#define VIEWER_OVERVIEWBATCH_H
+
+#include <QHash>
+#include <QSet>
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkPlaneCollection.h>
+#include <vtkPolyData.h>
+
+class ModelPart;
+class vtkCompositeDataDisplayAttributes;
+class vtkCompositePolyDataMapper2;
+class vtkMultiBlockDataSet;
+class vtkObject;
+class vtkRenderer;
+
+/**
+ * @class OverviewBatch
+ * @brief Draws every plain part of the tree as a block of one composite dataset.
+ *
+ * All parts share one material apart from their colour, so in the batched
+ * overview they go into a single vtkMultiBlockDataSet drawn by a
+ * vtkCompositePolyDataMapper2. The mapper uploads the blocks into shared
+ * buffers and sets the render state once for all of them, rather than once
+ * per actor, which is what costs the most on integrated and software OpenGL.
+ *
+ * Each block is a shallow copy of its part's mesh, so the batch costs no
+ * geometry memory for parts at the origin. Only parts the batch draws get a
+ * block: hidden parts, parts with a shrink or clip and parts drawn by the
+ * PartInstancer draw themselves, or not at all. Colour and visibility are
+ * block attributes, so colouring or hiding a part only changes its
+ * attributes. The blocks are rebuilt when parts are added, removed or moved,
+ * or when a part without a block can be drawn by the batch.
+ *
+ * Changes are gathered and applied when the renderer next renders.
+ */
+class OverviewBatch {
+public:
+    /**
+     * @brief Constructor for the OverviewBatch class.
+     * @param renderer The renderer the batch's actor is added to.
+     */
+    explicit OverviewBatch(vtkRenderer* renderer);
+
+    /**
+     * @brief Destructor, lets every part draw itself again.
+     */
+    ~OverviewBatch();
+
+    /**
+     * @brief Switches the batched overview on or off.
+     * @param enabled True to batch the tree's parts.
+     * @param root The root of the part tree.
+     */
+    void setEnabled(bool enabled, ModelPart* root);
+
+    /**
+     * @brief Returns true while the batched overview is on.
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief Adds a part that has just been given geometry, if the overview is on.
+     * @param part The part.
+     */
+    void addPart(ModelPart* part);
+
+    /**
+     * @brief Removes a part, e.g. when it is deleted.
+     * @param part The part.
+     */
+    void removePart(ModelPart* part);
+
+    /**
+     * @brief Marks a part's visibility, colour or filters as changed.
+     * @param part The part.
+     */
+    void partChanged(ModelPart* part);
+
+    /**
+     * @brief Sets the section planes that clip the batch.
+     * @param planes The planes, or nullptr for none.
+     */
+    void setSectionPlanes(vtkPlaneCollection* planes);
+
+    /**
+     * @brief Returns the number of parts drawn by the batch.
+     */
+    int batchedParts() const;
+
+    /**
+     * @brief Applies the gathered changes. Called before each render.
+     */
+    void update();
+
+private:
+    /**
+     * @brief Renderer StartEvent callback.
+     */
+    void onStartRender(vtkObject* caller, unsigned long event, void* callData);
+
+    /**
+     * @brief Rebuilds the blocks from the tree.
+     */
+    void rebuild();
+
+    /**
+     * @brief Sets a part's block attributes and whether its own actor is hidden.
+     * @param part The part.
+     */
+    void refresh(ModelPart* part);
+
+    /**
+     * @brief Returns true if the batch would draw the part, i.e. it is shown, has no filters and isn't instanced.
+     * @param part The part.
+     */
+    static bool batchable(ModelPart* part);
+
+    /**
+     * @brief A part's block and the position its geometry was placed at.
+     */
+    struct Block {
+        vtkSmartPointer<vtkPolyData>    mesh;                   /**< The part's geometry in world coordinates */
+        vtkPolyData*                    source = nullptr;       /**< Part mesh the block was built from */
+        double                          position[3];            /**< Part position the block was built for */
+        unsigned int                    index = 0;              /**< Flat index of the block in the dataset */
+        bool                            drawn = false;          /**< True while the block is shown */
+    };
+
+    vtkRenderer*                                        renderer;       /**< Renderer the actor is added to */
+    unsigned long                                       observer;       /**< StartEvent observer tag */
+    ModelPart*                                          root;           /**< Root of the part tree */
+    bool                                                enabled;        /**< True while the overview is on */
+    bool                                                structureDirty; /**< True when the blocks must be rebuilt */
+    QSet<ModelPart*>                                    members;        /**< Parts with geometry that report their changes to the batch */
+    QHash<ModelPart*, Block>                            blocks;         /**< Block of each part the batch draws */
+    QSet<ModelPart*>                                    changed;        /**< Parts to refresh at the next render */
+    vtkSmartPointer<vtkMultiBlockDataSet>               dataSet;        /**< The blocks */
+    vtkSmartPointer<vtkCompositeDataDisplayAttributes>  attributes;     /**< Per-block colour and visibility */
+    vtkSmartPointer<vtkCompositePolyDataMapper2>        mapper;         /**< Draws the blocks */
+    vtkSmartPointer<vtkActor>                           actor;          /**< Actor of the batch */
+    vtkSmartPointer<vtkPlaneCollection>                 sectionPlanes;  /**< Planes clipping the batch */
+};
+
+#endif
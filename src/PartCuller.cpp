@@ -0,0 +1,219 @@
+/**
+  * @file PartCuller.cpp
+  * @brief Implementation of the PartCuller class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "PartCuller.h"
+#include "ModelPart.h"
+
+#include <vtkCamera.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkProp.h>
+#include <vtkRenderer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+vtkStandardNewMacro(PartCuller);
+
+namespace {
+
+/**
+ * @brief Where a box lies relative to the view frustum.
+ */
+enum class Containment { Outside, Partial, Inside };
+
+/**
+ * @brief Tests a box against the frustum planes, whose normals point inwards.
+ */
+Containment classify(const double bounds[6], const double planes[24]) {
+    Containment result = Containment::Inside;
+    for (int i = 0; i < 6; ++i) {
+        const double* plane = planes + 4 * i;
+
+        /* The corners furthest along and against the plane's normal */
+        double inner = plane[3], outer = plane[3];
+        for (int j = 0; j < 3; ++j) {
+            inner += plane[j] * (plane[j] > 0.0 ? bounds[2 * j + 1] : bounds[2 * j]);
+            outer += plane[j] * (plane[j] > 0.0 ? bounds[2 * j] : bounds[2 * j + 1]);
+        }
+
+        if (inner < 0.0)
+            return Containment::Outside;
+        if (outer < 0.0)
+            result = Containment::Partial;
+    }
+    return result;
+}
+
+/**
+ * @brief Returns the projected size of a box's bounding sphere, in pixels.
+ */
+double projectedPixels(const double bounds[6], vtkCamera* camera, const double eye[3], double tanHalfAngle,
+                       int viewHeight) {
+    const double centre[3] = { (bounds[0] + bounds[1]) / 2.0, (bounds[2] + bounds[3]) / 2.0, (bounds[4] + bounds[5]) / 2.0 };
+    const double corner[3] = { bounds[1], bounds[3], bounds[5] };
+    const double radius = std::sqrt(vtkMath::Distance2BetweenPoints(centre, corner));
+
+    if (camera->GetParallelProjection())
+        return radius / camera->GetParallelScale() * viewHeight;
+
+    const double distance = std::sqrt(vtkMath::Distance2BetweenPoints(eye, centre));
+    if (distance <= radius)
+        return std::numeric_limits<double>::max();
+    return radius * viewHeight / (distance * tanHalfAngle);
+}
+
+} // namespace
+
+/**
+ * @brief PartCuller::PartCuller
+ */
+PartCuller::PartCuller()
+    : root(nullptr), minPixels(2.0), submitted(0), culledCount(0), subtreeCount(0) {
+}
+
+/**
+ * @brief PartCuller::setRoot
+ * @param root The root, or nullptr to cull nothing.
+ */
+void PartCuller::setRoot(ModelPart* root) {
+    this->root = root;
+}
+
+/**
+ * @brief PartCuller::setMinimumPixels
+ * @param pixels The size across a part's bounding sphere, 0 for no small-feature culling.
+ */
+void PartCuller::setMinimumPixels(double pixels) {
+    minPixels = std::max(0.0, pixels);
+}
+
+/**
+ * @brief PartCuller::minimumPixels
+ * @return The size in pixels.
+ */
+double PartCuller::minimumPixels() const {
+    return minPixels;
+}
+
+/**
+ * @brief PartCuller::submittedParts
+ * @return The number of part actors kept in the last frame.
+ */
+int PartCuller::submittedParts() const {
+    return submitted;
+}
+
+/**
+ * @brief PartCuller::culledParts
+ * @return The number of part actors culled in the last frame.
+ */
+int PartCuller::culledParts() const {
+    return culledCount;
+}
+
+/**
+ * @brief PartCuller::culledSubtrees
+ * @return The number of subassemblies culled as a whole in the last frame.
+ */
+int PartCuller::culledSubtrees() const {
+    return subtreeCount;
+}
+
+/**
+ * @brief PartCuller::Cull
+ * Walks the tree depth first, carrying down whether the parent's box was
+ * wholly inside the frustum, then drops the culled actors from the list.
+ * @param renderer The renderer.
+ * @param propList The visible props, compacted in place.
+ * @param listLength The number of props, updated to the number kept.
+ * @return Always 0.
+ */
+double PartCuller::Cull(vtkRenderer* renderer, vtkProp** propList, int& listLength, int&) {
+    culled.clear();
+    partActors.clear();
+    submitted = culledCount = subtreeCount = 0;
+
+    const int* size = renderer->GetSize();
+    if (!root || size[1] <= 0)
+        return 0.0;
+
+    vtkCamera* camera = renderer->GetActiveCamera();
+    double planes[24];
+    camera->GetFrustumPlanes(renderer->GetTiledAspectRatio(), planes);
+    double eye[3];
+    camera->GetPosition(eye);
+    const double tanHalfAngle = std::tan(vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2.0);
+
+    std::vector<std::pair<ModelPart*, bool>> stack;
+    for (int i = 0; i < root->childCount(); ++i)
+        stack.emplace_back(root->child(i), false);
+
+    double bounds[6];
+    while (!stack.empty()) {
+        auto [part, inside] = stack.back();
+        stack.pop_back();
+
+        if (!part->getSubtreeBounds(bounds))
+            continue;
+
+        Containment containment = inside ? Containment::Inside : classify(bounds, planes);
+        if (containment == Containment::Outside ||
+            (minPixels > 0.0 && projectedPixels(bounds, camera, eye, tanHalfAngle, size[1]) < minPixels)) {
+            if (part->childCount() > 0)
+                ++subtreeCount;
+            cullSubtree(part);
+            continue;
+        }
+
+        /* The part's own geometry may be outside even though its subtree isn't */
+        if (vtkProp* actor = part->getActor()) {
+            partActors.insert(actor);
+            if (part->childCount() > 0 && part->getBounds(bounds) &&
+                ((containment != Containment::Inside && classify(bounds, planes) == Containment::Outside) ||
+                 (minPixels > 0.0 && projectedPixels(bounds, camera, eye, tanHalfAngle, size[1]) < minPixels)))
+                culled.insert(actor);
+        }
+
+        for (int i = 0; i < part->childCount(); ++i)
+            stack.emplace_back(part->child(i), containment == Containment::Inside);
+    }
+
+    int kept = 0;
+    for (int i = 0; i < listLength; ++i) {
+        if (culled.contains(propList[i])) {
+            ++culledCount;
+            continue;
+        }
+        if (partActors.contains(propList[i]))
+            ++submitted;
+        propList[kept++] = propList[i];
+    }
+    listLength = kept;
+    return 0.0;
+}
+
+/**
+ * @brief PartCuller::cullSubtree
+ * @param part The root of the subtree.
+ */
+void PartCuller::cullSubtree(ModelPart* part) {
+    std::vector<ModelPart*> stack = { part };
+    while (!stack.empty()) {
+        ModelPart* next = stack.back();
+        stack.pop_back();
+
+        if (vtkProp* actor = next->getActor()) {
+            partActors.insert(actor);
+            culled.insert(actor);
+        }
+        for (int i = 0; i < next->childCount(); ++i)
+            stack.push_back(next->child(i));
+    }
+}
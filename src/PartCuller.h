@@ -0,0 +1,101 @@
+/** @file PartCuller.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Hierarchical frustum and small-feature culling over the part tree
+  */
+
+#ifndef VIEWER_PARTCULLER_H
+#define VIEWER_PARTCULLER_H
+
+#include <QSet>
+#include <vtkCuller.h>
+
+class ModelPart;
+class vtkProp;
+
+/**
+ * @class PartCuller
+ * @brief Removes the actors of off-screen and tiny parts before the renderer draws them.
+ *
+ * Added to the renderer's cullers, which are given the list of visible props
+ * every frame. The part tree is walked from the root using each part's cached
+ * subtree bounds (see ModelPart::getSubtreeBounds()): a subassembly whose box
+ * is outside the camera's frustum, or whose projected size is below the
+ * threshold, is culled as a whole without visiting its parts one by one.
+ * A box wholly inside the frustum skips the plane tests for everything below it.
+ *
+ * Props that aren't part actors, such as the instanced shapes, the section
+ * plane widgets and the overlays, are left for the renderer's other cullers.
+ */
+class PartCuller : public vtkCuller {
+public:
+    static PartCuller* New();
+    vtkTypeMacro(PartCuller, vtkCuller);
+
+    /**
+     * @brief Sets the root of the part tree.
+     * @param root The root, or nullptr to cull nothing.
+     */
+    void setRoot(ModelPart* root);
+
+    /**
+     * @brief Sets the projected size, in pixels, below which parts are culled.
+     * @param pixels The size across a part's bounding sphere, 0 for no small-feature culling.
+     */
+    void setMinimumPixels(double pixels);
+
+    /**
+     * @brief Returns the projected size below which parts are culled.
+     */
+    double minimumPixels() const;
+
+    /**
+     * @brief Returns the number of part actors passed on to the renderer in the last frame.
+     */
+    int submittedParts() const;
+
+    /**
+     * @brief Returns the number of part actors culled in the last frame.
+     */
+    int culledParts() const;
+
+    /**
+     * @brief Returns the number of subassemblies culled as a whole in the last frame.
+     */
+    int culledSubtrees() const;
+
+    /**
+     * @brief Culls the part actors in a prop list. Called by the renderer every frame.
+     * @param renderer The renderer.
+     * @param propList The visible props, compacted in place.
+     * @param listLength The number of props, updated to the number kept.
+     * @param initialized Unused, the render times are left to the other cullers.
+     * @return Always 0.
+     */
+    double Cull(vtkRenderer* renderer, vtkProp** propList, int& listLength, int& initialized) override;
+
+protected:
+    PartCuller();
+    ~PartCuller() override = default;
+
+private:
+    PartCuller(const PartCuller&) = delete;
+    void operator=(const PartCuller&) = delete;
+
+    /**
+     * @brief Adds the actors of a subtree to the culled set.
+     * @param part The root of the subtree.
+     */
+    void cullSubtree(ModelPart* part);
+
+    ModelPart*                                  root;           /**< Root of the part tree, may be null */
+    double                                      minPixels;      /**< Projected size below which parts are culled */
+    QSet<vtkProp*>                              culled;         /**< Part actors culled in the current frame */
+    QSet<vtkProp*>                              partActors;     /**< Part actors visited in the current frame */
+    int                                         submitted;      /**< Part actors kept in the last frame */
+    int                                         culledCount;    /**< Part actors culled in the last frame */
+    int                                         subtreeCount;   /**< Subassemblies culled whole in the last frame */
+};
+
+#endif
@@ -0,0 +1,313 @@
+/**
+  * @file PartInstancer.cpp
+  * @brief Implementation of the PartInstancer class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "PartInstancer.h"
+#include "ContentHash.h"
+#include "ModelPart.h"
+
+#include <vtkCellArray.h>
+#include <vtkCommand.h>
+#include <vtkDataArray.h>
+#include <vtkGlyph3DMapper.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkRenderer.h>
+#include <vtkSMPTools.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+/* Points are compared on a grid of this fraction of the mesh's size, which
+ * absorbs the float rounding of copies exported at different positions */
+const double shapeTolerance = 1e-5;
+
+} // namespace
+
+/**
+ * @brief PartInstancer::PartInstancer
+ * @param renderer The renderer the instanced actors are added to.
+ */
+PartInstancer::PartInstancer(vtkRenderer* renderer)
+    : renderer(renderer) {
+    observer = renderer->AddObserver(vtkCommand::StartEvent, this, &PartInstancer::onStartRender);
+}
+
+/**
+ * @brief PartInstancer::~PartInstancer
+ */
+PartInstancer::~PartInstancer() {
+    renderer->RemoveObserver(observer);
+
+    for (auto it = shapes.begin(); it != shapes.end(); ++it) {
+        for (ModelPart* part : it->parts) {
+            part->setInstancer(nullptr);
+            part->setDrawnByInstancer(false);
+        }
+        if (it->actor)
+            renderer->RemoveActor(it->actor);
+    }
+}
+
+/**
+ * @brief PartInstancer::shapeKey
+ * Hashes the points, rounded to a grid relative to the bounds' lower corner,
+ * and the connectivity. Identical copies at different positions get the same
+ * key, and any difference in topology or shape changes it.
+ * @param mesh The mesh.
+ * @param origin Receives the lower corner of the mesh's bounds.
+ * @return The key, or 0 for an empty mesh.
+ */
+quint64 PartInstancer::shapeKey(vtkPolyData* mesh, double origin[3]) {
+    origin[0] = origin[1] = origin[2] = 0.0;
+
+    vtkPoints* points = mesh ? mesh->GetPoints() : nullptr;
+    vtkCellArray* polys = mesh ? mesh->GetPolys() : nullptr;
+    if (!points || !polys || points->GetNumberOfPoints() == 0)
+        return 0;
+
+    double bounds[6];
+    mesh->GetBounds(bounds);
+    origin[0] = bounds[0];
+    origin[1] = bounds[2];
+    origin[2] = bounds[4];
+
+    const double size = std::max({ bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4] });
+    const double quantum = size > 0.0 ? size * shapeTolerance : 1.0;
+
+    const vtkIdType numPoints = points->GetNumberOfPoints();
+    std::vector<qint64> grid(3 * numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType first, vtkIdType last) {
+        double p[3];
+        for (vtkIdType i = first; i < last; ++i) {
+            points->GetPoint(i, p);
+            for (int j = 0; j < 3; ++j)
+                grid[3 * i + j] = std::llround((p[j] - origin[j]) / quantum);
+        }
+    });
+
+    /* Meshes from the cache and from a fresh read may store their ids with
+     * different widths, so the ids are widened before hashing */
+    vtkDataArray* connectivity = polys->GetConnectivityArray();
+    std::vector<qint64> ids(connectivity->GetNumberOfValues());
+    vtkSMPTools::For(0, vtkIdType(ids.size()), [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType i = first; i < last; ++i)
+            ids[i] = static_cast<qint64>(connectivity->GetComponent(i, 0));
+    });
+
+    quint64 key = ContentHash::hash(reinterpret_cast<const uchar*>(grid.data()), qint64(grid.size() * sizeof(qint64)),
+                                    quint64(polys->GetNumberOfCells()));
+    key = ContentHash::hash(reinterpret_cast<const uchar*>(ids.data()), qint64(ids.size() * sizeof(qint64)), key);
+    return key ? key : 1;
+}
+
+/**
+ * @brief PartInstancer::addPart
+ * @param part The part, after ModelPart::setPipeline().
+ * @param key The shape key of the part's mesh.
+ * @param origin The origin returned with the key, in the part's own coordinates.
+ */
+void PartInstancer::addPart(ModelPart* part, quint64 key, const double origin[3]) {
+    vtkPolyData* mesh = part->getSource();
+    if (!mesh || key == 0)
+        return;
+
+    removePart(part);
+
+    auto found = shapes.find(key);
+    if (found == shapes.end()) {
+        Shape shape;
+        shape.mesh = mesh;
+        std::copy(origin, origin + 3, shape.origin);
+        found = shapes.insert(key, shape);
+    } else if (found->mesh->GetNumberOfPoints() != mesh->GetNumberOfPoints() ||
+               found->mesh->GetNumberOfCells() != mesh->GetNumberOfCells()) {
+        return;     // a hash collision, the part just draws itself
+    } else if (found->mesh != mesh) {
+        /* Place the shared mesh where the part's own mesh was */
+        double position[3];
+        part->getPosition(position);
+        for (int j = 0; j < 3; ++j)
+            position[j] += origin[j] - found->origin[j];
+        part->shareSource(found->mesh, position);
+    }
+
+    found->parts.append(part);
+    partShapes.insert(part, key);
+    part->setInstancer(this);
+    changed.insert(key);
+}
+
+/**
+ * @brief PartInstancer::removePart
+ * @param part The part.
+ */
+void PartInstancer::removePart(ModelPart* part) {
+    auto member = partShapes.find(part);
+    if (member == partShapes.end())
+        return;
+
+    const quint64 key = *member;
+    partShapes.erase(member);
+    part->setInstancer(nullptr);
+    part->setDrawnByInstancer(false);
+
+    Shape& shape = shapes[key];
+    shape.parts.removeOne(part);
+    if (!shape.parts.isEmpty()) {
+        changed.insert(key);
+        return;
+    }
+
+    if (shape.actor)
+        renderer->RemoveActor(shape.actor);
+    shapes.remove(key);
+    changed.remove(key);
+}
+
+/**
+ * @brief PartInstancer::partChanged
+ * @param part The part.
+ */
+void PartInstancer::partChanged(ModelPart* part) {
+    auto member = partShapes.constFind(part);
+    if (member != partShapes.constEnd())
+        changed.insert(*member);
+}
+
+/**
+ * @brief PartInstancer::update
+ */
+void PartInstancer::update() {
+    for (quint64 key : std::as_const(changed)) {
+        auto shape = shapes.find(key);
+        if (shape != shapes.end())
+            rebuild(*shape);
+    }
+    changed.clear();
+}
+
+/**
+ * @brief PartInstancer::setSectionPlanes
+ * @param planes The planes, or nullptr for none.
+ */
+void PartInstancer::setSectionPlanes(vtkPlaneCollection* planes) {
+    sectionPlanes = planes;
+    for (const Shape& shape : std::as_const(shapes))
+        if (shape.mapper)
+            shape.mapper->SetClippingPlanes(planes);
+}
+
+/**
+ * @brief PartInstancer::sharedShapes
+ * @return The number of shapes that have more than one part.
+ */
+int PartInstancer::sharedShapes() const {
+    int count = 0;
+    for (const Shape& shape : shapes)
+        if (shape.parts.size() > 1)
+            ++count;
+    return count;
+}
+
+/**
+ * @brief PartInstancer::sharedParts
+ * @return The number of parts that share their mesh with another part.
+ */
+int PartInstancer::sharedParts() const {
+    int count = 0;
+    for (const Shape& shape : shapes)
+        if (shape.parts.size() > 1)
+            count += shape.parts.size();
+    return count;
+}
+
+/**
+ * @brief PartInstancer::bytesSaved
+ * Each part after the first of a shape would otherwise hold its own copy of the mesh.
+ * @return The memory saved, in bytes.
+ */
+qint64 PartInstancer::bytesSaved() const {
+    qint64 bytes = 0;
+    for (const Shape& shape : shapes)
+        bytes += qint64(shape.parts.size() - 1) * shape.mesh->GetActualMemorySize() * 1024;
+    return bytes;
+}
+
+/**
+ * @brief PartInstancer::rebuild
+ * A shape with a single part is left to the part's own actor. Otherwise the
+ * parts that can be instanced become points of the glyph mapper's input, at
+ * their positions and with their colours, and their own actors are hidden.
+ * @param shape The shape.
+ */
+void PartInstancer::rebuild(Shape& shape) {
+    if (shape.parts.size() < 2) {
+        for (ModelPart* part : shape.parts)
+            part->setDrawnByInstancer(false);
+        if (shape.actor)
+            renderer->RemoveActor(shape.actor);
+        shape.actor = nullptr;
+        shape.mapper = nullptr;
+        shape.instances = nullptr;
+        return;
+    }
+
+    if (!shape.mapper) {
+        shape.instances = vtkSmartPointer<vtkPolyData>::New();
+
+        shape.mapper = vtkSmartPointer<vtkGlyph3DMapper>::New();
+        shape.mapper->SetSourceData(shape.mesh);
+        shape.mapper->SetInputData(shape.instances);
+        shape.mapper->ScalingOff();
+        shape.mapper->OrientOff();
+        shape.mapper->SetScalarModeToUsePointFieldData();
+        shape.mapper->SelectColorArray("Colours");
+        shape.mapper->SetColorModeToDirectScalars();
+        shape.mapper->ScalarVisibilityOn();
+        shape.mapper->SetClippingPlanes(sectionPlanes);
+
+        shape.actor = vtkSmartPointer<vtkActor>::New();
+        shape.actor->SetMapper(shape.mapper);
+        renderer->AddActor(shape.actor);
+    }
+
+    vtkNew<vtkPoints> points;
+    vtkNew<vtkUnsignedCharArray> colours;
+    colours->SetName("Colours");
+    colours->SetNumberOfComponents(3);
+
+    for (ModelPart* part : shape.parts) {
+        const bool drawn = part->isInstanceable();
+        part->setDrawnByInstancer(drawn);
+        if (!drawn)
+            continue;
+
+        double position[3];
+        part->getPosition(position);
+        points->InsertNextPoint(position);
+        const unsigned char colour[3] = { part->getColourR(), part->getColourG(), part->getColourB() };
+        colours->InsertNextTypedTuple(colour);
+    }
+
+    shape.instances->SetPoints(points);
+    shape.instances->GetPointData()->AddArray(colours);
+    shape.actor->SetVisibility(points->GetNumberOfPoints() > 0);
+}
+
+/**
+ * @brief PartInstancer::onStartRender
+ * Rebuilding here rather than on every change means a batch of changes, such
+ * as colouring a subtree, costs one rebuild per shape.
+ */
+void PartInstancer::onStartRender(vtkObject*, unsigned long, void*) {
+    update();
+}
@@ -0,0 +1,147 @@
+/** @file PartInstancer.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Draws repeated parts as instances of one shared mesh
+  */
+
+#ifndef VIEWER_PARTINSTANCER_H
+#define VIEWER_PARTINSTANCER_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkPlaneCollection.h>
+#include <vtkPolyData.h>
+
+class ModelPart;
+class vtkGlyph3DMapper;
+class vtkObject;
+class vtkRenderer;
+
+/**
+ * @class PartInstancer
+ * @brief Detects parts with the same shape and draws them with one instanced mapper.
+ *
+ * STL files carry no transforms, so repeated parts such as bolts are stored as
+ * separate copies of the same mesh at different positions. Each loaded mesh is
+ * given a shape key by shapeKey(), a hash of its connectivity and of its
+ * points relative to the corner of its bounds, so translated copies share a
+ * key. Parts with the same key share the first one's vtkPolyData, each keeping
+ * only its translation and colour, and the duplicate meshes are released.
+ *
+ * While a shape has two or more parts, the parts that are visible and have no
+ * shrink or clip of their own are drawn together by a vtkGlyph3DMapper, which
+ * draws every instance from the same GPU buffers in one instanced draw call.
+ * Their own actors are hidden. Parts with a shrink or clip switched on draw
+ * themselves as before.
+ *
+ * Changes to parts only mark their shape for update. The instance positions
+ * and colours are rebuilt when the renderer next renders, so changing a whole
+ * subtree costs one rebuild per shape.
+ */
+class PartInstancer {
+public:
+    /**
+     * @brief Constructor for the PartInstancer class.
+     * @param renderer The renderer the instanced actors are added to.
+     */
+    explicit PartInstancer(vtkRenderer* renderer);
+
+    /**
+     * @brief Destructor, removes the instanced actors and lets every part draw itself again.
+     */
+    ~PartInstancer();
+
+    /**
+     * @brief Computes the shape key of a mesh. Safe to call from any thread.
+     * @param mesh The mesh.
+     * @param origin Receives the corner of the mesh's bounds that the key is relative to.
+     * @return The key, or 0 for an empty mesh.
+     */
+    static quint64 shapeKey(vtkPolyData* mesh, double origin[3]);
+
+    /**
+     * @brief Adds a part that has just been given its geometry.
+     *
+     * If a part with the same shape is already known, the part switches to
+     * that part's mesh and is moved to where its own mesh was.
+     * @param part The part, after ModelPart::setPipeline().
+     * @param key The shape key of the part's mesh.
+     * @param origin The origin returned with the key, in the part's own coordinates.
+     */
+    void addPart(ModelPart* part, quint64 key, const double origin[3]);
+
+    /**
+     * @brief Removes a part, e.g. when it is deleted.
+     * @param part The part.
+     */
+    void removePart(ModelPart* part);
+
+    /**
+     * @brief Marks a part's shape for update after its visibility, colour, shrink or clip changed.
+     * @param part The part.
+     */
+    void partChanged(ModelPart* part);
+
+    /**
+     * @brief Rebuilds the instances of every shape that has changed. Called before each render.
+     */
+    void update();
+
+
+    /**
+     * @brief Sets the section planes shared by all parts.
+     * @param planes The planes, or nullptr for none.
+     */
+    void setSectionPlanes(vtkPlaneCollection* planes);
+
+    /**
+     * @brief Returns the number of shapes that have more than one part.
+     */
+    int sharedShapes() const;
+
+    /**
+     * @brief Returns the number of parts that share their mesh with another part.
+     */
+    int sharedParts() const;
+
+    /**
+     * @brief Returns the memory released by dropping duplicate meshes, in bytes.
+     */
+    qint64 bytesSaved() const;
+
+private:
+    /**
+     * @brief Parts with the same shape and the mapper that draws them.
+     */
+    struct Shape {
+        vtkSmartPointer<vtkPolyData>            mesh;           /**< Mesh shared by the parts */
+        double                                  origin[3];      /**< Corner of the mesh's bounds */
+        QList<ModelPart*>                       parts;          /**< Parts with this shape, the mesh's owner first */
+        vtkSmartPointer<vtkPolyData>            instances;      /**< One point per drawn part, with its colour */
+        vtkSmartPointer<vtkGlyph3DMapper>       mapper;         /**< Instanced mapper, created for a second part */
+        vtkSmartPointer<vtkActor>               actor;          /**< Actor for the mapper */
+    };
+
+    /**
+     * @brief Rebuilds the instance points and colours of a shape.
+     */
+    void rebuild(Shape& shape);
+
+    /**
+     * @brief Renderer StartEvent callback.
+     */
+    void onStartRender(vtkObject* caller, unsigned long event, void* callData);
+
+    vtkRenderer*                                renderer;       /**< Renderer the actors are added to */
+    unsigned long                               observer;       /**< StartEvent observer tag */
+    vtkSmartPointer<vtkPlaneCollection>         sectionPlanes;  /**< Section planes shared by all parts */
+    QHash<quint64, Shape>                       shapes;         /**< Shapes by key */
+    QHash<ModelPart*, quint64>                  partShapes;     /**< Shape key of each part */
+    QSet<quint64>                               changed;        /**< Shapes to rebuild before the next render */
+};
+
+#endif
@@ -0,0 +1,178 @@
+/**
+  * @file PartLoader.cpp
+  * @brief Implementation of the PartLoader class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "PartLoader.h"
+
+#include <QMetaObject>
+#include <QThread>
+
+/**
+ * @brief PartLoader::PartLoader
+ * @param parent The parent object.
+ */
+PartLoader::PartLoader(QObject* parent)
+    : QObject(parent), cancelFlag(std::make_shared<std::atomic<bool>>(false)), done(0), total(0), tolerance(0.0), cache(nullptr), store(nullptr) {
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+/**
+ * @brief PartLoader::~PartLoader
+ * Drops queued files and waits for the files currently being read.
+ */
+PartLoader::~PartLoader() {
+    cancelFlag->store(true);
+    pool.clear();
+    pool.waitForDone();
+}
+
+/**
+ * @brief PartLoader::load
+ * Queues one job per file on the worker pool.
+ * @param fileNames The STL files to load.
+ */
+void PartLoader::load(const QStringList& fileNames) {
+    if (fileNames.isEmpty())
+        return;
+
+    total += fileNames.size();
+    emit progressChanged(done, total);
+
+    for (const QString& fileName : fileNames) {
+        PartSource origin;
+        origin.fileName = fileName;
+        queue(origin, nullptr);
+    }
+}
+
+/**
+ * @brief PartLoader::loadParts
+ * Queues one job per part on the worker pool. The sources are copied here on
+ * the GUI thread, the workers never touch the parts themselves.
+ * @param parts The parts to load.
+ */
+void PartLoader::loadParts(const QList<ModelPart*>& parts) {
+    if (parts.isEmpty())
+        return;
+
+    total += parts.size();
+    emit progressChanged(done, total);
+
+    for (ModelPart* part : parts)
+        queue(part->getGeometrySource(), part);
+}
+
+/**
+ * @brief PartLoader::queue
+ * @param origin Where to load the geometry from.
+ * @param part The part the geometry is for, or nullptr for a new part.
+ */
+void PartLoader::queue(const PartSource& origin, ModelPart* part) {
+    std::shared_ptr<std::atomic<bool>> cancelled = cancelFlag;
+    const double weldTolerance = tolerance;
+    GeometryCache* geometryCache = cache;
+    GeometryStore* geometryStore = store;
+
+    pool.start([this, origin, part, cancelled, weldTolerance, geometryCache, geometryStore]() {
+        PartPipeline pipeline;
+        pipeline.origin = origin;
+        if (!cancelled->load())
+            pipeline = ModelPart::buildPipeline(origin, weldTolerance, geometryCache, geometryStore);
+
+        /* Hand the result back to the GUI thread, VTK objects are not shared
+         * with any other thread so they can be passed across safely */
+        QMetaObject::invokeMethod(this, [this, part, pipeline, cancelled]() {
+            jobFinished(part, pipeline, cancelled);
+        }, Qt::QueuedConnection);
+    });
+}
+
+/**
+ * @brief PartLoader::cancel
+ * Cancels the current batch. Jobs that have not started are removed from the
+ * pool, and anything still running is ignored when it completes.
+ */
+void PartLoader::cancel() {
+    if (!isBusy())
+        return;
+
+    cancelFlag->store(true);
+    pool.clear();
+
+    /* Later batches get a fresh flag so they are not affected by this cancel */
+    cancelFlag = std::make_shared<std::atomic<bool>>(false);
+    done = total = 0;
+
+    emit finished(true);
+}
+
+/**
+ * @brief PartLoader::isBusy
+ * @return True while files are being loaded.
+ */
+bool PartLoader::isBusy() const {
+    return total > 0;
+}
+
+/**
+ * @brief PartLoader::setWeldTolerance
+ * @param tolerance Grid spacing for welding, 0 to weld identical vertices only.
+ */
+void PartLoader::setWeldTolerance(double tolerance) {
+    this->tolerance = tolerance;
+}
+
+/**
+ * @brief PartLoader::weldTolerance
+ * @return The vertex welding tolerance.
+ */
+double PartLoader::weldTolerance() const {
+    return tolerance;
+}
+
+/**
+ * @brief PartLoader::setCache
+ * @param cache The cache, or nullptr to load without one.
+ */
+void PartLoader::setCache(GeometryCache* cache) {
+    this->cache = cache;
+}
+
+/**
+ * @brief PartLoader::setStore
+ * @param store The store, or nullptr to always load.
+ */
+void PartLoader::setStore(GeometryStore* store) {
+    this->store = store;
+}
+
+/**
+ * @brief PartLoader::jobFinished
+ * Reports a finished job and the progress of the batch it belongs to.
+ * @param part The part the geometry is for, or nullptr for a new part.
+ * @param pipeline The pipeline built for the file.
+ * @param cancelled The cancel flag of the batch the job belongs to.
+ */
+void PartLoader::jobFinished(ModelPart* part, const PartPipeline& pipeline,
+                             const std::shared_ptr<std::atomic<bool>>& cancelled) {
+    if (cancelled->load())
+        return;
+
+    ++done;
+    if (!pipeline.source)
+        emit loadFailed(part ? part->name() : pipeline.origin.fileName);
+    else if (part)
+        emit partReady(part, pipeline);
+    else
+        emit partLoaded(pipeline.origin.fileName, pipeline);
+
+    emit progressChanged(done, total);
+
+    if (done == total) {
+        done = total = 0;
+        emit finished(false);
+    }
+}
@@ -0,0 +1,149 @@
+/** @file PartLoader.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Background loader that builds part pipelines on a pool of worker threads
+  */
+
+#ifndef VIEWER_PARTLOADER_H
+#define VIEWER_PARTLOADER_H
+
+#include "ModelPart.h"
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * @class PartLoader
+ * @brief Loads STL files off the GUI thread.
+ *
+ * Each file is read and its filter pipeline built by ModelPart::buildPipeline()
+ * on a worker thread, one file per thread, so a multi-file selection loads on
+ * all cores at once. Results are delivered back on the GUI thread through the
+ * partLoaded() signal, which is the point at which a part can safely be added
+ * to the tree and the renderer. Parts that are already in the tree, such as
+ * those of an opened project, are given their geometry through partReady().
+ */
+class PartLoader : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @brief Constructor for the PartLoader class.
+     * @param parent The parent object.
+     */
+    explicit PartLoader(QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor, cancels outstanding work and waits for running workers.
+     */
+    ~PartLoader();
+
+    /**
+     * @brief Queues files for loading. Files queued while a batch is running join that batch.
+     * @param fileNames The STL files to load.
+     */
+    void load(const QStringList& fileNames);
+
+    /**
+     * @brief Queues existing parts for loading from their geometry sources.
+     * @param parts The parts to load. They must stay alive until their partReady() or
+     *        loadFailed(), or until the batch is cancelled.
+     */
+    void loadParts(const QList<ModelPart*>& parts);
+
+    /**
+     * @brief Cancels the current batch. Results of files still being read are discarded.
+     */
+    void cancel();
+
+    /**
+     * @brief Returns true while a batch is loading.
+     */
+    bool isBusy() const;
+
+    /**
+     * @brief Sets the vertex welding tolerance used for files queued from now on.
+     * @param tolerance Grid spacing for welding, 0 to weld identical vertices only.
+     */
+    void setWeldTolerance(double tolerance);
+
+    /**
+     * @brief Returns the vertex welding tolerance.
+     */
+    double weldTolerance() const;
+
+    /**
+     * @brief Sets the processed geometry cache used for files queued from now on.
+     * @param cache The cache, or nullptr to load without one. Must outlive the loader.
+     */
+    void setCache(GeometryCache* cache);
+
+    /**
+     * @brief Sets the store used to share geometry already in use, for files queued from now on.
+     * @param store The store, or nullptr to always load. Must outlive the loader.
+     */
+    void setStore(GeometryStore* store);
+
+signals:
+    /**
+     * @brief Emitted on the GUI thread when a file has been loaded.
+     * @param fileName The file that was loaded.
+     * @param pipeline The pipeline built for the file, ready for ModelPart::setPipeline().
+     */
+    void partLoaded(const QString& fileName, const PartPipeline& pipeline);
+
+    /**
+     * @brief Emitted on the GUI thread when a part queued by loadParts() has been loaded.
+     * @param part The part.
+     * @param pipeline The pipeline built for the part, ready for ModelPart::setPipeline().
+     */
+    void partReady(ModelPart* part, const PartPipeline& pipeline);
+
+    /**
+     * @brief Emitted when a file or part could not be read.
+     * @param fileName The file that failed, or the name of the part for loadParts().
+     */
+    void loadFailed(const QString& fileName);
+
+    /**
+     * @brief Emitted whenever a file of the current batch completes.
+     * @param done Number of files completed so far.
+     * @param total Number of files in the batch.
+     */
+    void progressChanged(int done, int total);
+
+    /**
+     * @brief Emitted when the batch has completed or been cancelled.
+     * @param cancelled True if the batch was cancelled.
+     */
+    void finished(bool cancelled);
+
+private:
+    /**
+     * @brief Queues one job that builds a pipeline from a geometry source.
+     * @param origin Where to load the geometry from.
+     * @param part The part the geometry is for, or nullptr for a new part.
+     */
+    void queue(const PartSource& origin, ModelPart* part);
+
+    /**
+     * @brief Called on the GUI thread when a worker has finished with a file.
+     */
+    void jobFinished(ModelPart* part, const PartPipeline& pipeline,
+                     const std::shared_ptr<std::atomic<bool>>& cancelled);
+
+    QThreadPool                                 pool;               /**< Worker threads, one per core */
+    std::shared_ptr<std::atomic<bool>>          cancelFlag;         /**< Cancel flag shared with the current batch's jobs */
+    int                                         done;               /**< Files completed in the current batch */
+    int                                         total;              /**< Files in the current batch */
+    double                                      tolerance;          /**< Vertex welding tolerance */
+    GeometryCache*                              cache;              /**< Processed geometry cache, may be null */
+    GeometryStore*                              store;              /**< Geometry in use by parts, may be null */
+};
+
+#endif
@@ -0,0 +1,423 @@
+/**
+  * @file PartNameIndex.cpp
+  * @brief Implementation of the PartNameIndex class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "PartNameIndex.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "PartRecords.h"
+
+#include <algorithm>
+
+/**
+ * @brief PartNameIndex::PartNameIndex
+ * @param model The tree of parts.
+ * @param parent The parent object.
+ */
+PartNameIndex::PartNameIndex(ModelPartList* model, QObject* parent)
+    : QObject(parent), model(model), gaps(0) {
+    connect(model, &QAbstractItemModel::rowsInserted, this, &PartNameIndex::onRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &PartNameIndex::onRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, &PartNameIndex::changed);
+    connect(model, &QAbstractItemModel::dataChanged, this, &PartNameIndex::onDataChanged);
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &PartNameIndex::clear);
+    connect(model, &QAbstractItemModel::modelReset, this, &PartNameIndex::rebuild);
+    rebuild();
+}
+
+/**
+ * @brief PartNameIndex::find
+ * Every run of three characters of the text must be in a matching name, so
+ * only the entries under the rarest one are checked.
+ * @param text The text to search for.
+ * @return The matching parts.
+ */
+QList<PartNameIndex::Match> PartNameIndex::find(const QString& text) const {
+    const QString folded = text.toCaseFolded();
+    QList<Match> matches;
+    if (folded.isEmpty())
+        return matches;
+
+    auto check = [&](const Entry& entry) {
+        if ((entry.part || entry.records) && entry.name.contains(folded))
+            matches.append({ entry.part, entry.records, entry.record });
+    };
+
+    if (folded.size() < 3) {
+        for (const Entry& entry : entries)
+            check(entry);
+        return matches;
+    }
+
+    const std::vector<quint32>* rarest = nullptr;
+    for (qsizetype i = 0; i + 3 <= folded.size(); ++i) {
+        auto list = lists.constFind(trigram(folded.constData() + i));
+        if (list == lists.constEnd())
+            return matches;
+        if (!rarest || list->size() < rarest->size())
+            rarest = &*list;
+    }
+
+    for (quint32 index : *rarest)
+        check(entries[index]);
+    return matches;
+}
+
+/**
+ * @brief PartNameIndex::name
+ * @param match A match returned by find().
+ * @return The part's name, or its record's if it hasn't been made.
+ */
+QString PartNameIndex::name(const Match& match) const {
+    if (match.part)
+        return match.part->name();
+
+    const Entry* entry = recordEntry(match.records, match.record);
+    if (entry && entry->part)
+        return entry->part->name();
+    return match.records ? match.records->name(match.record) : QString();
+}
+
+/**
+ * @brief PartNameIndex::makePart
+ * Goes up the records to the nearest part that has been made, then makes the
+ * branches down from it to the match. Each branch that is made comes back
+ * through onRowsInserted(), which hands the records' entries to the new parts.
+ * @param match A match returned by find().
+ * @return The part, or nullptr if it is no longer in the tree.
+ */
+ModelPart* PartNameIndex::makePart(const Match& match) {
+    if (match.part)
+        return entryOf.contains(match.part) ? match.part : nullptr;
+    if (!match.records || !recordEntry(match.records, match.record))
+        return nullptr;
+
+    std::vector<qint32> unmade;         // the match first, then its ancestors
+    ModelPart* made = nullptr;
+    for (qint32 record = match.record; record >= 0 && !made; record = match.records->parent(record)) {
+        const Entry* entry = recordEntry(match.records, record);
+        if (!entry)
+            return nullptr;
+        made = entry->part;
+        if (!made)
+            unmade.push_back(record);
+    }
+
+    while (made && !unmade.empty()) {
+        model->fetchChildren(made);
+        const Entry* entry = recordEntry(match.records, unmade.back());
+        made = entry ? entry->part : nullptr;
+        unmade.pop_back();
+    }
+    return made;
+}
+
+/**
+ * @brief PartNameIndex::partCount
+ * @return The number of parts and records in the index.
+ */
+int PartNameIndex::partCount() const {
+    return int(entries.size() - gaps);
+}
+
+/**
+ * @brief PartNameIndex::onRowsInserted
+ * @param parent The parent of the new rows.
+ * @param first The first new row.
+ * @param last The last new row.
+ */
+void PartNameIndex::onRowsInserted(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partAt(parent);
+    for (int row = first; row <= last && row < parentPart->childCount(); ++row)
+        addSubtree(parentPart->child(row));
+    emit changed();
+}
+
+/**
+ * @brief PartNameIndex::onRowsAboutToBeRemoved
+ * changed() is emitted once the rows have gone.
+ * @param parent The parent of the rows.
+ * @param first The first row to be removed.
+ * @param last The last row to be removed.
+ */
+void PartNameIndex::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partAt(parent);
+    for (int row = first; row <= last && row < parentPart->childCount(); ++row)
+        removeSubtree(parentPart->child(row));
+    compactIfSparse();
+}
+
+/**
+ * @brief PartNameIndex::onDataChanged
+ * Colour and checkbox changes come through here too, so a part is only
+ * indexed again if its name no longer matches its entry.
+ * @param topLeft The first changed item.
+ * @param bottomRight The last changed item.
+ */
+void PartNameIndex::onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    if (topLeft.column() > ModelPartList::NameColumn)
+        return;
+
+    ModelPart* parentPart = partAt(topLeft.parent());
+    bool renamed = false;
+    for (int row = topLeft.row(); row <= bottomRight.row() && row < parentPart->childCount(); ++row) {
+        ModelPart* part = parentPart->child(row);
+        auto found = entryOf.constFind(part);
+        if (found == entryOf.constEnd()) {
+            addSubtree(part);
+            renamed = true;
+            continue;
+        }
+
+        Entry entry = entries[*found];
+        if (entry.name.compare(part->name(), Qt::CaseInsensitive) == 0)
+            continue;
+
+        removeEntry(*found);
+        entry.name = part->name().toCaseFolded();
+        entryOf[part] = appendEntry(entry);
+        renamed = true;
+    }
+
+    if (renamed) {
+        compactIfSparse();
+        emit changed();
+    }
+}
+
+/**
+ * @brief PartNameIndex::clear
+ */
+void PartNameIndex::clear() {
+    entries.clear();
+    entryOf.clear();
+    recordEntryOf.clear();
+    lists.clear();
+    gaps = 0;
+}
+
+/**
+ * @brief PartNameIndex::rebuild
+ */
+void PartNameIndex::rebuild() {
+    clear();
+
+    ModelPart* root = model->getRootItem();
+    for (int i = 0; i < root->childCount(); ++i)
+        addSubtree(root->child(i));
+    emit changed();
+}
+
+/**
+ * @brief PartNameIndex::addSubtree
+ * @param part The root of the subtree.
+ */
+void PartNameIndex::addSubtree(ModelPart* part) {
+    QList<ModelPart*> stack = { part };
+    while (!stack.isEmpty()) {
+        ModelPart* next = stack.takeLast();
+        if (!addPart(next) && next->hasPendingChildren())
+            addRecordsBelow(next->getRecords(), next->getRecord());
+        for (int i = 0; i < next->childCount(); ++i)
+            stack.append(next->child(i));
+    }
+}
+
+/**
+ * @brief PartNameIndex::removeSubtree
+ * @param part The root of the subtree.
+ */
+void PartNameIndex::removeSubtree(ModelPart* part) {
+    QList<ModelPart*> stack = { part };
+    while (!stack.isEmpty()) {
+        ModelPart* next = stack.takeLast();
+        if (next->hasPendingChildren())
+            removeRecordsBelow(next->getRecords(), next->getRecord());
+
+        auto found = entryOf.find(next);
+        if (found != entryOf.end()) {
+            removeEntry(*found);
+            entryOf.erase(found);
+        }
+
+        for (int i = 0; i < next->childCount(); ++i)
+            stack.append(next->child(i));
+    }
+}
+
+/**
+ * @brief PartNameIndex::addPart
+ * A part made from a record that is already indexed, i.e. one whose parent's
+ * branch has just been made, takes over the record's entry.
+ * @param part The part.
+ * @return True if the records below the part are already indexed.
+ */
+bool PartNameIndex::addPart(ModelPart* part) {
+    if (entryOf.contains(part))
+        return true;
+
+    auto set = recordEntryOf.constFind(part->getRecords());
+    if (set != recordEntryOf.constEnd()) {
+        auto found = set->constFind(part->getRecord());
+        if (found != set->constEnd() && !entries[*found].part) {
+            entries[*found].part = part;
+            entryOf.insert(part, *found);
+            return true;
+        }
+    }
+
+    entryOf.insert(part, appendEntry({ part, part->getRecords(), part->getRecord(), part->name().toCaseFolded() }));
+    return false;
+}
+
+/**
+ * @brief PartNameIndex::addRecordsBelow
+ * @param records The records.
+ * @param record The record whose descendants are indexed.
+ */
+void PartNameIndex::addRecordsBelow(const PartRecords* records, qint32 record) {
+    std::vector<qint32> stack = { record };
+    while (!stack.empty()) {
+        const qint32 next = stack.back();
+        stack.pop_back();
+        for (quint32 i = 0; i < records->childCount(next); ++i) {
+            const qint32 child = records->child(next, i);
+            appendEntry({ nullptr, records, child, records->name(child).toCaseFolded() });
+            stack.push_back(child);
+        }
+    }
+}
+
+/**
+ * @brief PartNameIndex::removeRecordsBelow
+ * @param records The records.
+ * @param record The record whose descendants are dropped.
+ */
+void PartNameIndex::removeRecordsBelow(const PartRecords* records, qint32 record) {
+    std::vector<qint32> stack = { record };
+    while (!stack.empty()) {
+        const qint32 next = stack.back();
+        stack.pop_back();
+        for (quint32 i = 0; i < records->childCount(next); ++i) {
+            const qint32 child = records->child(next, i);
+            auto set = recordEntryOf.constFind(records);
+            if (set == recordEntryOf.constEnd())
+                return;
+            auto found = set->constFind(child);
+            if (found != set->constEnd())
+                removeEntry(*found);
+            stack.push_back(child);
+        }
+    }
+}
+
+/**
+ * @brief PartNameIndex::appendEntry
+ * @param entry The entry.
+ * @return The entry's index.
+ */
+quint32 PartNameIndex::appendEntry(const Entry& entry) {
+    const quint32 index = quint32(entries.size());
+    entries.push_back(entry);
+    if (entry.records)
+        recordEntryOf[entry.records].insert(entry.record, index);
+    listEntry(index);
+    return index;
+}
+
+/**
+ * @brief PartNameIndex::removeEntry
+ * The entry stays listed, and find() skips it. entryOf is left to the caller.
+ * @param entry The entry.
+ */
+void PartNameIndex::removeEntry(quint32 entry) {
+    Entry& removed = entries[entry];
+    if (removed.records) {
+        auto set = recordEntryOf.find(removed.records);
+        if (set != recordEntryOf.end()) {
+            set->remove(removed.record);
+            if (set->isEmpty())
+                recordEntryOf.erase(set);
+        }
+    }
+
+    removed = { nullptr, nullptr, -1, QString() };
+    ++gaps;
+}
+
+/**
+ * @brief PartNameIndex::recordEntry
+ * @param records The records.
+ * @param record The record.
+ * @return The entry, or nullptr.
+ */
+const PartNameIndex::Entry* PartNameIndex::recordEntry(const PartRecords* records, qint32 record) const {
+    auto set = recordEntryOf.constFind(records);
+    if (set == recordEntryOf.constEnd())
+        return nullptr;
+    auto found = set->constFind(record);
+    return found != set->constEnd() ? &entries[*found] : nullptr;
+}
+
+/**
+ * @brief PartNameIndex::listEntry
+ * A run of three that appears more than once in a name is listed once.
+ * @param entry The entry.
+ */
+void PartNameIndex::listEntry(quint32 entry) {
+    const QString& name = entries[entry].name;
+    std::vector<quint64> keys;
+    keys.reserve(qMax<qsizetype>(0, name.size() - 2));
+    for (qsizetype i = 0; i + 3 <= name.size(); ++i)
+        keys.push_back(trigram(name.constData() + i));
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (quint64 key : keys)
+        lists[key].push_back(entry);
+}
+
+/**
+ * @brief PartNameIndex::compactIfSparse
+ * Entries keep their order, so results stay in the order parts were indexed.
+ */
+void PartNameIndex::compactIfSparse() {
+    if (gaps < 1024 || gaps < entries.size() - gaps)
+        return;
+
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const Entry& entry) { return !entry.part && !entry.records; }),
+                  entries.end());
+    entryOf.clear();
+    recordEntryOf.clear();
+    lists.clear();
+    for (quint32 i = 0; i < entries.size(); ++i) {
+        if (entries[i].part)
+            entryOf.insert(entries[i].part, i);
+        if (entries[i].records)
+            recordEntryOf[entries[i].records].insert(entries[i].record, i);
+        listEntry(i);
+    }
+    gaps = 0;
+}
+
+/**
+ * @brief PartNameIndex::partAt
+ * @param index The index.
+ * @return The part.
+ */
+ModelPart* PartNameIndex::partAt(const QModelIndex& index) const {
+    return index.isValid() ? static_cast<ModelPart*>(index.internalPointer()) : model->getRootItem();
+}
+
+/**
+ * @brief PartNameIndex::trigram
+ * @param text The first of the three characters.
+ * @return The key.
+ */
+quint64 PartNameIndex::trigram(const QChar* text) {
+    return quint64(text[0].unicode()) << 32 | quint64(text[1].unicode()) << 16 | quint64(text[2].unicode());
+}
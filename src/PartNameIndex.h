@@ -0,0 +1,200 @@
+/** @file PartNameIndex.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Trigram index over the names of the parts in the tree, for the part search
+  */
+
+#ifndef VIEWER_PARTNAMEINDEX_H
+#define VIEWER_PARTNAMEINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#include <vector>
+
+class ModelPart;
+class ModelPartList;
+class PartRecords;
+class QModelIndex;
+
+/**
+ * @class PartNameIndex
+ * @brief Finds the parts whose names contain some text without scanning the tree.
+ *
+ * Every run of three characters of each part's case folded name is listed
+ * against the part, so a search only checks the parts listed under the
+ * search text's rarest run of three. Searches shorter than three characters
+ * scan the names, which are kept together in one array.
+ *
+ * Parts of an opened project that are still held as PartRecords are indexed
+ * straight from their records, so searching doesn't make any branches. A
+ * match that is still a record is only made, with the branches above it,
+ * when makePart() is asked for it, e.g. when it is clicked or selected. Its
+ * entry then becomes the part's, so its place in the results stays the same.
+ *
+ * The index follows the tree model: inserted rows are added, rows about to be
+ * removed are dropped along with any records below them, and a reset rebuilds
+ * it, so each change costs the parts it touches. Renames come in as changes
+ * to the name column. Dropped parts leave gaps that are skipped, and the
+ * lists are rebuilt once the gaps outnumber the parts.
+ */
+class PartNameIndex : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @brief A part found by a search, which may still be held as a record.
+     */
+    struct Match {
+        ModelPart*                              part = nullptr;     /**< The part, or nullptr if it was still a record */
+        const PartRecords*                      records = nullptr;  /**< Records the part is or was made from, or nullptr */
+        qint32                                  record = -1;        /**< The part's record in records */
+    };
+
+    /**
+     * @brief Constructor for the PartNameIndex class. Indexes the parts already in the tree.
+     * @param model The tree of parts.
+     * @param parent The parent object.
+     */
+    explicit PartNameIndex(ModelPartList* model, QObject* parent = nullptr);
+
+    /**
+     * @brief Finds the parts whose names contain the text, ignoring case.
+     * @param text The text to search for.
+     * @return The matching parts, in the order they were indexed, or none for empty text.
+     */
+    QList<Match> find(const QString& text) const;
+
+    /**
+     * @brief Returns the name of a match, without making it.
+     * @param match A match returned by find() since the last change to the index.
+     */
+    QString name(const Match& match) const;
+
+    /**
+     * @brief Makes a match that is still a record, and the branches above it, so it can be shown in the tree.
+     * @param match A match returned by find().
+     * @return The part, or nullptr if it is no longer in the tree.
+     */
+    ModelPart* makePart(const Match& match);
+
+    /**
+     * @brief Returns the number of parts in the index, made or not.
+     */
+    int partCount() const;
+
+signals:
+    /**
+     * @brief Emitted once the index has been brought up to date with a change to the tree.
+     */
+    void changed();
+
+private:
+    /**
+     * @brief A part or a record, with its case folded name.
+     */
+    struct Entry {
+        ModelPart*                              part;           /**< The part, or nullptr while it is a record */
+        const PartRecords*                      records;        /**< Records the part is or was made from, or nullptr */
+        qint32                                  record;         /**< The part's record in records */
+        QString                                 name;           /**< Case folded name, empty for a gap */
+    };
+
+    /**
+     * @brief Called when rows have been inserted into the model.
+     */
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief Called when rows are about to be removed from the model.
+     */
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief Called when items have changed, to pick up renames.
+     */
+    void onDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
+    /**
+     * @brief Drops every part, e.g. before the tree is replaced.
+     */
+    void clear();
+
+    /**
+     * @brief Drops every part and indexes the whole tree again.
+     */
+    void rebuild();
+
+    /**
+     * @brief Indexes a part and everything below it, made or not.
+     */
+    void addSubtree(ModelPart* part);
+
+    /**
+     * @brief Drops a part and everything below it, made or not.
+     */
+    void removeSubtree(ModelPart* part);
+
+    /**
+     * @brief Indexes one part, taking over its record's entry if it has one.
+     * @return True if the records below the part are already indexed.
+     */
+    bool addPart(ModelPart* part);
+
+    /**
+     * @brief Indexes the records below a record.
+     */
+    void addRecordsBelow(const PartRecords* records, qint32 record);
+
+    /**
+     * @brief Drops the records below a record.
+     */
+    void removeRecordsBelow(const PartRecords* records, qint32 record);
+
+    /**
+     * @brief Adds an entry and lists it.
+     * @return The entry's index.
+     */
+    quint32 appendEntry(const Entry& entry);
+
+    /**
+     * @brief Turns an entry into a gap.
+     */
+    void removeEntry(quint32 entry);
+
+    /**
+     * @brief Returns the entry of a record, or nullptr if it isn't indexed.
+     */
+    const Entry* recordEntry(const PartRecords* records, qint32 record) const;
+
+    /**
+     * @brief Adds an entry's runs of three characters to the lists.
+     */
+    void listEntry(quint32 entry);
+
+    /**
+     * @brief Removes the gaps and rebuilds the lists once the gaps outnumber the parts.
+     */
+    void compactIfSparse();
+
+    /**
+     * @brief Returns the part at an index, or the root for an invalid index.
+     */
+    ModelPart* partAt(const QModelIndex& index) const;
+
+    /**
+     * @brief Packs three UTF-16 characters into one key.
+     */
+    static quint64 trigram(const QChar* text);
+
+    ModelPartList*                                          model;          /**< The tree of parts */
+    std::vector<Entry>                                      entries;        /**< Every indexed part and record, with gaps */
+    QHash<ModelPart*, quint32>                              entryOf;        /**< Entry of each indexed part */
+    QHash<const PartRecords*, QHash<qint32, quint32>>       recordEntryOf;  /**< Entry of each indexed record, made or not */
+    QHash<quint64, std::vector<quint32>>                    lists;          /**< Entries whose names contain each run of three characters */
+    quint32                                                 gaps;           /**< Number of gaps in entries */
+};
+
+#endif
@@ -0,0 +1,171 @@
+/**
+  * @file PartRecords.cpp
+  * @brief Implementation of the PartRecords class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "PartRecords.h"
+#include "ModelPart.h"
+
+/**
+ * @brief PartRecords::PartRecords
+ * @param projectFile The open project holding any embedded geometry.
+ */
+PartRecords::PartRecords(std::shared_ptr<QFile> projectFile)
+    : projectFile(std::move(projectFile)) {
+}
+
+/**
+ * @brief PartRecords::add
+ * @param parent The index of the parent record, or -1 for a top level part.
+ * @param record The record.
+ * @return False if the parent hasn't been added.
+ */
+bool PartRecords::add(qint32 parent, const Record& record) {
+    if (parent >= qint32(records.size()))
+        return false;
+
+    records.push_back(record);
+    parents.push_back(parent < 0 ? -1 : parent);
+    return true;
+}
+
+/**
+ * @brief PartRecords::finish
+ * Each record's children are given consecutive places in one list, in the
+ * order they were added, and whether a branch has anything to show is worked
+ * out from the leaves up, so the tree can tell without walking the records.
+ */
+void PartRecords::finish() {
+    topLevel = Record();
+    for (Record& record : records) {
+        record.childCount = 0;
+        record.visibleGeometry = false;
+    }
+
+    for (qint32 parent : parents)
+        ++(parent < 0 ? topLevel : records[parent]).childCount;
+
+    quint32 next = topLevel.childCount;
+    for (Record& record : records) {
+        record.firstChild = next;
+        next += record.childCount;
+    }
+
+    std::vector<quint32> filled(records.size() + 1, 0);
+    children.assign(records.size(), 0);
+    for (quint32 i = 0; i < records.size(); ++i) {
+        const qint32 parent = parents[i];
+        const Record& owner = parent < 0 ? topLevel : records[parent];
+        children[owner.firstChild + filled[parent + 1]++] = i;
+    }
+
+    /* Children come after their parents, so going backwards sees every child first */
+    for (quint32 i = quint32(records.size()); i-- > 0;) {
+        Record& record = records[i];
+        record.visibleGeometry = record.visibleGeometry ||
+            ((record.flags & ModelPart::Visible) && (!record.fileName.isEmpty() || record.offset >= 0));
+        if (record.visibleGeometry)
+            (parents[i] < 0 ? topLevel : records[parents[i]]).visibleGeometry = true;
+    }
+}
+
+/**
+ * @brief PartRecords::size
+ * @return The number of records.
+ */
+quint32 PartRecords::size() const {
+    return quint32(records.size());
+}
+
+/**
+ * @brief PartRecords::childCount
+ * @param record The index of the record, or -1 for the top level.
+ * @return The number of children.
+ */
+quint32 PartRecords::childCount(qint32 record) const {
+    return at(record).childCount;
+}
+
+/**
+ * @brief PartRecords::name
+ * @param record The index of the record.
+ * @return The name.
+ */
+const QString& PartRecords::name(qint32 record) const {
+    return records[record].name;
+}
+
+/**
+ * @brief PartRecords::parent
+ * @param record The index of the record.
+ * @return The index of the parent record, or -1 for a top level part.
+ */
+qint32 PartRecords::parent(qint32 record) const {
+    return parents[record];
+}
+
+/**
+ * @brief PartRecords::child
+ * @param record The index of the record, or -1 for the top level.
+ * @param child The child's position.
+ * @return The index of the child record.
+ */
+qint32 PartRecords::child(qint32 record, quint32 child) const {
+    return qint32(children[at(record).firstChild + child]);
+}
+
+/**
+ * @brief PartRecords::hasVisibleGeometry
+ * @param record The index of the record, or -1 for the top level.
+ * @return True if the record or one below it is visible and has geometry to load.
+ */
+bool PartRecords::hasVisibleGeometry(qint32 record) const {
+    return at(record).visibleGeometry;
+}
+
+/**
+ * @brief PartRecords::createChildren
+ * @param records The records.
+ * @param record The index of the record, or -1 for the top level.
+ * @return The new parts, owned by the caller.
+ */
+QList<ModelPart*> PartRecords::createChildren(const std::shared_ptr<const PartRecords>& records, qint32 record) {
+    const Record& owner = records->at(record);
+
+    QList<ModelPart*> parts;
+    parts.reserve(owner.childCount);
+    for (quint32 i = owner.firstChild; i < owner.firstChild + owner.childCount; ++i) {
+        const qint32 index = qint32(records->children[i]);
+        const Record& child = records->records[index];
+
+        ModelPart* part = new ModelPart(child.name);
+        part->setVisible(child.flags & ModelPart::Visible);
+        part->setFlag(ModelPart::Shrink, child.flags & ModelPart::Shrink);
+        part->setFlag(ModelPart::Clip, child.flags & ModelPart::Clip);
+        part->setColour(qRed(child.colour), qGreen(child.colour), qBlue(child.colour));
+
+        PartSource origin;
+        origin.fileName = child.fileName;
+        if (child.offset >= 0) {
+            origin.projectFile = records->projectFile;
+            origin.offset = child.offset;
+            part->setPosition(child.position);
+        }
+        part->setGeometrySource(origin);
+
+        part->setRecord(records, index);
+        parts.append(part);
+    }
+    return parts;
+}
+
+/**
+ * @brief PartRecords::at
+ * @param record The index of the record, or -1 for the top level.
+ * @return The record.
+ */
+const PartRecords::Record& PartRecords::at(qint32 record) const {
+    return record < 0 ? topLevel : records[record];
+}
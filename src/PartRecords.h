@@ -0,0 +1,135 @@
+/** @file PartRecords.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Compact records of parts that haven't been added to the tree yet
+  */
+
+#ifndef VIEWER_PARTRECORDS_H
+#define VIEWER_PARTRECORDS_H
+
+#include <QFile>
+#include <QList>
+#include <QRgb>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+class ModelPart;
+
+/**
+ * @class PartRecords
+ * @brief The parts of an opened project, as compact records until the tree needs them.
+ *
+ * A ModelPart holds a mapper, an actor, filters and cached bounds, so a tree of
+ * tens of thousands of parts costs a lot of memory before any geometry is
+ * loaded. An opened project instead keeps its parts here as one record each,
+ * with just what the TREE chunk stores, and only the top level parts are made.
+ * A part whose children are still records has them made when its branch is
+ * expanded, or when they are shown or edited.
+ *
+ * Every part that is drawn needs its own actor, so the geometry load after a
+ * project opens makes every branch with a visible part that has geometry.
+ * Startup and memory only stay flat for branches that are hidden or have no
+ * geometry; a project with everything shown ends up with all its parts made.
+ *
+ * The records never change once built, so they are shared by every part made
+ * from them and freed with the last one.
+ */
+class PartRecords {
+public:
+    /**
+     * @brief One part as read from a project.
+     */
+    struct Record {
+        QString                                 name;                   /**< Name shown in the tree */
+        QString                                 fileName;               /**< STL file, may be empty */
+        qint64                                  offset = -1;            /**< Offset of the embedded geometry blob, -1 for none */
+        double                                  position[3] = {};       /**< Position of the embedded geometry */
+        quint32                                 firstChild = 0;         /**< Position of the first child in the child list */
+        quint32                                 childCount = 0;         /**< Number of children */
+        QRgb                                    colour = 0;             /**< Packed colour */
+        quint8                                  flags = 0;              /**< ModelPart::Flag values */
+        bool                                    visibleGeometry = false;/**< True if the record or one below it is visible and has geometry */
+    };
+
+    /**
+     * @brief Constructor for the PartRecords class.
+     * @param projectFile The open project holding any embedded geometry.
+     */
+    explicit PartRecords(std::shared_ptr<QFile> projectFile);
+
+    /**
+     * @brief Adds a record. Records must be added in pre-order.
+     * @param parent The index of the parent record, or -1 for a top level part.
+     * @param record The record.
+     * @return False if the parent hasn't been added.
+     */
+    bool add(qint32 parent, const Record& record);
+
+    /**
+     * @brief Builds the child lists once every record has been added.
+     */
+    void finish();
+
+    /**
+     * @brief Returns the number of records.
+     */
+    quint32 size() const;
+
+    /**
+     * @brief Returns a record's number of children.
+     * @param record The index of the record, or -1 for the top level.
+     */
+    quint32 childCount(qint32 record) const;
+
+    /**
+     * @brief Returns a record's name.
+     * @param record The index of the record.
+     */
+    const QString& name(qint32 record) const;
+
+    /**
+     * @brief Returns a record's parent.
+     * @param record The index of the record.
+     * @return The index of the parent record, or -1 for a top level part.
+     */
+    qint32 parent(qint32 record) const;
+
+    /**
+     * @brief Returns one of a record's children.
+     * @param record The index of the record, or -1 for the top level.
+     * @param child The child's position, less than childCount().
+     * @return The index of the child record.
+     */
+    qint32 child(qint32 record, quint32 child) const;
+
+    /**
+     * @brief Returns true if the record or one below it is visible and has geometry to load.
+     * @param record The index of the record, or -1 for the top level.
+     */
+    bool hasVisibleGeometry(qint32 record) const;
+
+    /**
+     * @brief Makes the parts for a record's children.
+     * @param records The records.
+     * @param record The index of the record, or -1 for the top level.
+     * @return The new parts, owned by the caller, whose own children are left as records.
+     */
+    static QList<ModelPart*> createChildren(const std::shared_ptr<const PartRecords>& records, qint32 record);
+
+private:
+    /**
+     * @brief Returns the record for an index, or the top level record for -1.
+     */
+    const Record& at(qint32 record) const;
+
+    std::shared_ptr<QFile>                      projectFile;    /**< Project holding the embedded geometry */
+    std::vector<Record>                         records;        /**< The parts, in pre-order */
+    std::vector<qint32>                         parents;        /**< Parent of each record, -1 for the top level */
+    std::vector<quint32>                        children;       /**< Each record's children, one block after another */
+    Record                                      topLevel;       /**< Holds the top level parts as its children */
+};
+
+#endif
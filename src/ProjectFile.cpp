@@ -0,0 +1,311 @@
+/**
+  * @file ProjectFile.cpp
+  * @brief Implementation of the ProjectFile class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "ProjectFile.h"
+#include "MeshFile.h"
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QScopeGuard>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char projectMagic[8] = { 'F', 'S', 'P', 'R', 'O', 'J', '\0', '\0' };
+const quint32 projectVersion = 2;     // 2 added each part's position
+
+constexpr quint32 fourCC(char a, char b, char c, char d) {
+    return quint32(uchar(a)) | quint32(uchar(b)) << 8 | quint32(uchar(c)) << 16 | quint32(uchar(d)) << 24;
+}
+
+const quint32 treeChunk = fourCC('T', 'R', 'E', 'E');
+const quint32 geometryChunk = fourCC('G', 'E', 'O', 'M');
+
+/* Flags of a part record in the TREE chunk */
+const quint8 partVisible = 1 << 0;
+const quint8 partShrink  = 1 << 1;
+const quint8 partClip    = 1 << 2;
+
+/**
+ * @brief Fixed size header at the start of every project.
+ */
+struct ProjectHeader {
+    char        magic[8];
+    quint32     version;
+    quint32     numChunks;
+    qint64      chunkTable;
+    qint64      reserved;
+};
+static_assert(sizeof(ProjectHeader) == 32, "ProjectHeader must stay 32 bytes");
+
+/**
+ * @brief One entry of the chunk table.
+ */
+struct ChunkEntry {
+    quint32     type;
+    quint32     reserved;
+    qint64      offset;
+    qint64      size;
+};
+static_assert(sizeof(ChunkEntry) == 24, "ChunkEntry must stay 24 bytes");
+
+/**
+ * @brief Pads the device with zeros up to the next multiple of 8 bytes.
+ */
+bool padTo8(QIODevice& device) {
+    static const char zeros[8] = {};
+    const qint64 padding = (8 - device.pos() % 8) % 8;
+    return device.write(zeros, padding) == padding;
+}
+
+/**
+ * @brief Lists the parts below root in pre-order, with the position of each part's parent.
+ * Children still held as records are made as temporary parts, added to temporaries
+ * for the caller to delete, rather than being added to the tree.
+ */
+void collectParts(ModelPart* part, int parentIndex, QList<ModelPart*>& parts, QList<int>& parents,
+                  QList<ModelPart*>& temporaries) {
+    for (int i = 0; i < part->childCount(); ++i) {
+        ModelPart* child = part->child(i);
+        parts.append(child);
+        parents.append(parentIndex);
+        collectParts(child, parts.size() - 1, parts, parents, temporaries);
+    }
+
+    for (ModelPart* child : part->createPendingChildren()) {
+        temporaries.append(child);
+        parts.append(child);
+        parents.append(parentIndex);
+        collectParts(child, parts.size() - 1, parts, parents, temporaries);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief ProjectFile::save
+ * Writes the geometry chunks first so that the tree can refer to them, then
+ * the tree and the chunk table, and finally goes back to fill in the header.
+ * Parts that haven't been loaded yet but came from an embedding project have
+ * their blob mapped from that project and written again unchanged.
+ * @param fileName The project file to write.
+ * @param root The tree's root item, which is not itself saved.
+ * @param embedGeometry True to store each part's geometry in the project.
+ * @return True on success.
+ */
+bool ProjectFile::save(const QString& fileName, ModelPart* root, bool embedGeometry) {
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    ProjectHeader header = {};
+    std::memcpy(header.magic, projectMagic, sizeof(projectMagic));
+    header.version = projectVersion;
+    if (file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+        return false;
+
+    QList<ModelPart*> parts;
+    QList<int> parents;
+    QList<ModelPart*> temporaries;
+    collectParts(root, -1, parts, parents, temporaries);
+    const auto deleteTemporaries = qScopeGuard([&temporaries]() { qDeleteAll(temporaries); });
+
+    std::vector<ChunkEntry> chunks;
+    QList<qint32> partGeometry(parts.size(), -1);
+
+    if (embedGeometry) {
+        /* Parts showing the same mesh, or the same blob of another project, share a chunk */
+        QHash<vtkPolyData*, qint32> meshChunks;
+        QHash<QPair<QFile*, qint64>, qint32> blobChunks;
+
+        for (int i = 0; i < parts.size(); ++i) {
+            const PartSource& origin = parts[i]->getGeometrySource();
+            vtkSmartPointer<vtkPolyData> mesh = parts[i]->getSource();
+            WeldStats stats = parts[i]->getWeldStats();
+
+            const QPair<QFile*, qint64> blob(origin.projectFile.get(), origin.offset);
+            if (mesh && meshChunks.contains(mesh)) {
+                partGeometry[i] = meshChunks.value(mesh);
+                continue;
+            }
+            if (!mesh && origin.projectFile) {
+                if (blobChunks.contains(blob)) {
+                    partGeometry[i] = blobChunks.value(blob);
+                    continue;
+                }
+                mesh = MeshFile::map(origin.projectFile, origin.offset, &stats);
+            }
+            if (!mesh)
+                continue;   // never loaded, saved as a reference to its STL file only
+
+            if (!padTo8(file))
+                return false;
+
+            ChunkEntry chunk = { geometryChunk, 0, file.pos(), 0 };
+            chunk.size = MeshFile::write(file, mesh, stats);
+            if (chunk.size < 0)
+                return false;
+
+            partGeometry[i] = qint32(chunks.size());
+            chunks.push_back(chunk);
+            if (parts[i]->getSource())
+                meshChunks.insert(mesh, partGeometry[i]);
+            else
+                blobChunks.insert(blob, partGeometry[i]);
+        }
+    }
+
+    /* STL files are stored relative to the project so that a project can be
+     * moved together with its parts */
+    const QDir projectDir = QFileInfo(fileName).absoluteDir();
+
+    QByteArray tree;
+    {
+        QDataStream out(&tree, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_6_0);
+        out << quint32(parts.size());
+        for (int i = 0; i < parts.size(); ++i) {
+            ModelPart* part = parts[i];
+            const QString& stlFile = part->getGeometrySource().fileName;
+
+            quint8 flags = 0;
+            if (part->hasFlag(ModelPart::Visible)) flags |= partVisible;
+            if (part->hasFlag(ModelPart::Shrink))  flags |= partShrink;
+            if (part->hasFlag(ModelPart::Clip))    flags |= partClip;
+
+            /* A position only applies to embedded geometry, which may be a mesh
+             * shared with other parts. The STL file is in place already */
+            double position[3] = { 0.0, 0.0, 0.0 };
+            if (partGeometry[i] >= 0)
+                part->getPosition(position);
+
+            out << qint32(parents[i]) << part->name() << flags
+                << quint8(part->getColourR()) << quint8(part->getColourG()) << quint8(part->getColourB())
+                << (stlFile.isEmpty() ? QString() : projectDir.relativeFilePath(stlFile))
+                << partGeometry[i] << position[0] << position[1] << position[2];
+        }
+    }
+
+    if (!padTo8(file))
+        return false;
+    chunks.push_back({ treeChunk, 0, file.pos(), tree.size() });
+    if (file.write(tree) != tree.size())
+        return false;
+
+    if (!padTo8(file))
+        return false;
+    header.numChunks = quint32(chunks.size());
+    header.chunkTable = file.pos();
+    const qint64 tableBytes = qint64(chunks.size() * sizeof(ChunkEntry));
+    if (file.write(reinterpret_cast<const char*>(chunks.data()), tableBytes) != tableBytes)
+        return false;
+
+    if (!file.seek(0) || file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+        return false;
+
+    return file.commit();
+}
+
+/**
+ * @brief ProjectFile::load
+ * Reads the chunk table and the TREE chunk. Embedded geometry is left in the
+ * file, each part's source just records the project and the blob's offset.
+ * @param fileName The project file to open.
+ * @param ok If not null, set to false if the file is missing or invalid.
+ * @return The project's top level parts, owned by the caller.
+ */
+QList<ModelPart*> ProjectFile::load(const QString& fileName, bool* ok) {
+    if (ok)
+        *ok = false;
+
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly))
+        return {};
+
+    ProjectHeader header;
+    if (file->read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+        return {};
+    if (std::memcmp(header.magic, projectMagic, sizeof(projectMagic)) != 0 ||
+        header.version < 1 || header.version > projectVersion)
+        return {};
+
+    const qint64 tableBytes = qint64(header.numChunks) * qint64(sizeof(ChunkEntry));
+    if (header.chunkTable < qint64(sizeof(header)) || header.chunkTable + tableBytes > file->size())
+        return {};
+
+    std::vector<ChunkEntry> chunks(header.numChunks);
+    if (!file->seek(header.chunkTable) ||
+        file->read(reinterpret_cast<char*>(chunks.data()), tableBytes) != tableBytes)
+        return {};
+
+    const ChunkEntry* treeEntry = nullptr;
+    for (const ChunkEntry& chunk : chunks) {
+        if (chunk.offset < 0 || chunk.size < 0 || chunk.offset + chunk.size > file->size())
+            return {};
+        if (chunk.type == treeChunk)
+            treeEntry = &chunk;
+    }
+    if (!treeEntry || !file->seek(treeEntry->offset))
+        return {};
+
+    const QByteArray tree = file->read(treeEntry->size);
+    QDataStream in(tree);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 count;
+    in >> count;
+
+    const QDir projectDir = QFileInfo(fileName).absoluteDir();
+    std::shared_ptr<PartRecords> records = std::make_shared<PartRecords>(file);
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint32 parent, geometry;
+        QString name, stlFile;
+        quint8 flags, r, g, b;
+        double position[3] = { 0.0, 0.0, 0.0 };
+        in >> parent >> name >> flags >> r >> g >> b >> stlFile >> geometry;
+        if (header.version >= 2)
+            in >> position[0] >> position[1] >> position[2];
+        if (in.status() != QDataStream::Ok)
+            break;
+
+        PartRecords::Record record;
+        record.name = name;
+        record.colour = qRgb(r, g, b);
+        if (flags & partVisible) record.flags |= ModelPart::Visible;
+        if (flags & partShrink)  record.flags |= ModelPart::Shrink;
+        if (flags & partClip)    record.flags |= ModelPart::Clip;
+        if (!stlFile.isEmpty())
+            record.fileName = QDir::cleanPath(projectDir.absoluteFilePath(stlFile));
+        if (geometry >= 0 && geometry < qint32(chunks.size()) && chunks[geometry].type == geometryChunk) {
+            record.offset = chunks[geometry].offset;
+            std::copy(position, position + 3, record.position);
+        }
+
+        if (!records->add(parent, record))
+            break;
+    }
+
+    if (records->size() != count)
+        return {};
+
+    /* Only the top level parts are made, the rest stay records until the tree needs them */
+    records->finish();
+    QList<ModelPart*> topLevel = PartRecords::createChildren(records, -1);
+
+    if (ok)
+        *ok = true;
+    return topLevel;
+}
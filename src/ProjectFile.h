@@ -0,0 +1,53 @@
+/** @file ProjectFile.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Binary assembly project files holding the part tree and, optionally, its geometry
+  */
+
+#ifndef VIEWER_PROJECTFILE_H
+#define VIEWER_PROJECTFILE_H
+
+#include "ModelPart.h"
+
+#include <QList>
+#include <QString>
+
+/**
+ * @class ProjectFile
+ * @brief Saves and opens assembly projects.
+ *
+ * A project is a 32 byte header, a sequence of chunks and a chunk table at the
+ * end of the file that gives each chunk's type, offset and size. The TREE chunk
+ * lists every part in pre-order with its parent, name, visibility, shrink and
+ * clip state, colour, STL file and embedded geometry chunk. Each GEOM chunk is
+ * a MeshFile blob, so embedded geometry is mapped straight from the project
+ * rather than read and parsed, and parts sharing a mesh share a chunk.
+ *
+ * Opening a project only reads the tree. Each part is given a PartSource that
+ * says where its geometry is, and the geometry is loaded later, e.g. by
+ * PartLoader when the part is first shown. Only the top level parts are made;
+ * the others are kept as PartRecords until their branch is needed.
+ */
+class ProjectFile {
+public:
+    /**
+     * @brief Saves the tree below root, replacing the file atomically.
+     * @param fileName The project file to write.
+     * @param root The tree's root item, which is not itself saved.
+     * @param embedGeometry True to store each part's geometry in the project,
+     *        false to store only the STL file it was loaded from.
+     * @return True on success.
+     */
+    static bool save(const QString& fileName, ModelPart* root, bool embedGeometry);
+
+    /**
+     * @brief Opens a project and builds its tree without loading any geometry.
+     * @param fileName The project file to open.
+     * @param ok If not null, set to false if the file is missing or invalid.
+     * @return The project's top level parts, owned by the caller, with their children left as records.
+     */
+    static QList<ModelPart*> load(const QString& fileName, bool* ok = nullptr);
+};
+
+#endif
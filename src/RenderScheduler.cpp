@@ -0,0 +1,177 @@
+/**
+  * @file RenderScheduler.cpp
+  * @brief Implementation of the RenderScheduler class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "RenderScheduler.h"
+
+#include <QScreen>
+#include <QVTKOpenGLNativeWidget.h>
+
+#include <vtkCommand.h>
+#include <vtkRenderWindow.h>
+
+#include <cmath>
+
+/**
+ * @brief RenderScheduler::RenderScheduler
+ * @param view The widget whose render window is rendered.
+ * @param parent The parent object.
+ */
+RenderScheduler::RenderScheduler(QVTKOpenGLNativeWidget* view, QObject* parent)
+    : QObject(parent), view(view), requests(0), renders(0), lastTime(0.0), totalTime(0.0), maxTime(0.0) {
+    frameTimer.setSingleShot(true);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer, &QTimer::timeout, this, &RenderScheduler::renderPending);
+
+    startObserver = view->renderWindow()->AddObserver(vtkCommand::StartEvent, this, &RenderScheduler::onStartRender);
+    endObserver = view->renderWindow()->AddObserver(vtkCommand::EndEvent, this, &RenderScheduler::onEndRender);
+}
+
+/**
+ * @brief RenderScheduler::~RenderScheduler
+ */
+RenderScheduler::~RenderScheduler() {
+    view->renderWindow()->RemoveObserver(startObserver);
+    view->renderWindow()->RemoveObserver(endObserver);
+}
+
+/**
+ * @brief RenderScheduler::requestRender
+ * The render is put off until a frame interval after the last one started,
+ * so a burst of requests, or a slider dragged faster than the display
+ * refreshes, costs one render per frame.
+ */
+void RenderScheduler::requestRender() {
+    ++requests;
+    if (frameTimer.isActive())
+        return;
+
+    const double elapsed = sinceRender.isValid() ? sinceRender.nsecsElapsed() / 1e6 : frameInterval();
+    frameTimer.start(qMax(0, int(std::ceil(frameInterval() - elapsed))));
+}
+
+/**
+ * @brief RenderScheduler::defer
+ * @param key Names the setting being changed.
+ * @param change The change.
+ */
+void RenderScheduler::defer(const QString& key, const std::function<void()>& change) {
+    for (auto& pending : deferred) {
+        if (pending.first == key) {
+            pending.second = change;
+            requestRender();
+            return;
+        }
+    }
+    deferred.append({ key, change });
+    requestRender();
+}
+
+/**
+ * @brief RenderScheduler::flush
+ */
+void RenderScheduler::flush() {
+    if (!frameTimer.isActive())
+        return;
+
+    frameTimer.stop();
+    renderPending();
+}
+
+/**
+ * @brief RenderScheduler::requestedRenders
+ * @return The number of requests.
+ */
+int RenderScheduler::requestedRenders() const {
+    return requests;
+}
+
+/**
+ * @brief RenderScheduler::renderCount
+ * @return The number of renders.
+ */
+int RenderScheduler::renderCount() const {
+    return renders;
+}
+
+/**
+ * @brief RenderScheduler::lastFrameTime
+ * @return The time in milliseconds.
+ */
+double RenderScheduler::lastFrameTime() const {
+    return lastTime * 1000.0;
+}
+
+/**
+ * @brief RenderScheduler::averageFrameTime
+ * @return The time in milliseconds, 0 if nothing has been rendered.
+ */
+double RenderScheduler::averageFrameTime() const {
+    return renders ? totalTime * 1000.0 / renders : 0.0;
+}
+
+/**
+ * @brief RenderScheduler::maxFrameTime
+ * @return The time in milliseconds.
+ */
+double RenderScheduler::maxFrameTime() const {
+    return maxTime * 1000.0;
+}
+
+/**
+ * @brief RenderScheduler::frameInterval
+ * Follows the widget to whichever screen it is on.
+ * @return The interval in milliseconds.
+ */
+double RenderScheduler::frameInterval() const {
+    QScreen* screen = view->screen();
+    const double rate = screen ? screen->refreshRate() : 0.0;
+    return 1000.0 / (rate > 0.0 ? rate : 60.0);
+}
+
+/**
+ * @brief RenderScheduler::resetStatistics
+ */
+void RenderScheduler::resetStatistics() {
+    requests = renders = 0;
+    lastTime = totalTime = maxTime = 0.0;
+}
+
+/**
+ * @brief RenderScheduler::renderPending
+ */
+void RenderScheduler::renderPending() {
+    /* A change may itself request a render, which must not start another frame */
+    const QList<QPair<QString, std::function<void()>>> changes = std::move(deferred);
+    deferred.clear();
+    for (const auto& change : changes)
+        change.second();
+    frameTimer.stop();
+
+    view->renderWindow()->Render();
+}
+
+/**
+ * @brief RenderScheduler::onStartRender
+ */
+void RenderScheduler::onStartRender(vtkObject*, unsigned long, void*) {
+    sinceRender.start();
+    renderTimer.start();
+}
+
+/**
+ * @brief RenderScheduler::onEndRender
+ */
+void RenderScheduler::onEndRender(vtkObject*, unsigned long, void*) {
+    if (!renderTimer.isValid())
+        return;
+
+    lastTime = renderTimer.nsecsElapsed() / 1e9;
+    totalTime += lastTime;
+    maxTime = qMax(maxTime, lastTime);
+    ++renders;
+    renderTimer.invalidate();
+}
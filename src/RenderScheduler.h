@@ -0,0 +1,137 @@
+/** @file RenderScheduler.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Coalesces render requests into at most one render per display frame
+  */
+
+#ifndef VIEWER_RENDERSCHEDULER_H
+#define VIEWER_RENDERSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QTimer>
+
+#include <functional>
+
+class QVTKOpenGLNativeWidget;
+class vtkObject;
+
+/**
+ * @class RenderScheduler
+ * @brief The one place the main window's renders are started from.
+ *
+ * Code that changes the scene calls requestRender() rather than rendering.
+ * The first request after a render starts a timer for the next display frame,
+ * at the screen's refresh rate, and any further requests before it fires are
+ * folded into the same render. Changes that are themselves worth skipping,
+ * such as setting the light intensity on every tick of a slider drag, can be
+ * handed to defer() under a key: only the latest change for each key is kept,
+ * and it is applied just before the render.
+ *
+ * Every render of the window, including those the interactor makes while the
+ * camera moves, is timed for the frame statistics.
+ */
+class RenderScheduler : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @brief Constructor for the RenderScheduler class.
+     * @param view The widget whose render window is rendered.
+     * @param parent The parent object.
+     */
+    explicit RenderScheduler(QVTKOpenGLNativeWidget* view, QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor.
+     */
+    ~RenderScheduler();
+
+    /**
+     * @brief Marks the scene as changed, so that it is rendered at the next display frame.
+     */
+    void requestRender();
+
+    /**
+     * @brief Keeps a change to apply before the next render, replacing any earlier one with the same key.
+     * @param key Names the setting being changed, e.g. "light".
+     * @param change The change.
+     */
+    void defer(const QString& key, const std::function<void()>& change);
+
+    /**
+     * @brief Applies deferred changes and renders straight away if a render is pending.
+     *
+     * For code that needs the result of the render, e.g. its statistics.
+     */
+    void flush();
+
+    /**
+     * @brief Returns the number of renders requested since the statistics were reset.
+     */
+    int requestedRenders() const;
+
+    /**
+     * @brief Returns the number of renders of the window since the statistics were reset.
+     */
+    int renderCount() const;
+
+    /**
+     * @brief Returns the time of the last render, in milliseconds.
+     */
+    double lastFrameTime() const;
+
+    /**
+     * @brief Returns the mean render time since the statistics were reset, in milliseconds.
+     */
+    double averageFrameTime() const;
+
+    /**
+     * @brief Returns the longest render time since the statistics were reset, in milliseconds.
+     */
+    double maxFrameTime() const;
+
+    /**
+     * @brief Returns the display frame interval renders are spaced by, in milliseconds.
+     */
+    double frameInterval() const;
+
+    /**
+     * @brief Zeroes the frame statistics.
+     */
+    void resetStatistics();
+
+private:
+    /**
+     * @brief Applies the deferred changes and renders. Called by the frame timer.
+     */
+    void renderPending();
+
+    /**
+     * @brief Render window StartEvent callback.
+     */
+    void onStartRender(vtkObject* caller, unsigned long event, void* callData);
+
+    /**
+     * @brief Render window EndEvent callback.
+     */
+    void onEndRender(vtkObject* caller, unsigned long event, void* callData);
+
+    QVTKOpenGLNativeWidget*                     view;           /**< Widget whose window is rendered */
+    QTimer                                      frameTimer;     /**< Fires at the next display frame */
+    QElapsedTimer                               sinceRender;    /**< Time since the last render started */
+    QElapsedTimer                               renderTimer;    /**< Times the render in progress */
+    QList<QPair<QString, std::function<void()>>> deferred;      /**< Latest deferred change for each key */
+    unsigned long                               startObserver;  /**< StartEvent observer tag */
+    unsigned long                               endObserver;    /**< EndEvent observer tag */
+    int                                         requests;       /**< Renders requested */
+    int                                         renders;        /**< Renders of the window */
+    double                                      lastTime;       /**< Last render time, in seconds */
+    double                                      totalTime;      /**< Total render time, in seconds */
+    double                                      maxTime;        /**< Longest render time, in seconds */
+};
+
+#endif
@@ -0,0 +1,240 @@
+/**
+  * @file STLReader.cpp
+  * @brief Implementation of the STLReader class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "STLReader.h"
+
+#include <QFile>
+#include <QByteArray>
+#include <QtEndian>
+
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+const qint64 headerSize = 84;   /**< 80 byte comment followed by a 32 bit triangle count */
+const qint64 recordSize = 50;   /**< Normal and 3 vertices (12 floats), then a 16 bit attribute */
+const qint64 vertexBytes = 3 * sizeof(float);
+
+const char endFacet[] = "endfacet";
+const char vertexKeyword[] = "vertex";
+const char facetKeyword[] = "facet";
+
+/**
+ * @brief Returns true for the whitespace characters that separate ASCII STL tokens.
+ */
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+ * @brief Returns true if the keyword is a whole token starting at p.
+ * @param p Start of the token.
+ * @param lineEnd End of the line the token is on.
+ * @param keyword The keyword, nul terminated.
+ */
+inline bool startsToken(const char* p, const char* lineEnd, const char* keyword) {
+    const size_t length = std::strlen(keyword);
+    return static_cast<size_t>(lineEnd - p) >= length && std::memcmp(p, keyword, length) == 0
+        && (p + length == lineEnd || isSpace(p[length]));
+}
+
+/**
+ * @brief Returns true if only spaces or tabs come between the start of p's line and p.
+ */
+inline bool atLineStart(const char* text, const char* p) {
+    while (p > text && (p[-1] == ' ' || p[-1] == '\t'))
+        --p;
+    return p == text || p[-1] == '\n' || p[-1] == '\r';
+}
+
+} // namespace
+
+/**
+ * @brief STLReader::read
+ * Maps the file, reads it as binary or ASCII STL and welds its vertices.
+ * @param fileName The name of the STL file.
+ * @param weldTolerance Grid spacing for vertex welding, 0 to weld identical vertices only.
+ * @param stats If not null, receives the welding statistics.
+ * @return The triangle mesh, or a null pointer if the file could not be read.
+ */
+vtkSmartPointer<vtkPolyData> STLReader::read(const QString& fileName, double weldTolerance, WeldStats* stats) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const qint64 size = file.size();
+    if (size <= 0)
+        return nullptr;
+
+    /* Fall back to reading the whole file if it can't be mapped */
+    QByteArray contents;
+    const uchar* data = file.map(0, size);
+    if (!data) {
+        contents = file.readAll();
+        data = reinterpret_cast<const uchar*>(contents.constData());
+    }
+
+    if (isBinary(data, size)) {
+        /* STL is little endian, as are all the platforms we build for, so the
+         * vertex floats can be welded straight out of the records as they are */
+        VertexSource source;
+        source.base = data + headerSize + vertexBytes;      // skip the normal
+        source.triangleStride = recordSize;
+        source.numTriangles = qFromLittleEndian<quint32>(data + 80);
+        return MeshWelder::weld(source, weldTolerance, stats);
+    }
+
+    std::vector<float> soup;
+    if (!readAscii(data, size, soup))
+        return nullptr;
+
+    VertexSource source;
+    source.base = reinterpret_cast<const uchar*>(soup.data());
+    source.triangleStride = 3 * vertexBytes;
+    source.numTriangles = static_cast<vtkIdType>(soup.size() / 9);
+    return MeshWelder::weld(source, weldTolerance, stats);
+}
+
+/**
+ * @brief STLReader::isBinary
+ * Binary STL headers are free text and may themselves start with "solid", so
+ * the triangle count is checked against the file size first.
+ * @param data Start of the file contents.
+ * @param size Size of the file in bytes.
+ * @return True for a binary file, false for ASCII.
+ */
+bool STLReader::isBinary(const uchar* data, qint64 size) {
+    if (size < headerSize)
+        return false;
+
+    const qint64 expected = headerSize + recordSize * qFromLittleEndian<quint32>(data + 80);
+    if (expected == size)
+        return true;
+
+    if (std::memcmp(data, "solid", 5) == 0)
+        return false;
+
+    /* Some exporters pad binary files, accept them as long as no records are missing */
+    return expected < size;
+}
+
+/**
+ * @brief STLReader::readAscii
+ * Splits the file into chunks that each end on an "endfacet", so no facet is
+ * split between chunks, and parses the chunks in parallel.
+ * @param data Start of the file contents.
+ * @param size Size of the file in bytes.
+ * @param soup Receives 9 floats (3 vertices) per triangle.
+ * @return False if the file is malformed.
+ */
+bool STLReader::readAscii(const uchar* data, qint64 size, std::vector<float>& soup) {
+    const char* text = reinterpret_cast<const char*>(data);
+    const char* textEnd = text + size;
+
+    const qint64 chunkSize = 4 * 1024 * 1024;
+    const qint64 numChunks = qMax<qint64>(1, size / chunkSize);
+
+    std::vector<const char*> bounds(numChunks + 1, textEnd);
+    bounds[0] = text;
+    for (qint64 i = 1; i < numChunks; ++i) {
+        const char* from = qMax(text + i * size / numChunks, bounds[i - 1]);
+        const char* found = std::search(from, textEnd, endFacet, endFacet + sizeof(endFacet) - 1);
+        while (found != textEnd && !atLineStart(text, found))   // e.g. "solid endfacet_plate"
+            found = std::search(found + 1, textEnd, endFacet, endFacet + sizeof(endFacet) - 1);
+        bounds[i] = (found == textEnd) ? textEnd : found + sizeof(endFacet) - 1;
+    }
+
+    std::vector<std::vector<float>> chunks(numChunks);
+    std::vector<char> chunkOk(numChunks, 1);
+    vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+            chunkOk[i] = parseAsciiChunk(bounds[i], bounds[i + 1], chunks[i]);
+    });
+
+    std::vector<size_t> offsets(numChunks + 1, 0);
+    for (qint64 i = 0; i < numChunks; ++i) {
+        if (!chunkOk[i])
+            return false;
+        offsets[i + 1] = offsets[i] + chunks[i].size();
+    }
+
+    soup.resize(offsets[numChunks]);
+    vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i) {
+            std::copy(chunks[i].begin(), chunks[i].end(), soup.begin() + offsets[i]);
+            std::vector<float>().swap(chunks[i]);
+        }
+    });
+
+    return !soup.empty() && soup.size() % 9 == 0;
+}
+
+/**
+ * @brief STLReader::parseAsciiChunk
+ * Steps from line to line with memchr, which the C library vectorises, and
+ * looks only at the first token of each. The three coordinates after a
+ * "vertex" are parsed with std::from_chars. Names on "solid" and "endsolid"
+ * lines, and everything else in the file ("facet normal", "outer loop" etc.),
+ * are skipped over, so a solid named "vertex" is not taken for a vertex.
+ * @param begin Start of the chunk.
+ * @param end End of the chunk.
+ * @param soup Receives 3 floats per vertex.
+ * @return False if a vertex line is malformed or a facet does not have exactly 3 vertices.
+ */
+bool STLReader::parseAsciiChunk(const char* begin, const char* end, std::vector<float>& soup) {
+    /* A facet takes up roughly 250 bytes of text */
+    soup.reserve(static_cast<size_t>(end - begin) / 250 * 9);
+
+    bool inFacet = false;
+    int facetVertices = 0;
+    for (const char* line = begin; line < end; ) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!lineEnd)
+            lineEnd = end;
+
+        const char* p = line;
+        while (p < lineEnd && isSpace(*p))
+            ++p;
+        line = lineEnd + 1;
+
+        if (startsToken(p, lineEnd, vertexKeyword)) {
+            if (!inFacet || facetVertices == 3)
+                return false;
+            ++facetVertices;
+            p += sizeof(vertexKeyword) - 1;
+
+            for (int i = 0; i < 3; ++i) {
+                while (p < lineEnd && isSpace(*p))
+                    ++p;
+                if (p < lineEnd && *p == '+')
+                    ++p;
+
+                float value;
+                std::from_chars_result result = std::from_chars(p, lineEnd, value);
+                if (result.ec != std::errc())
+                    return false;
+                soup.push_back(value);
+                p = result.ptr;
+            }
+        } else if (startsToken(p, lineEnd, facetKeyword)) {
+            if (inFacet)
+                return false;
+            inFacet = true;
+            facetVertices = 0;
+        } else if (startsToken(p, lineEnd, endFacet)) {
+            if (!inFacet || facetVertices != 3)
+                return false;
+            inFacet = false;
+        }
+    }
+
+    return !inFacet;
+}
@@ -0,0 +1,70 @@
+/** @file STLReader.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Memory-mapped STL reader used in place of vtkSTLReader
+  */
+
+#ifndef VIEWER_STLREADER_H
+#define VIEWER_STLREADER_H
+
+#include "MeshWelder.h"
+
+#include <QString>
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include <vector>
+
+/**
+ * @class STLReader
+ * @brief Reads STL files into vtkPolyData.
+ *
+ * Binary files are memory mapped and the triangle records are handed straight
+ * to MeshWelder, with no per-triangle stream reads or point locator, so the
+ * welded points are the only copy of the geometry that is made. ASCII files are
+ * mapped the same way and parsed in parallel chunks before welding.
+ */
+class STLReader {
+public:
+    /**
+     * @brief Reads an STL file and welds its vertices. Safe to call from any thread.
+     * @param fileName The name of the STL file.
+     * @param weldTolerance Grid spacing for vertex welding, 0 to weld identical vertices only.
+     * @param stats If not null, receives the welding statistics.
+     * @return The triangle mesh, or a null pointer if the file could not be read.
+     */
+    static vtkSmartPointer<vtkPolyData> read(const QString& fileName, double weldTolerance = 0.0,
+                                             WeldStats* stats = nullptr);
+
+    /**
+     * @brief Checks whether STL file contents are in the binary format.
+     * @param data Start of the file contents.
+     * @param size Size of the file in bytes.
+     * @return True for a binary file, false for ASCII.
+     */
+    static bool isBinary(const uchar* data, qint64 size);
+
+private:
+    /**
+     * @brief Parses the vertices of an ASCII file into a triangle soup.
+     *
+     * The file is split into chunks at "endfacet" boundaries which are parsed in parallel.
+     * @param data Start of the file contents.
+     * @param size Size of the file in bytes.
+     * @param soup Receives 9 floats (3 vertices) per triangle.
+     * @return False if the file is malformed.
+     */
+    static bool readAscii(const uchar* data, qint64 size, std::vector<float>& soup);
+
+    /**
+     * @brief Parses the vertices in one chunk of an ASCII file, looking only at the first token of each line.
+     * @param begin Start of the chunk.
+     * @param end End of the chunk.
+     * @param soup Receives 3 floats per vertex.
+     * @return False if a vertex line is malformed or a facet does not have exactly 3 vertices.
+     */
+    static bool parseAsciiChunk(const char* begin, const char* end, std::vector<float>& soup);
+};
+
+#endif
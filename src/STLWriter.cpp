@@ -0,0 +1,231 @@
+/**
+  * @file STLWriter.cpp
+  * @brief Implementation of the STLWriter class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "STLWriter.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkPoints.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const qint64 headerSize = 84;   /**< 80 byte comment followed by a 32 bit triangle count */
+const qint64 recordSize = 50;   /**< Normal and 3 vertices (12 floats), then a 16 bit attribute */
+const vtkIdType bufferCells = (4 * 1024 * 1024) / recordSize;  /**< Cells per write when the file can't be mapped */
+
+/* Must not start with "solid", or readers may take the file for ASCII */
+const char headerText[] = "Binary STL exported by the EEEE2076 viewer";
+
+/**
+ * @brief Where each cell of a mesh's polygons starts in the output's triangle records.
+ */
+struct FacetLayout {
+    vtkPolyData*            polyData = nullptr;
+    vtkIdType               numCells = 0;
+    vtkIdType               numTriangles = 0;
+    std::vector<vtkIdType>  firstTriangle;  /**< Per cell plus one, empty when every cell is a triangle */
+
+    vtkIdType triangleOf(vtkIdType cell) const {
+        return firstTriangle.empty() ? cell : firstTriangle[cell];
+    }
+};
+
+FacetLayout layoutFor(vtkPolyData* polyData) {
+    FacetLayout layout;
+    layout.polyData = polyData;
+
+    vtkCellArray* polys = polyData ? polyData->GetPolys() : nullptr;
+    if (!polys || !polyData->GetPoints())
+        return layout;
+
+    layout.numCells = polys->GetNumberOfCells();
+
+    /* Every polygon has at least 3 points, so this only holds for pure triangles */
+    if (polys->GetNumberOfConnectivityIds() == 3 * layout.numCells) {
+        layout.numTriangles = layout.numCells;
+        return layout;
+    }
+
+    layout.firstTriangle.resize(layout.numCells + 1);
+    layout.firstTriangle[0] = 0;
+    for (vtkIdType c = 0; c < layout.numCells; ++c)
+        layout.firstTriangle[c + 1] = layout.firstTriangle[c] + std::max<vtkIdType>(polys->GetCellSize(c) - 2, 0);
+    layout.numTriangles = layout.firstTriangle[layout.numCells];
+    return layout;
+}
+
+inline void storeFloats(uchar*& out, const double* values, int count) {
+    for (int i = 0; i < count; ++i, out += sizeof(float))
+        qToLittleEndian(static_cast<float>(values[i]), out);
+}
+
+/**
+ * @brief Writes one 50 byte triangle record with its facet normal.
+ */
+void writeRecord(uchar* out, const double* p0, const double* p1, const double* p2) {
+    const double u[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    const double v[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+    const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0.0) {
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+    }
+
+    storeFloats(out, n, 3);
+    storeFloats(out, p0, 3);
+    storeFloats(out, p1, 3);
+    storeFloats(out, p2, 3);
+    out[0] = out[1] = 0;
+}
+
+/**
+ * @brief Writes the records of a range of cells in parallel.
+ * @param out Where the first triangle of cellBegin goes.
+ */
+void writeFacets(const FacetLayout& layout, vtkIdType cellBegin, vtkIdType cellEnd, uchar* out) {
+    vtkPoints* points = layout.polyData->GetPoints();
+    vtkCellArray* polys = layout.polyData->GetPolys();
+    const vtkIdType base = layout.triangleOf(cellBegin);
+
+    vtkSMPThreadLocalObject<vtkIdList> cellPoints;
+    vtkSMPTools::For(cellBegin, cellEnd, [&](vtkIdType first, vtkIdType last) {
+        vtkIdList* ids = cellPoints.Local();
+        for (vtkIdType c = first; c < last; ++c) {
+            vtkIdType npts;
+            const vtkIdType* pts;
+            polys->GetCellAtId(c, npts, pts, ids);
+
+            uchar* record = out + (layout.triangleOf(c) - base) * recordSize;
+            double p0[3], p1[3], p2[3];
+            points->GetPoint(pts[0], p0);
+            for (vtkIdType k = 1; k + 1 < npts; ++k, record += recordSize) {
+                points->GetPoint(pts[k], p1);
+                points->GetPoint(pts[k + 1], p2);
+                writeRecord(record, p0, p1, p2);
+            }
+        }
+    });
+}
+
+void writeHeader(uchar* out, vtkIdType numTriangles) {
+    std::memset(out, 0, headerSize);
+    std::memcpy(out, headerText, sizeof(headerText) - 1);
+    qToLittleEndian(static_cast<quint32>(numTriangles), out + 80);
+}
+
+/**
+ * @brief Writes the meshes one after another as a single binary STL file.
+ */
+bool writeFile(const QString& fileName, const std::vector<FacetLayout>& layouts) {
+    vtkIdType numTriangles = 0;
+    for (const FacetLayout& layout : layouts)
+        numTriangles += layout.numTriangles;
+    if (numTriangles > std::numeric_limits<quint32>::max())
+        return false;
+
+    const qint64 size = headerSize + numTriangles * recordSize;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return false;
+
+    bool ok = file.resize(size);
+    uchar* data = ok ? file.map(0, size) : nullptr;
+
+    if (data) {
+        writeHeader(data, numTriangles);
+        uchar* cursor = data + headerSize;
+        for (const FacetLayout& layout : layouts) {
+            if (layout.numCells > 0)
+                writeFacets(layout, 0, layout.numCells, cursor);
+            cursor += layout.numTriangles * recordSize;
+        }
+        ok = file.unmap(data);
+    } else if (ok) {
+        /* No mapping, so fill a reusable buffer a block of cells at a time */
+        std::vector<uchar> buffer(headerSize);
+        writeHeader(buffer.data(), numTriangles);
+        ok = file.write(reinterpret_cast<const char*>(buffer.data()), headerSize) == headerSize;
+
+        for (const FacetLayout& layout : layouts) {
+            for (vtkIdType cell = 0; ok && cell < layout.numCells; cell += bufferCells) {
+                const vtkIdType end = std::min(cell + bufferCells, layout.numCells);
+                const qint64 bytes = (layout.triangleOf(end) - layout.triangleOf(cell)) * recordSize;
+                if (buffer.size() < static_cast<size_t>(bytes))
+                    buffer.resize(bytes);
+
+                writeFacets(layout, cell, end, buffer.data());
+                ok = file.write(reinterpret_cast<const char*>(buffer.data()), bytes) == bytes;
+            }
+        }
+    }
+
+    file.close();
+    if (!ok)
+        file.remove();
+    return ok;
+}
+
+} // namespace
+
+/**
+ * @brief STLWriter::write
+ * @param fileName The file to write.
+ * @param polyData The mesh.
+ * @return True on success.
+ */
+bool STLWriter::write(const QString& fileName, vtkPolyData* polyData) {
+    std::vector<FacetLayout> layouts;
+    layouts.push_back(layoutFor(polyData));
+    return writeFile(fileName, layouts);
+}
+
+/**
+ * @brief STLWriter::writeMerged
+ * @param fileName The file to write.
+ * @param parts The meshes.
+ * @return True on success.
+ */
+bool STLWriter::writeMerged(const QString& fileName, const QList<vtkPolyData*>& parts) {
+    std::vector<FacetLayout> layouts;
+    layouts.reserve(parts.size());
+    for (vtkPolyData* polyData : parts)
+        layouts.push_back(layoutFor(polyData));
+    return writeFile(fileName, layouts);
+}
+
+/**
+ * @brief STLWriter::writeEach
+ * Writes the files in parallel, one file per task. Each file's records are then
+ * written serially, as vtkSMPTools doesn't nest parallel loops by default.
+ * @param fileNames The file to write for each mesh.
+ * @param parts The meshes.
+ * @return The number of files that could not be written.
+ */
+int STLWriter::writeEach(const QStringList& fileNames, const QList<vtkPolyData*>& parts) {
+    std::atomic<int> failures(0);
+    vtkSMPTools::For(0, parts.size(), 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType i = first; i < last; ++i)
+            if (!write(fileNames[i], parts[i]))
+                ++failures;
+    });
+    return failures;
+}
@@ -0,0 +1,53 @@
+/** @file STLWriter.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Parallel binary STL writer used to export the filtered geometry of parts
+  */
+
+#ifndef VIEWER_STLWRITER_H
+#define VIEWER_STLWRITER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <vtkPolyData.h>
+
+/**
+ * @class STLWriter
+ * @brief Writes vtkPolyData to binary STL files.
+ *
+ * The output file is sized up front and memory mapped, then the triangle
+ * records are written straight from the VTK points and cells into the mapping
+ * in parallel, so no copy of the geometry is made. Polygons with more than
+ * three points are written as triangle fans. If the file can't be mapped the
+ * records are written through a large reusable buffer instead.
+ */
+class STLWriter {
+public:
+    /**
+     * @brief Writes one mesh to a binary STL file.
+     * @param fileName The file to write.
+     * @param polyData The mesh.
+     * @return True on success.
+     */
+    static bool write(const QString& fileName, vtkPolyData* polyData);
+
+    /**
+     * @brief Writes several meshes to one binary STL file, one after another.
+     * @param fileName The file to write.
+     * @param parts The meshes.
+     * @return True on success.
+     */
+    static bool writeMerged(const QString& fileName, const QList<vtkPolyData*>& parts);
+
+    /**
+     * @brief Writes each mesh to its own binary STL file, several files at once.
+     * @param fileNames The file to write for each mesh.
+     * @param parts The meshes.
+     * @return The number of files that could not be written.
+     */
+    static int writeEach(const QStringList& fileNames, const QList<vtkPolyData*>& parts);
+};
+
+#endif
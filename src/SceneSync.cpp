@@ -0,0 +1,126 @@
+/**
+  * @file SceneSync.cpp
+  * @brief Implementation of the SceneSync class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "SceneSync.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+
+#include <vtkRenderer.h>
+
+/**
+ * @brief SceneSync::SceneSync
+ * @param model The tree of parts.
+ * @param renderer The renderer the part actors are added to.
+ * @param parent The parent object.
+ */
+SceneSync::SceneSync(ModelPartList* model, vtkRenderer* renderer, QObject* parent)
+    : QObject(parent), model(model), renderer(renderer) {
+    connect(model, &QAbstractItemModel::rowsInserted, this, &SceneSync::onRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &SceneSync::onRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &SceneSync::clear);
+    connect(model, &QAbstractItemModel::modelReset, this, [this]() { updateSubtree(this->model->getRootItem()); });
+}
+
+/**
+ * @brief SceneSync::updatePart
+ * @param part The part.
+ */
+void SceneSync::updatePart(ModelPart* part) {
+    vtkSmartPointer<vtkActor> actor = part->getActor();
+    auto current = actors.find(part);
+
+    if (current != actors.end()) {
+        if (*current == actor)
+            return;
+        renderer->RemoveActor(*current);
+        actors.erase(current);
+    }
+
+    if (actor) {
+        renderer->AddActor(actor);
+        actors.insert(part, actor);
+    }
+}
+
+/**
+ * @brief SceneSync::updateSubtree
+ * @param part The root of the subtree.
+ */
+void SceneSync::updateSubtree(ModelPart* part) {
+    QList<ModelPart*> stack = { part };
+    while (!stack.isEmpty()) {
+        ModelPart* next = stack.takeLast();
+        updatePart(next);
+        for (int i = 0; i < next->childCount(); ++i)
+            stack.append(next->child(i));
+    }
+}
+
+/**
+ * @brief SceneSync::removeSubtree
+ * @param part The root of the subtree.
+ */
+void SceneSync::removeSubtree(ModelPart* part) {
+    QList<ModelPart*> stack = { part };
+    while (!stack.isEmpty()) {
+        ModelPart* next = stack.takeLast();
+        if (vtkSmartPointer<vtkActor> actor = actors.take(next))
+            renderer->RemoveActor(actor);
+        for (int i = 0; i < next->childCount(); ++i)
+            stack.append(next->child(i));
+    }
+}
+
+/**
+ * @brief SceneSync::clear
+ */
+void SceneSync::clear() {
+    for (const auto& actor : std::as_const(actors))
+        renderer->RemoveActor(actor);
+    actors.clear();
+}
+
+/**
+ * @brief SceneSync::actorCount
+ * @return The number of part actors.
+ */
+int SceneSync::actorCount() const {
+    return actors.size();
+}
+
+/**
+ * @brief SceneSync::onRowsInserted
+ * @param parent The parent of the new rows.
+ * @param first The first new row.
+ * @param last The last new row.
+ */
+void SceneSync::onRowsInserted(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partAt(parent);
+    for (int row = first; row <= last && row < parentPart->childCount(); ++row)
+        updateSubtree(parentPart->child(row));
+}
+
+/**
+ * @brief SceneSync::onRowsAboutToBeRemoved
+ * @param parent The parent of the rows.
+ * @param first The first row to be removed.
+ * @param last The last row to be removed.
+ */
+void SceneSync::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partAt(parent);
+    for (int row = first; row <= last && row < parentPart->childCount(); ++row)
+        removeSubtree(parentPart->child(row));
+}
+
+/**
+ * @brief SceneSync::partAt
+ * @param index The index.
+ * @return The part.
+ */
+ModelPart* SceneSync::partAt(const QModelIndex& index) const {
+    return index.isValid() ? static_cast<ModelPart*>(index.internalPointer()) : model->getRootItem();
+}
@@ -0,0 +1,94 @@
+/** @file SceneSync.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Keeps the renderer's part actors in step with the tree by applying only changes
+  */
+
+#ifndef VIEWER_SCENESYNC_H
+#define VIEWER_SCENESYNC_H
+
+#include <QHash>
+#include <QObject>
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+
+class ModelPart;
+class ModelPartList;
+class QModelIndex;
+class vtkRenderer;
+
+/**
+ * @class SceneSync
+ * @brief Tracks the actor each part has in the renderer and applies only the differences.
+ *
+ * Rows removed from the model take their parts' actors out of the renderer,
+ * rows inserted bring in any actors their parts already have, and resetting
+ * the model removes every part actor. A part that is given a new actor, e.g.
+ * when its geometry arrives from the loader, is passed to updatePart(). Each
+ * change costs the number of parts it touches, not the size of the tree, and
+ * props that aren't part actors are never touched.
+ *
+ * The camera is left alone; framing the scene is up to the caller.
+ */
+class SceneSync : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @brief Constructor for the SceneSync class.
+     * @param model The tree of parts.
+     * @param renderer The renderer the part actors are added to.
+     * @param parent The parent object.
+     */
+    SceneSync(ModelPartList* model, vtkRenderer* renderer, QObject* parent = nullptr);
+
+    /**
+     * @brief Brings a part's actor in the renderer up to date, e.g. after it was given geometry.
+     * @param part The part.
+     */
+    void updatePart(ModelPart* part);
+
+    /**
+     * @brief Brings the actors of a part and everything below it up to date.
+     * @param part The root of the subtree.
+     */
+    void updateSubtree(ModelPart* part);
+
+    /**
+     * @brief Removes the actors of a part and everything below it, e.g. before they are deleted.
+     * @param part The root of the subtree.
+     */
+    void removeSubtree(ModelPart* part);
+
+    /**
+     * @brief Removes every part actor from the renderer.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of part actors in the renderer.
+     */
+    int actorCount() const;
+
+private:
+    /**
+     * @brief Called when rows have been inserted into the model.
+     */
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief Called when rows are about to be removed from the model.
+     */
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+
+    /**
+     * @brief Returns the part at an index, or the root for an invalid index.
+     */
+    ModelPart* partAt(const QModelIndex& index) const;
+
+    ModelPartList*                              model;          /**< The tree of parts */
+    vtkRenderer*                                renderer;       /**< Renderer the actors are added to */
+    QHash<ModelPart*, vtkSmartPointer<vtkActor>> actors;        /**< Actor each part has in the renderer */
+};
+
+#endif
@@ -0,0 +1,168 @@
+/**
+  * @file SectionTool.cpp
+  * @brief Implementation of the SectionTool class.
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  */
+
+#include "SectionTool.h"
+
+#include <vtkCommand.h>
+#include <vtkImplicitPlaneRepresentation.h>
+#include <vtkImplicitPlaneWidget2.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindowInteractor.h>
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief SectionTool::SectionTool
+ * @param renderer The renderer whose props the planes are placed around.
+ * @param interactor The interactor that drives the plane widgets.
+ */
+SectionTool::SectionTool(vtkRenderer* renderer, vtkRenderWindowInteractor* interactor)
+    : renderer(renderer), interactor(interactor), planes(vtkSmartPointer<vtkPlaneCollection>::New()) {
+}
+
+/**
+ * @brief SectionTool::~SectionTool
+ */
+SectionTool::~SectionTool() {
+    for (const auto& widget : widgets)
+        widget->Off();
+}
+
+/**
+ * @brief SectionTool::addPlane
+ * Places the plane's widget around the bounds of the visible parts.
+ * @param normal The plane's normal, the side of the plane that is kept.
+ * @return False if there are already maxPlanes planes.
+ */
+bool SectionTool::addPlane(const double normal[3]) {
+    if (widgets.size() >= maxPlanes)
+        return false;
+
+    double bounds[6];
+    renderer->ComputeVisiblePropBounds(bounds);
+    if (!vtkMath::AreBoundsInitialized(bounds)) {
+        const double unitBounds[6] = { -1.0, 1.0, -1.0, 1.0, -1.0, 1.0 };
+        std::copy(unitBounds, unitBounds + 6, bounds);
+    }
+
+    const double centre[3] = { (bounds[0] + bounds[1]) / 2.0,
+                               (bounds[2] + bounds[3]) / 2.0,
+                               (bounds[4] + bounds[5]) / 2.0 };
+    addWidget(centre, normal, bounds);
+    return true;
+}
+
+/**
+ * @brief SectionTool::addParallelPlane
+ * Adds a plane offset along the last plane's normal and facing back towards it.
+ * @param spacing Distance between the planes, 0 for a tenth of the visible parts' size.
+ * @return False if there are no planes yet or already maxPlanes planes.
+ */
+bool SectionTool::addParallelPlane(double spacing) {
+    if (widgets.isEmpty() || widgets.size() >= maxPlanes)
+        return false;
+
+    vtkPlane* last = planes->GetItem(planes->GetNumberOfItems() - 1);
+    double origin[3], normal[3];
+    last->GetOrigin(origin);
+    last->GetNormal(normal);
+    vtkMath::Normalize(normal);
+
+    double bounds[6];
+    renderer->ComputeVisiblePropBounds(bounds);
+    if (spacing <= 0.0) {
+        const double lowCorner[3] = { bounds[0], bounds[2], bounds[4] };
+        const double highCorner[3] = { bounds[1], bounds[3], bounds[5] };
+        spacing = vtkMath::AreBoundsInitialized(bounds)
+                      ? 0.1 * std::sqrt(vtkMath::Distance2BetweenPoints(lowCorner, highCorner))
+                      : 0.1;
+    }
+    if (!vtkMath::AreBoundsInitialized(bounds)) {
+        const double unitBounds[6] = { -1.0, 1.0, -1.0, 1.0, -1.0, 1.0 };
+        std::copy(unitBounds, unitBounds + 6, bounds);
+    }
+
+    const double parallelOrigin[3] = { origin[0] + spacing * normal[0],
+                                       origin[1] + spacing * normal[1],
+                                       origin[2] + spacing * normal[2] };
+    const double facing[3] = { -normal[0], -normal[1], -normal[2] };
+    addWidget(parallelOrigin, facing, bounds);
+    return true;
+}
+
+/**
+ * @brief SectionTool::clear
+ */
+void SectionTool::clear() {
+    for (const auto& widget : widgets)
+        widget->Off();
+    widgets.clear();
+    planes->RemoveAllItems();
+}
+
+/**
+ * @brief SectionTool::planeCount
+ * @return The number of planes.
+ */
+int SectionTool::planeCount() const {
+    return widgets.size();
+}
+
+/**
+ * @brief SectionTool::getPlanes
+ * @return The planes, to be shared by the parts' mappers.
+ */
+vtkPlaneCollection* SectionTool::getPlanes() const {
+    return planes;
+}
+
+/**
+ * @brief SectionTool::addWidget
+ * @param origin A point on the plane.
+ * @param normal The plane's normal.
+ * @param bounds Bounds the widget is sized to.
+ */
+void SectionTool::addWidget(const double origin[3], const double normal[3], const double bounds[6]) {
+    vtkNew<vtkImplicitPlaneRepresentation> representation;
+    representation->SetPlaceFactor(1.25);
+    representation->PlaceWidget(const_cast<double*>(bounds));
+    representation->SetOrigin(const_cast<double*>(origin));
+    representation->SetNormal(const_cast<double*>(normal));
+    representation->OutlineTranslationOff();
+
+    vtkSmartPointer<vtkImplicitPlaneWidget2> widget = vtkSmartPointer<vtkImplicitPlaneWidget2>::New();
+    widget->SetInteractor(interactor);
+    widget->SetCurrentRenderer(renderer);
+    widget->SetRepresentation(representation);
+    widget->AddObserver(vtkCommand::InteractionEvent, this, &SectionTool::onInteraction);
+    widget->On();
+
+    vtkNew<vtkPlane> plane;
+    representation->GetPlane(plane);
+    planes->AddItem(plane);
+    widgets.append(widget);
+}
+
+/**
+ * @brief SectionTool::onInteraction
+ * The widget renders straight after this, so the mappers pick up the moved
+ * plane on that frame without any geometry being touched.
+ * @param caller The widget being dragged.
+ */
+void SectionTool::onInteraction(vtkObject* caller, unsigned long, void*) {
+    for (int i = 0; i < widgets.size(); ++i) {
+        if (widgets[i].GetPointer() != caller)
+            continue;
+
+        auto representation = vtkImplicitPlaneRepresentation::SafeDownCast(widgets[i]->GetRepresentation());
+        representation->GetPlane(planes->GetItem(i));
+        return;
+    }
+}
@@ -0,0 +1,101 @@
+/** @file SectionTool.h
+  *
+  * EEEE2076 - Software Engineering & VR Project
+  *
+  * Interactive section planes applied to every part as GPU clipping planes
+  */
+
+#ifndef VIEWER_SECTIONTOOL_H
+#define VIEWER_SECTIONTOOL_H
+
+#include <QList>
+#include <vtkSmartPointer.h>
+#include <vtkPlane.h>
+#include <vtkPlaneCollection.h>
+
+class vtkImplicitPlaneWidget2;
+class vtkObject;
+class vtkRenderer;
+class vtkRenderWindowInteractor;
+
+/**
+ * @class SectionTool
+ * @brief Section planes that can be dragged and rotated in the view.
+ *
+ * Each plane has a vtkImplicitPlaneWidget2 to move it, and every part's mapper
+ * uses the same vtkPlane objects as clipping planes (see
+ * ModelPart::setSectionPlanes()). Dragging a widget only updates its plane,
+ * and the cut is done per fragment on the GPU, so sections follow the mouse at
+ * frame rate whatever the size of the model. Geometry is only clipped on the
+ * CPU where the exact result is needed, by ModelPart::getClippedOutput().
+ *
+ * Parts keep the side of each plane its normal points to, so two planes facing
+ * each other keep the slab between them.
+ */
+class SectionTool {
+public:
+    /**
+     * @brief Maximum number of section planes. OpenGL mappers support 6 clipping
+     *        planes and one is kept for each part's own clip.
+     */
+    static const int maxPlanes = 5;
+
+    /**
+     * @brief Constructor for the SectionTool class.
+     * @param renderer The renderer whose props the planes are placed around.
+     * @param interactor The interactor that drives the plane widgets.
+     */
+    SectionTool(vtkRenderer* renderer, vtkRenderWindowInteractor* interactor);
+
+    /**
+     * @brief Destructor, removes the plane widgets.
+     */
+    ~SectionTool();
+
+    /**
+     * @brief Adds a plane through the centre of the visible parts.
+     * @param normal The plane's normal, the side of the plane that is kept.
+     * @return False if there are already maxPlanes planes.
+     */
+    bool addPlane(const double normal[3]);
+
+    /**
+     * @brief Adds a plane parallel to the last one, facing it, so the two keep a slab.
+     * @param spacing Distance between the planes, 0 for a tenth of the visible parts' size.
+     * @return False if there are no planes yet or already maxPlanes planes.
+     */
+    bool addParallelPlane(double spacing = 0.0);
+
+    /**
+     * @brief Removes every plane.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of planes.
+     */
+    int planeCount() const;
+
+    /**
+     * @brief Returns the planes, to be shared by the parts' mappers.
+     */
+    vtkPlaneCollection* getPlanes() const;
+
+private:
+    /**
+     * @brief Adds a plane and its widget.
+     */
+    void addWidget(const double origin[3], const double normal[3], const double bounds[6]);
+
+    /**
+     * @brief Copies a widget's plane into the shared plane object while it is dragged.
+     */
+    void onInteraction(vtkObject* caller, unsigned long event, void* callData);
+
+    vtkRenderer*                                        renderer;       /**< Renderer the planes are placed in */
+    vtkRenderWindowInteractor*                          interactor;     /**< Interactor driving the widgets */
+    vtkSmartPointer<vtkPlaneCollection>                 planes;         /**< Planes shared with the parts' mappers */
+    QList<vtkSmartPointer<vtkImplicitPlaneWidget2>>     widgets;        /**< One widget per plane, in the same order */
+};
+
+#endif
@@ -8,8 +8,10 @@
 
 
 #include "mainwindow.h"
+#include "Benchmark.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 /**
  * @brief The main function – entry point of the application.
@@ -24,6 +26,36 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // Command line benchmarks run without opening the main window
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption benchmarkLoad("benchmark-load", "Time loading an STL file and exit.", "file");
+    QCommandLineOption benchmarkTree("benchmark-tree", "Time a tree view over a synthetic tree of parts and exit.", "parts");
+    QCommandLineOption benchmarkSearch("benchmark-search", "Time searching the names of a synthetic tree of parts and exit.", "parts");
+    QCommandLineOption lazyTree("lazy", "Start the benchmark tree as part records, as an opened project does.");
+    QCommandLineOption openTree("open", "Give the benchmark tree's parts geometry files and list them for loading, as opening a project does.");
+    QCommandLineOption reader("reader", "STL reader to benchmark: fast or vtk.", "reader", "fast");
+    QCommandLineOption cpuShrink("cpu-shrink", "Shrink parts with vtkShrinkPolyData instead of in the vertex shader.");
+    parser.addOption(benchmarkLoad);
+    parser.addOption(benchmarkTree);
+    parser.addOption(benchmarkSearch);
+    parser.addOption(lazyTree);
+    parser.addOption(openTree);
+    parser.addOption(reader);
+    parser.addOption(cpuShrink);
+    parser.process(a);
+
+    if (parser.isSet(cpuShrink))
+        ModelPart::setGpuShrinkEnabled(false);
+
+    if (parser.isSet(benchmarkLoad))
+        return Benchmark::loadSTL(parser.value(benchmarkLoad), parser.value(reader));
+    if (parser.isSet(benchmarkTree))
+        return Benchmark::tree(parser.value(benchmarkTree).toInt(), parser.isSet(lazyTree), parser.isSet(openTree));
+    if (parser.isSet(benchmarkSearch))
+        return Benchmark::search(parser.value(benchmarkSearch).toInt());
+
     MainWindow w;
     w.show();
     // Start the Qt event loop
@@ -12,12 +12,12 @@
 #include <vtkRenderer.h>            ///<  VTK class for rendering objects.
 #include <vtkGenericOpenGLRenderWindow.h>  ///<  VTK class for OpenGL render window.
 #include <vtkNew.h>                ///<  VTK class for object creation.
-#include <vtkCylinderSource.h>      ///<  VTK class for creating a cylinder source.
 #include <vtkPolyDataMapper.h>      ///<  VTK class for mapping polygonal data.
 #include <vtkActor.h>              ///<  VTK class for representing an actor in the scene.
 #include <vtkProperty.h>           ///<  VTK class for setting actor properties.
 #include <vtkRendererCollection.h>  ///<  VTK class for managing a collection of renderers.
 #include <vtkLightCollection.h>    ///<  VTK class for managing light collections.
+#include <vtkCullerCollection.h>   ///<  VTK class for the renderer's cullers.
 
 
 
@@ -29,8 +29,29 @@
 #include <QInputDialog>           ///<  Qt class for input dialogs.
 #include <QStandardItemModel>    ///<  Qt class for item model.
 #include <QColorDialog>            ///<  Qt class for color dialogs.
+#include <QProgressBar>           ///<  Qt class for the load progress indicator.
+#include <QPushButton>            ///<  Qt class for the load cancel button.
+#include <QLabel>                 ///<  Qt class for the cache status label.
+#include <QStandardPaths>         ///<  Qt class for locating the cache directory.
+#include <QDir>                   ///<  Qt class for the export and import directories.
+#include <QSet>                   ///<  Qt class for exported file names.
+#include <QRegularExpression>     ///<  Qt class for cleaning exported file names.
+#include <QApplication>           ///<  Qt class for the busy cursor.
+#include <QElapsedTimer>          ///<  Qt class for timing searches.
+#include <QListWidget>            ///<  Qt class for the search results.
+#include <QSignalBlocker>         ///<  Qt class for quieting the index while branches are made.
 
 #include "optiondialog.h"        ///< Custom header for the options dialog.
+#include "ProjectFile.h"         ///< Custom header for project save and open.
+#include "STLWriter.h"           ///< Custom header for STL export.
+#include "SectionTool.h"         ///< Custom header for the section planes.
+#include "PartInstancer.h"       ///< Custom header for instanced drawing of repeated parts.
+#include "LodManager.h"          ///< Custom header for part levels of detail.
+#include "InteractionQuality.h"  ///< Custom header for lower quality while the camera moves.
+#include "PartCuller.h"          ///< Custom header for frustum and small part culling.
+#include "RenderScheduler.h"     ///< Custom header for coalesced rendering.
+#include "SceneSync.h"           ///< Custom header for incremental scene updates.
+#include "OverviewBatch.h"       ///< Custom header for the batched overview.
 
 /**
  * @brief MainWindow::MainWindow
@@ -48,13 +69,50 @@ MainWindow::MainWindow(QWidget* parent)
     connect(ui->treeView, &QTreeView::clicked, this, &MainWindow::handleTreeClicked);
     connect(ui->pushButton_2, &QPushButton::released, this, &MainWindow::on_colourButton_triggered);
     connect(ui->lightSlider, &QSlider::valueChanged, this, &MainWindow::on_lightSlider_valueChanged);
+    connect(ui->shrinkSlider, &QSlider::valueChanged, this, &MainWindow::onShrinkSliderChanged);
     // connect(ui->startVRButton, &QPushButton::cliscked, this, &MainWindow::onStartVRButtonClicked);
 
+    /* Processed geometry is cached between sessions, capped at 2 GB */
+    geometryCache = new GeometryCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/geometry",
+                                      qint64(2) * 1024 * 1024 * 1024);
+
+    /* Background STL loading, with progress and cancel in the status bar */
+    /* Parts loaded from the same bytes share one mesh */
+    geometryStore = new GeometryStore;
+
+    partLoader = new PartLoader(this);
+    partLoader->setCache(geometryCache);
+    partLoader->setStore(geometryStore);
+    connect(partLoader, &PartLoader::partLoaded, this, &MainWindow::onPartLoaded);
+    connect(partLoader, &PartLoader::partReady, this, &MainWindow::onPartReady);
+    connect(partLoader, &PartLoader::loadFailed, this, &MainWindow::onPartLoadFailed);
+    connect(partLoader, &PartLoader::progressChanged, this, &MainWindow::onLoadProgress);
+    connect(partLoader, &PartLoader::finished, this, &MainWindow::onLoadFinished);
+
+    loadProgress = new QProgressBar(this);
+    loadProgress->setMaximumWidth(200);
+    loadProgress->setFormat("Loading %v/%m");
+    loadProgress->hide();
+    loadCancel = new QPushButton("Cancel", this);
+    loadCancel->hide();
+    connect(loadCancel, &QPushButton::released, partLoader, &PartLoader::cancel);
+    ui->statusbar->addPermanentWidget(loadProgress);
+    ui->statusbar->addPermanentWidget(loadCancel);
+
+    cacheStatus = new QLabel(this);
+    ui->statusbar->addPermanentWidget(cacheStatus);
+    storeStatus = new QLabel(this);
+    ui->statusbar->addPermanentWidget(storeStatus);
+    updateCacheStatus();
+
 
     //initalizing vtk
     renderWindow = vtkSmartPointer<vtkGenericOpenGLRenderWindow>::New();
     ui->vtkWidget->setRenderWindow(renderWindow);
 
+    /* Every render goes through the scheduler, at most once per display frame */
+    renderScheduler = new RenderScheduler(ui->vtkWidget, this);
+
     renderer = vtkSmartPointer<vtkRenderer>::New();
 
     vtkSmartPointer<vtkLight> lightTop = vtkSmartPointer<vtkLight>::New();
@@ -97,22 +155,23 @@ MainWindow::MainWindow(QWidget* parent)
 
     renderWindow->AddRenderer(renderer);
 
+    /* Section planes are dragged with widgets and clip every part on the GPU */
+    sectionTool = new SectionTool(renderer, renderWindow->GetInteractor());
 
-    vtkNew<vtkCylinderSource> cylinder;
-    cylinder->SetResolution(8);
-
-    vtkNew<vtkPolyDataMapper> mapper;
-    mapper->SetInputConnection(cylinder->GetOutputPort());
-
-    vtkNew<vtkActor> actor;
-    actor->SetMapper(mapper);
-    actor->GetProperty()->SetColor(1.0, 0.0, 0.35);
-    renderer->AddActor(actor);
-    renderer->ResetCamera();
-
+    /* Repeated parts share one mesh and are drawn with one instanced mapper */
+    instancer = new PartInstancer(renderer);
+    instancer->setSectionPlanes(sectionTool->getPlanes());
 
+    /* The batched overview draws plain parts through one composite mapper, off until chosen */
+    overviewBatch = new OverviewBatch(renderer);
+    overviewBatch->setSectionPlanes(sectionTool->getPlanes());
 
+    /* Large parts are decimated in the background and drawn coarser as they get smaller on screen */
+    lodManager = new LodManager(renderer, this);
+    lodManager->setCache(geometryCache);
 
+    /* While the camera moves, coarser levels and culling keep frames within 60 FPS */
+    interactionQuality = new InteractionQuality(renderer, renderWindow->GetInteractor(), lodManager);
 
     ui->treeView->addAction(ui->actionItemOptions);
 
@@ -123,6 +182,33 @@ MainWindow::MainWindow(QWidget* parent)
     ui->treeView->setModel(this->partList);
     ui->treeView->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
 
+    /* The Visible, Shrink and Clip checkboxes change the tree through the model */
+    connect(partList, &ModelPartList::subtreeChecked, this, &MainWindow::onSubtreeChecked);
+
+    /* Part actors follow the tree's changes rather than being rebuilt */
+    sceneSync = new SceneSync(this->partList, renderer, this);
+
+    /* Part names are indexed as the tree changes, so a search only checks likely matches */
+    nameIndex = new PartNameIndex(this->partList, this);
+    connect(nameIndex, &PartNameIndex::changed, this, [this]() {
+        if (!ui->searchEdit->text().isEmpty())
+            updateSearch();
+    });
+    ui->searchResults->hide();
+
+    /* Off-screen and tiny parts are culled by subassembly, ahead of the renderer's own culler */
+    partCuller = vtkSmartPointer<PartCuller>::New();
+    partCuller->setRoot(this->partList->getRootItem());
+    vtkNew<vtkCullerCollection> cullers;
+    cullers->AddItem(partCuller);
+    renderer->GetCullers()->InitTraversal();
+    while (vtkCuller* culler = renderer->GetCullers()->GetNextItem())
+        cullers->AddItem(culler);
+    renderer->GetCullers()->RemoveAllItems();
+    cullers->InitTraversal();
+    while (vtkCuller* culler = cullers->GetNextItem())
+        renderer->AddCuller(culler);
+
     /* Manually create a model tree - there a much better and more flexible ways of doing this, e.g. with
     nested function. this is just a quick example and a start point*/
     ModelPart* rootItem = this->partList->getRootItem();
@@ -132,13 +218,10 @@ MainWindow::MainWindow(QWidget* parent)
     for (int i = 0; i < 3; i++) {
 
         QString name = QString("TopLevel %1").arg(i);
-        QString visible("true");
-        QString shrink = "false";
-        QString clip = "false";
 
 
         //Create child item
-        ModelPart* childItem = new ModelPart({ name, visible, shrink, clip });
+        ModelPart* childItem = new ModelPart(name);
 
         //Append to tree top level
         rootItem->appendChild(childItem);
@@ -148,12 +231,9 @@ MainWindow::MainWindow(QWidget* parent)
         for (int j = 0; j < 5; j++) {
 
             QString name = QString("Item %1,%2").arg(i).arg(j);
-            QString visible("true");
-            QString shrink = "false";
-            QString clip = "false";
 
 
-            ModelPart* childChildItem = new ModelPart({ name, visible, shrink, clip });
+            ModelPart* childChildItem = new ModelPart(name);
 
             //Append to parent
             childItem->appendChild(childChildItem);
@@ -171,6 +251,15 @@ MainWindow::MainWindow(QWidget* parent)
  */
 MainWindow::~MainWindow()
 {
+    delete partLoader;      // waits for loader threads that may be using the cache
+    delete interactionQuality;
+    delete lodManager;      // likewise for decimation jobs
+    delete geometryCache;
+    delete geometryStore;
+    delete instancer;
+    delete overviewBatch;
+    delete sectionTool;
+    delete renderScheduler;
     delete ui;
 }
 
@@ -205,22 +294,20 @@ void MainWindow::handleTreeClicked() {
     QModelIndex index = ui->treeView->currentIndex();
     ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
 
-    QString text = selectedPart->data(0).toString();
+    QString text = selectedPart->name();
     emit statusUpdateMessage(QString("The selected item is: ") + text, 0);
 
 }
 
 /**
  * @brief MainWindow::on_actionOpen_FIle_triggered
- * Opens an STL file, loads it, adds it to the scene, and updates the tree view.
+ * Queues the selected STL files for loading in the background. Each part is
+ * added to the tree under the selected item once its file has been read.
  */
 void MainWindow::on_actionOpen_FIle_triggered()
 {
-    QString fileName = QFileDialog::getOpenFileName(this, "Open STL File", "", "STL Files (*.stl)");
-    if (fileName.isEmpty()) return;
-
-    QFileInfo fileInfo(fileName);
-    QString partName = fileInfo.fileName();
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, "Open STL File", "", "STL Files (*.stl)");
+    if (fileNames.isEmpty()) return;
 
     QModelIndex selectedIndex = ui->treeView->currentIndex();
     if (!selectedIndex.isValid()) {
@@ -228,46 +315,577 @@ void MainWindow::on_actionOpen_FIle_triggered()
         return;
     }
 
-    QList<QVariant> data = { partName, "true", "false", "false" };
-    QModelIndex newItemIndex = partList->appendChild(selectedIndex, data);
+    for (const QString& fileName : fileNames)
+        pendingLoads.insert(fileName, QPersistentModelIndex(selectedIndex));
 
-    ModelPart* part = static_cast<ModelPart*>(newItemIndex.internalPointer());
-    part->loadSTL(fileName);
+    partLoader->load(fileNames);
+}
 
-    if (part->getActor()) {
-        renderer->AddActor(part->getActor());
+/**
+ * @brief MainWindow::onPartLoaded
+ * Adds a part read by the background loader to the tree and hands its actor to the renderer.
+ * @param fileName The file that was loaded.
+ * @param pipeline The pipeline built for the file.
+ */
+void MainWindow::onPartLoaded(const QString& fileName, const PartPipeline& pipeline)
+{
+    QModelIndex parentIndex;
+    auto pending = pendingLoads.find(fileName);
+    if (pending != pendingLoads.end()) {
+        parentIndex = *pending;
+        pendingLoads.erase(pending);
+    }
 
-        renderer->ResetCamera();
-        renderer->ResetCameraClippingRange();
-        renderer->GetRenderWindow()->Render();
-        ui->vtkWidget->renderWindow()->Render();
-    } else {
+    QFileInfo fileInfo(fileName);
+    QString partName = fileInfo.fileName();
+
+    QModelIndex newItemIndex = partList->appendChild(parentIndex, partName);
+
+    ModelPart* part = static_cast<ModelPart*>(newItemIndex.internalPointer());
+    const int sharedParts = instancer->sharedParts();
+    part->setPipeline(pipeline);
+    part->setSectionPlanes(sectionTool->getPlanes());
+    instancer->addPart(part, pipeline.shapeKey, pipeline.shapeOrigin);
+    lodManager->addPart(part);
+    overviewBatch->addPart(part);
+    updateCacheStatus();
+
+    if (!part->getActor())
         return;
-    }
+
+    /* Only the first part of an empty scene is framed, later ones leave the camera where the user put it */
+    const bool emptyScene = sceneSync->actorCount() == 0;
+    sceneSync->updatePart(part);
+    if (emptyScene)
+        frameBounds(partList->getRootItem());
 
     renderer->SetBackground(0.8, 0.8, 0.8);
-    updateRender();
+    renderScheduler->requestRender();
+
+    const WeldStats& stats = part->getWeldStats();
+    QString message = QString("Loaded %1: welded %2 vertices to %3, saving %4 MB")
+                          .arg(partName)
+                          .arg(stats.inputVertices)
+                          .arg(stats.outputPoints)
+                          .arg(stats.bytesSaved / (1024.0 * 1024.0), 0, 'f', 1);
+    if (instancer->sharedParts() > sharedParts)
+        message += QString("; %1 parts share %2 meshes, saving %3 MB")
+                       .arg(instancer->sharedParts())
+                       .arg(instancer->sharedShapes())
+                       .arg(instancer->bytesSaved() / (1024.0 * 1024.0), 0, 'f', 1);
+    statusBar()->showMessage(message);
+}
+
+/**
+ * @brief MainWindow::onPartReady
+ * Builds the actor of a part from an opened project and adds it to the scene.
+ * The camera is left alone so that parts streaming in don't move the view.
+ * @param part The part.
+ * @param pipeline The pipeline built for the part.
+ */
+void MainWindow::onPartReady(ModelPart* part, const PartPipeline& pipeline)
+{
+    if (!queuedParts.remove(part))
+        return;     // the tree has been replaced since the part was queued
+
+    part->setPipeline(pipeline);
+    part->setSectionPlanes(sectionTool->getPlanes());
+    instancer->addPart(part, pipeline.shapeKey, pipeline.shapeOrigin);
+    lodManager->addPart(part);
+    overviewBatch->addPart(part);
+    sceneSync->updatePart(part);
+    updateCacheStatus();
+    renderScheduler->requestRender();
+}
+
+/**
+ * @brief MainWindow::onPartLoadFailed
+ * Reports a file that could not be loaded.
+ * @param fileName The file that failed.
+ */
+void MainWindow::onPartLoadFailed(const QString& fileName)
+{
+    pendingLoads.remove(fileName);
+    statusBar()->showMessage("Could not load: " + fileName);
+}
+
+/**
+ * @brief MainWindow::onLoadProgress
+ * Shows the progress of the current load in the status bar.
+ * @param done Number of files loaded so far.
+ * @param total Number of files being loaded.
+ */
+void MainWindow::onLoadProgress(int done, int total)
+{
+    loadProgress->setRange(0, total);
+    loadProgress->setValue(done);
+    loadProgress->show();
+    loadCancel->show();
+}
+
+/**
+ * @brief MainWindow::onLoadFinished
+ * Hides the progress indicator when a load completes or is cancelled.
+ * @param cancelled True if the load was cancelled.
+ */
+void MainWindow::onLoadFinished(bool cancelled)
+{
+    loadProgress->hide();
+    loadCancel->hide();
+    updateCacheStatus();
+
+    if (cancelled) {
+        pendingLoads.clear();
+        queuedParts.clear();
+        frameWhenLoaded = false;
+        statusBar()->showMessage("Loading cancelled");
+    } else if (frameWhenLoaded) {
+        frameWhenLoaded = false;
+        frameBounds(partList->getRootItem());
+    }
+}
+
+/**
+ * @brief MainWindow::loadVisibleGeometry
+ * Walks a subtree and queues every visible part that has somewhere to load
+ * geometry from but hasn't been loaded, so hidden parts of a large project
+ * cost nothing until they are shown. Branches still held as records are only
+ * made if something in them is visible; as every drawn part needs its own
+ * actor, opening a project with everything shown makes all of its parts.
+ * @param part The root of the subtree.
+ */
+void MainWindow::loadVisibleGeometry(ModelPart* part)
+{
+    QList<ModelPart*> parts;
+    for (ModelPart* next : partList->visibleGeometryParts(part)) {
+        if (!next->getActor() && !queuedParts.contains(next)) {
+            parts.append(next);
+            queuedParts.insert(next);
+        }
+    }
+
+    partLoader->loadParts(parts);
+}
+
+/**
+ * @brief MainWindow::updateCacheStatus
+ * Shows the geometry cache hit and miss counts and its size, and the loads
+ * that shared a mesh already in use, in the status bar.
+ */
+void MainWindow::updateCacheStatus()
+{
+    cacheStatus->setText(QString("Cache: %1 hits, %2 misses (%3 MB)")
+                             .arg(geometryCache->hits())
+                             .arg(geometryCache->misses())
+                             .arg(geometryCache->size() / (1024 * 1024)));
+    storeStatus->setText(QString("Shared: %1 duplicate loads, %2 MB saved")
+                             .arg(geometryStore->duplicateLoads())
+                             .arg(geometryStore->bytesSaved() / (1024.0 * 1024.0), 0, 'f', 1));
 }
 
 /**
  * @brief MainWindow::on_actionSave_File_triggered
- * Saves a dummy STL file.  (Currently a placeholder).
+ * Saves the part tree to a project file, optionally with the parts' geometry
+ * embedded so that the project opens without the original STL files.
  */
 void MainWindow::on_actionSave_File_triggered()
 {
-    emit statusUpdateMessage( QString("Save file action triggered"), 0);
-    QString fileName = QFileDialog::getSaveFileName(this, "Save File", "", "STL Files (*.stl)");
-    if (!fileName.isEmpty()) {
-        QFile file(fileName);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            QTextStream out(&file);
-            out << "This would be the saved STL data.\n";
-            file.close();
-            statusBar()->showMessage("File saved: " + fileName);
-        } else {
-            QMessageBox::warning(this, "Save Error", "Could not save file.");
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Project", "", "Project Files (*.fsproj)");
+    if (fileName.isEmpty()) return;
+
+    QMessageBox::StandardButton embed = QMessageBox::question(this, "Save Project",
+        "Embed part geometry in the project?\n\n"
+        "Embedded projects are larger but open faster and don't need the STL files.",
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::Yes);
+    if (embed == QMessageBox::Cancel) return;
+
+    if (ProjectFile::save(fileName, partList->getRootItem(), embed == QMessageBox::Yes))
+        statusBar()->showMessage("Project saved: " + fileName);
+    else
+        QMessageBox::warning(this, "Save Error", "Could not save project.");
+}
+
+/**
+ * @brief MainWindow::on_actionOpen_Project_triggered
+ * Replaces the tree with the project's and then loads geometry for the visible
+ * parts in the background. Hidden parts are loaded when they are first shown.
+ */
+void MainWindow::on_actionOpen_Project_triggered()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Open Project", "", "Project Files (*.fsproj)");
+    if (fileName.isEmpty()) return;
+
+    bool ok;
+    QList<ModelPart*> parts = ProjectFile::load(fileName, &ok);
+    if (!ok) {
+        QMessageBox::warning(this, "Open Error", "Could not open project: " + fileName);
+        return;
+    }
+
+    /* Results still on their way belong to the old tree */
+    partLoader->cancel();
+    pendingLoads.clear();
+    queuedParts.clear();
+    lodManager->clear();
+
+    partList->replaceParts(parts);      // the old parts' actors leave the scene with them
+    ui->treeView->expandToDepth(0);     // deeper branches are made when they are expanded
+    renderScheduler->requestRender();
+
+    loadVisibleGeometry(partList->getRootItem());
+    frameWhenLoaded = partLoader->isBusy();
+    statusBar()->showMessage("Opened project: " + fileName);
+}
+
+/**
+ * @brief MainWindow::on_actionImportFolder_triggered
+ * The whole folder is built as a subtree outside the model and goes into the
+ * tree with one row insert, under the selected item or at the top level, so
+ * the tree view updates once however many files there are. The geometry is
+ * then loaded in the background as for an opened project.
+ */
+void MainWindow::on_actionImportFolder_triggered()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, "Import Folder");
+    if (directory.isEmpty())
+        return;
+
+    int files = 0;
+    ModelPart* folder = buildFolderTree(directory, files);
+    if (!folder) {
+        QMessageBox::information(this, "Import Folder", "There are no STL files in " + directory);
+        return;
+    }
+
+    const QModelIndex parentIndex = ui->treeView->currentIndex().siblingAtColumn(ModelPartList::NameColumn);
+    const int row = partList->rowCount(parentIndex);
+    partList->insertParts(parentIndex, row, { folder });
+    ui->treeView->expand(partList->index(row, 0, parentIndex));
+
+    const bool emptyScene = sceneSync->actorCount() == 0;
+    loadVisibleGeometry(folder);
+    frameWhenLoaded = frameWhenLoaded || (emptyScene && partLoader->isBusy());
+    statusBar()->showMessage(QString("Importing %1 STL files from %2").arg(files).arg(directory));
+}
+
+/**
+ * @brief MainWindow::buildFolderTree
+ * Subfolders become child items, and ones without STL files are left out.
+ * @param directory The folder.
+ * @param files Incremented by the number of STL files found.
+ * @return The folder's item, owned by the caller, or nullptr if the folder has no STL files.
+ */
+ModelPart* MainWindow::buildFolderTree(const QString& directory, int& files)
+{
+    const QDir dir(directory);
+    QList<ModelPart*> children;
+
+    for (const QFileInfo& subfolder : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name))
+        if (ModelPart* child = buildFolderTree(subfolder.absoluteFilePath(), files))
+            children.append(child);
+
+    for (const QFileInfo& file : dir.entryInfoList({ "*.stl", "*.STL" }, QDir::Files, QDir::Name)) {
+        ModelPart* part = new ModelPart(file.fileName());
+        PartSource origin;
+        origin.fileName = file.absoluteFilePath();
+        part->setGeometrySource(origin);
+        children.append(part);
+        ++files;
+    }
+
+    if (children.isEmpty())
+        return nullptr;
+
+    ModelPart* folder = new ModelPart(dir.dirName());
+    folder->insertChildren(0, children);
+    return folder;
+}
+
+/**
+ * @brief MainWindow::on_actionExport_STL_triggered
+ * Exports what the viewer shows, i.e. each visible part's shrink and clip filter
+ * output, either merged into one STL file or as one file per part.
+ */
+void MainWindow::on_actionExport_STL_triggered()
+{
+    QList<ModelPart*> parts;
+    QList<ModelPart*> stack = { partList->getRootItem() };
+    while (!stack.isEmpty()) {
+        ModelPart* part = stack.takeFirst();
+        if (part->visible() && part->getSource())
+            parts.append(part);
+        for (int i = 0; i < part->childCount(); ++i)
+            stack.append(part->child(i));
+    }
+
+    if (parts.isEmpty()) {
+        QMessageBox::information(this, "Export STL", "There are no visible parts to export.");
+        return;
+    }
+
+    QMessageBox::StandardButton merge = QMessageBox::question(this, "Export STL",
+        QString("Merge the %1 visible parts into one file?\n\n"
+                "Choose No to write one file per part.").arg(parts.size()),
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::Yes);
+    if (merge == QMessageBox::Cancel) return;
+
+    QString fileName, directory;
+    QStringList fileNames;
+    if (merge == QMessageBox::Yes) {
+        fileName = QFileDialog::getSaveFileName(this, "Export STL", "", "STL Files (*.stl)");
+        if (fileName.isEmpty()) return;
+    } else {
+        directory = QFileDialog::getExistingDirectory(this, "Export STL To");
+        if (directory.isEmpty()) return;
+
+        /* Files are named after their parts, numbered where names repeat */
+        QSet<QString> used;
+        for (ModelPart* part : parts) {
+            QString base = part->name();
+            if (base.endsWith(".stl", Qt::CaseInsensitive))
+                base.chop(4);
+            base.replace(QRegularExpression("[\\\\/:*?\"<>|]"), "_");
+            if (base.isEmpty())
+                base = "part";
+
+            QString name = base;
+            for (int n = 2; used.contains(name.toLower()); ++n)
+                name = QString("%1_%2").arg(base).arg(n);
+            used.insert(name.toLower());
+            fileNames.append(QDir(directory).filePath(name + ".stl"));
         }
     }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    /* Parts are exported as cut by the section and clip planes, which only the
+     * GPU has done so far, so clip them exactly here */
+    QList<vtkSmartPointer<vtkPolyData>> clipped;
+    QList<vtkPolyData*> meshes;
+    for (ModelPart* part : parts) {
+        clipped.append(part->getClippedOutput());
+        meshes.append(clipped.last());
+    }
+
+    if (merge == QMessageBox::Yes) {
+        bool ok = STLWriter::writeMerged(fileName, meshes);
+        QApplication::restoreOverrideCursor();
+
+        if (ok)
+            statusBar()->showMessage(QString("Exported %1 parts to %2").arg(parts.size()).arg(fileName));
+        else
+            QMessageBox::warning(this, "Export Error", "Could not write " + fileName);
+        return;
+    }
+
+    int failures = STLWriter::writeEach(fileNames, meshes);
+    QApplication::restoreOverrideCursor();
+
+    if (failures == 0)
+        statusBar()->showMessage(QString("Exported %1 parts to %2").arg(parts.size()).arg(directory));
+    else
+        QMessageBox::warning(this, "Export Error", QString("Could not write %1 of %2 files.").arg(failures).arg(parts.size()));
+}
+
+/**
+ * @brief MainWindow::on_actionAddSectionPlane_triggered
+ * Adds a section plane through the middle of the model, facing along the chosen axis.
+ * The plane can then be dragged and rotated with its widget.
+ */
+void MainWindow::on_actionAddSectionPlane_triggered()
+{
+    bool ok;
+    QString axis = QInputDialog::getItem(this, "Add Section Plane", "Keep the side facing:",
+                                         { "+X", "-X", "+Y", "-Y", "+Z", "-Z" }, 4, false, &ok);
+    if (!ok) return;
+
+    double normal[3] = { 0.0, 0.0, 0.0 };
+    normal[axis[1].unicode() - 'X'] = (axis[0] == '+') ? 1.0 : -1.0;
+
+    if (!sectionTool->addPlane(normal)) {
+        QMessageBox::information(this, "Add Section Plane",
+                                 QString("At most %1 section planes can be used.").arg(SectionTool::maxPlanes));
+        return;
+    }
+
+    applySectionPlanes();
+}
+
+/**
+ * @brief MainWindow::on_actionAddParallelPlane_triggered
+ * Adds a plane facing the last one, so that the two keep a slab of the model.
+ */
+void MainWindow::on_actionAddParallelPlane_triggered()
+{
+    if (sectionTool->planeCount() == 0) {
+        QMessageBox::information(this, "Add Parallel Plane", "Add a section plane first.");
+        return;
+    }
+    if (!sectionTool->addParallelPlane()) {
+        QMessageBox::information(this, "Add Parallel Plane",
+                                 QString("At most %1 section planes can be used.").arg(SectionTool::maxPlanes));
+        return;
+    }
+
+    applySectionPlanes();
+}
+
+/**
+ * @brief MainWindow::on_actionClearSectionPlanes_triggered
+ * Removes every section plane.
+ */
+void MainWindow::on_actionClearSectionPlanes_triggered()
+{
+    sectionTool->clear();
+    applySectionPlanes();
+}
+
+/**
+ * @brief MainWindow::applySectionPlanes
+ * Gives every part the current set of section planes. Only needed when planes
+ * are added or removed, moving a plane just needs a render.
+ */
+void MainWindow::applySectionPlanes()
+{
+    QList<ModelPart*> stack = { partList->getRootItem() };
+    while (!stack.isEmpty()) {
+        ModelPart* part = stack.takeLast();
+        part->setSectionPlanes(sectionTool->getPlanes());
+        for (int i = 0; i < part->childCount(); ++i)
+            stack.append(part->child(i));
+    }
+
+    instancer->setSectionPlanes(sectionTool->getPlanes());
+    overviewBatch->setSectionPlanes(sectionTool->getPlanes());
+
+    renderScheduler->requestRender();
+    statusBar()->showMessage(QString("%1 section plane(s)").arg(sectionTool->planeCount()));
+}
+
+/**
+ * @brief MainWindow::on_actionWeldTolerance_triggered
+ * Asks for the grid spacing used to weld vertices of STL files loaded from now on.
+ * Vertices are welded when they snap to the same cell, so two vertices closer
+ * than the spacing but either side of a cell boundary are kept apart.
+ */
+void MainWindow::on_actionWeldTolerance_triggered()
+{
+    bool ok;
+    double tolerance = QInputDialog::getDouble(this, "Weld Grid Spacing",
+                                               "Weld vertices in the same grid cell of size (0 = identical only):",
+                                               partLoader->weldTolerance(), 0.0, 100.0, 4, &ok);
+    if (!ok) return;
+
+    partLoader->setWeldTolerance(tolerance);
+    statusBar()->showMessage(QString("Weld grid spacing set to %1").arg(tolerance));
+}
+
+/**
+ * @brief MainWindow::on_actionLodThresholds_triggered
+ * Asks for the projected sizes, in pixels, below which each level of detail is
+ * used. The number of sizes sets the number of levels built for parts loaded
+ * from now on.
+ */
+void MainWindow::on_actionLodThresholds_triggered()
+{
+    QStringList current;
+    for (double pixels : lodManager->thresholds())
+        current << QString::number(pixels);
+
+    bool ok;
+    const QString text = QInputDialog::getText(this, "LOD Thresholds",
+                                               "Sizes in pixels below which each level is used, largest first:",
+                                               QLineEdit::Normal, current.join(", "), &ok);
+    if (!ok) return;
+
+    QList<double> thresholds;
+    for (const QString& field : text.split(',', Qt::SkipEmptyParts)) {
+        thresholds.append(field.trimmed().toDouble(&ok));
+        if (!ok) break;
+    }
+
+    if (!ok || !lodManager->setThresholds(thresholds)) {
+        QMessageBox::warning(this, "LOD Thresholds",
+                             QString("Enter 2 to %1 decreasing sizes above zero, e.g. 400, 150, 50").arg(LodManager::maxLevels));
+        return;
+    }
+
+    renderScheduler->requestRender();
+    statusBar()->showMessage("LOD thresholds set to " + text);
+}
+
+/**
+ * @brief MainWindow::on_actionLodOverlay_toggled
+ * @param checked True to label each part with the level it is drawn at.
+ */
+void MainWindow::on_actionLodOverlay_toggled(bool checked)
+{
+    lodManager->setOverlayVisible(checked);
+    renderScheduler->requestRender();
+}
+
+/**
+ * @brief MainWindow::on_actionBatchedOverview_toggled
+ * @param checked True to draw plain parts through one composite mapper.
+ */
+void MainWindow::on_actionBatchedOverview_toggled(bool checked)
+{
+    overviewBatch->setEnabled(checked, partList->getRootItem());
+    renderScheduler->requestRender();
+    renderScheduler->flush();      // the batch is built by this render
+
+    if (checked)
+        statusBar()->showMessage(QString("Batched overview: %1 parts drawn by one mapper").arg(overviewBatch->batchedParts()));
+    else
+        statusBar()->showMessage("Batched overview off");
+}
+
+/**
+ * @brief MainWindow::on_actionCullingThreshold_triggered
+ * Asks for the projected size below which parts and subassemblies are culled.
+ */
+void MainWindow::on_actionCullingThreshold_triggered()
+{
+    bool ok;
+    double pixels = QInputDialog::getDouble(this, "Culling Threshold",
+                                            "Cull parts smaller on screen than (pixels, 0 = off):",
+                                            partCuller->minimumPixels(), 0.0, 1000.0, 1, &ok);
+    if (!ok) return;
+
+    partCuller->setMinimumPixels(pixels);
+    renderScheduler->requestRender();
+    renderScheduler->flush();      // the statistics come from this render
+    on_actionCullingStats_triggered();
+}
+
+/**
+ * @brief MainWindow::on_actionFrameStats_triggered
+ * Shows the render times since the last time the statistics were shown, then
+ * starts counting again.
+ */
+void MainWindow::on_actionFrameStats_triggered()
+{
+    statusBar()->showMessage(QString("%1 renders for %2 requests: last %3 ms, mean %4 ms, worst %5 ms (frame %6 ms)")
+                                 .arg(renderScheduler->renderCount())
+                                 .arg(renderScheduler->requestedRenders())
+                                 .arg(renderScheduler->lastFrameTime(), 0, 'f', 1)
+                                 .arg(renderScheduler->averageFrameTime(), 0, 'f', 1)
+                                 .arg(renderScheduler->maxFrameTime(), 0, 'f', 1)
+                                 .arg(renderScheduler->frameInterval(), 0, 'f', 1));
+    renderScheduler->resetStatistics();
+}
+
+/**
+ * @brief MainWindow::on_actionCullingStats_triggered
+ * Shows how many parts the last frame drew and culled.
+ */
+void MainWindow::on_actionCullingStats_triggered()
+{
+    statusBar()->showMessage(QString("Last frame: %1 parts drawn, %2 culled (%3 whole subassemblies), threshold %4 px")
+                                 .arg(partCuller->submittedParts())
+                                 .arg(partCuller->culledParts())
+                                 .arg(partCuller->culledSubtrees())
+                                 .arg(partCuller->minimumPixels()));
 }
 
 /**
@@ -320,31 +938,34 @@ void MainWindow::on_treeViewContextMenu(const QPoint &pos)
         ModelPart* item = static_cast<ModelPart*>(index.internalPointer());
         if (!item) return;
 
-        QString partName = item->data(0).toString();  // Column 0 = name
+        QString partName = item->name();
+
+        /* A right click on one of several selected rows acts on all of them, e.g. every match of a search */
+        QModelIndexList targets = { index.siblingAtColumn(ModelPartList::NameColumn) };
+        if (ui->treeView->selectionModel()->isRowSelected(index.row(), index.parent()))
+            targets = ui->treeView->selectionModel()->selectedRows(ModelPartList::NameColumn);
+        if (targets.size() > 1)
+            partName = QString("%1 parts").arg(targets.size());
 
         QAction* changeColour = contextMenu.addAction("Change colour");
 
         QAction* clipFilter = contextMenu.addAction("Toggle clip filter");
         clipFilter->setCheckable(true);
-        QString clipState = index.siblingAtColumn(3).data().toString();
-        bool isClipped = (clipState == "true");
-        clipFilter->setChecked(isClipped);
+        clipFilter->setChecked(item->hasFlag(ModelPart::Clip));
 
         QAction* shrinkFilter = contextMenu.addAction("Toggle shrink filter");
         shrinkFilter->setCheckable(true);
-        QString shrinkState = index.siblingAtColumn(2).data().toString();
-        bool isShrinked = (shrinkState == "true");
-        shrinkFilter->setChecked(isShrinked);
+        shrinkFilter->setChecked(item->hasFlag(ModelPart::Shrink));
 
         QAction* toggleVisibility = contextMenu.addAction("Toggle visibility");
         toggleVisibility->setCheckable(true);
-        QString visibilityState = index.siblingAtColumn(1).data().toString();
-        bool isVisible = (visibilityState == "true");
-        toggleVisibility->setChecked(isVisible);
+        toggleVisibility->setChecked(item->visible());
 
 
         QAction* renamePart = contextMenu.addAction("Rename part");
 
+        QAction* deletePart = contextMenu.addAction("Delete part");
+
         QAction* selectedAction = contextMenu.exec(ui->treeView->viewport()->mapToGlobal(pos));
         if (!selectedAction) return;
 
@@ -352,19 +973,18 @@ void MainWindow::on_treeViewContextMenu(const QPoint &pos)
             QColor chosenColour = QColorDialog::getColor(Qt::yellow, this, "Select Colour");
             if (!chosenColour.isValid()) return;
 
-            item->setColour(chosenColour.red(), chosenColour.green(), chosenColour.blue());
+            for (const QModelIndex& target : std::as_const(targets))
+                static_cast<ModelPart*>(target.internalPointer())->setColour(chosenColour.red(), chosenColour.green(), chosenColour.blue());
 
-            ui->vtkWidget->renderWindow()->Render();
+            renderScheduler->requestRender();
             statusBar()->showMessage("Changed colour of: " + partName + " to " + chosenColour.name());
 
 
 
         }  else if (selectedAction == clipFilter) {
             bool enabled = clipFilter->isChecked();
-            item->set(3, enabled ? "true" : "false");
-            item->applyClip(enabled);
-            ui->treeView->update(index);
-            ui->vtkWidget->renderWindow()->Render();
+            partList->setSubtreeClip(targets, enabled);
+            renderScheduler->requestRender();
             statusBar()->showMessage(QString("Clip filter %1 on: %2").arg(enabled ? "enabled" : "disabled", partName));
 
 
@@ -372,10 +992,8 @@ void MainWindow::on_treeViewContextMenu(const QPoint &pos)
 
         } else if (selectedAction == shrinkFilter) {
             bool enabled = shrinkFilter->isChecked();
-            item->set(2, enabled ? "true" : "false");
-            item->applyShrink(enabled);
-            ui->treeView->update(index);
-            ui->vtkWidget->renderWindow()->Render();
+            partList->setSubtreeShrink(targets, enabled);
+            renderScheduler->requestRender();
             statusBar()->showMessage(QString("Shrink filter %1 on: %2").arg(enabled ? "enabled" : "disabled", partName));
 
 
@@ -385,10 +1003,12 @@ void MainWindow::on_treeViewContextMenu(const QPoint &pos)
 
         } else if (selectedAction == toggleVisibility) {
             bool newVisible = !item->visible();
-            item->propagateVisibility(newVisible);
+            partList->setSubtreeVisible(targets, newVisible);
+            if (newVisible)
+                for (const QModelIndex& target : std::as_const(targets))
+                    loadVisibleGeometry(static_cast<ModelPart*>(target.internalPointer()));
 
-            ui->treeView->update(index);
-            ui->vtkWidget->renderWindow()->Render();
+            renderScheduler->requestRender();
 
             statusBar()->showMessage(QString("Toggled visibility: now %1").arg(newVisible ? "visible" : "hidden"));
 
@@ -396,12 +1016,27 @@ void MainWindow::on_treeViewContextMenu(const QPoint &pos)
 
 
 
+        } else if (selectedAction == deletePart) {
+            /* Parts waiting for the loader must stay alive until it is done with them */
+            if (partLoader->isBusy()) {
+                statusBar()->showMessage("Parts can't be deleted while loading");
+                return;
+            }
+            /* Rows shift as earlier ones go, so each is looked up again before it is removed */
+            QList<QPersistentModelIndex> doomed;
+            for (const QModelIndex& target : std::as_const(targets))
+                doomed.append(target);
+            for (const QPersistentModelIndex& target : std::as_const(doomed))
+                if (target.isValid())
+                    partList->removeRows(target.row(), 1, target.parent());
+            renderScheduler->requestRender();
+            statusBar()->showMessage("Deleted: " + partName);
+
         } else if (selectedAction == renamePart) {
             bool ok;
             QString newName = QInputDialog::getText(this, "Rename Part", "New name:", QLineEdit::Normal, partName, &ok);
             if (ok && !newName.isEmpty()) {
-                item->setData(0, newName);
-                ui->treeView->update(index);
+                partList->setData(index.siblingAtColumn(ModelPartList::NameColumn), newName);
                 statusBar()->showMessage("Renamed part to: " + newName);
             }
         }
@@ -413,6 +1048,126 @@ void MainWindow::on_treeViewContextMenu(const QPoint &pos)
     }
 }
 
+/**
+ * @brief MainWindow::onSubtreeChecked
+ * @param index The item whose subtree changed.
+ * @param column The checkbox column.
+ * @param checked The new state.
+ */
+void MainWindow::onSubtreeChecked(const QModelIndex& index, int column, bool checked) {
+    ModelPart* item = static_cast<ModelPart*>(index.internalPointer());
+    if (column == ModelPartList::VisibleColumn && checked)
+        loadVisibleGeometry(item);
+
+    renderScheduler->requestRender();
+    const QString setting = column == ModelPartList::VisibleColumn ? "Visibility"
+                          : column == ModelPartList::ShrinkColumn ? "Shrink filter" : "Clip filter";
+    statusBar()->showMessage(QString("%1 %2 on: %3").arg(setting, checked ? "enabled" : "disabled", item->name()));
+}
+
+/**
+ * @brief MainWindow::on_searchEdit_textChanged
+ * @param text The search text.
+ */
+void MainWindow::on_searchEdit_textChanged(const QString&) {
+    updateSearch();
+}
+
+/**
+ * @brief MainWindow::updateSearch
+ * Only the first thousand matches are listed, as filling the list costs far
+ * more than the search. Select All Matches still takes every match. Matches
+ * still held as records are listed by their record's name, without being made.
+ */
+void MainWindow::updateSearch() {
+    const int maxResults = 1000;
+    const QString text = ui->searchEdit->text();
+
+    ui->searchResults->clear();
+    ui->searchResults->setVisible(!text.isEmpty());
+    searchMatches.clear();
+    ui->selectMatchesButton->setEnabled(false);
+    if (text.isEmpty())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    searchMatches = nameIndex->find(text);
+    const double elapsed = timer.nsecsElapsed() / 1.0e6;
+
+    for (int i = 0; i < qMin<qsizetype>(searchMatches.size(), maxResults); ++i) {
+        QListWidgetItem* result = new QListWidgetItem(nameIndex->name(searchMatches[i]), ui->searchResults);
+        result->setData(Qt::UserRole, i);
+    }
+    ui->selectMatchesButton->setEnabled(!searchMatches.isEmpty());
+
+    statusBar()->showMessage(QString("%1 of %2 parts match \"%3\" (%4 ms)%5")
+                                 .arg(searchMatches.size())
+                                 .arg(nameIndex->partCount())
+                                 .arg(text)
+                                 .arg(elapsed, 0, 'f', 2)
+                                 .arg(searchMatches.size() > maxResults ? QString(", first %1 listed").arg(maxResults) : QString()));
+}
+
+/**
+ * @brief MainWindow::on_searchResults_itemClicked
+ * A match still held as a record is made, with the branches above it. The
+ * index stays quiet meanwhile, as running the search again would clear the
+ * list while its item is being clicked.
+ * @param result The result that was clicked.
+ */
+void MainWindow::on_searchResults_itemClicked(QListWidgetItem* result) {
+    const int match = result->data(Qt::UserRole).toInt();
+    if (match < 0 || match >= searchMatches.size())
+        return;
+
+    ModelPart* part;
+    {
+        const QSignalBlocker blocker(nameIndex);
+        part = nameIndex->makePart(searchMatches[match]);
+    }
+    if (!part)
+        return;
+
+    const QModelIndex index = partList->indexOf(part);
+    ui->treeView->scrollTo(index);      // expands the branches above it
+    ui->treeView->selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+    statusBar()->showMessage("The selected item is: " + part->name());
+}
+
+/**
+ * @brief MainWindow::on_selectMatchesButton_clicked
+ * Matches still held as records are made, with the branches above them, as
+ * only parts can be selected. The matches are selected without expanding
+ * their branches, so this stays quick for thousands of matches; right
+ * clicking one of them then acts on all.
+ */
+void MainWindow::on_selectMatchesButton_clicked() {
+    QList<ModelPart*> parts;
+    {
+        /* Each branch made would otherwise run the search again */
+        const QSignalBlocker blocker(nameIndex);
+        for (const PartNameIndex::Match& match : std::as_const(searchMatches))
+            if (ModelPart* part = nameIndex->makePart(match))
+                parts.append(part);
+    }
+    updateSearch();
+    if (parts.isEmpty())
+        return;
+
+    QItemSelection selection;
+    for (ModelPart* part : std::as_const(parts)) {
+        const QModelIndex index = partList->indexOf(part);
+        selection.select(index, index);
+    }
+
+    const QModelIndex first = partList->indexOf(parts.first());
+    ui->treeView->selectionModel()->setCurrentIndex(first, QItemSelectionModel::NoUpdate);
+    ui->treeView->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+    ui->treeView->scrollTo(first);
+    statusBar()->showMessage(QString("Selected %1 matching parts").arg(parts.size()));
+}
+
 /**
  * @brief MainWindow::on_colourButton_triggered
  * Opens a color dialog and sets the color of the entire model.
@@ -425,28 +1180,76 @@ void MainWindow::on_colourButton_triggered() {
         return;
     }
 
-    ModelPart* root = partList->getRootItem();
-    root->propagateColour(chosenColour.red(), chosenColour.green(), chosenColour.blue());
+    partList->setSubtreeColour({ QModelIndex() }, chosenColour.red(), chosenColour.green(), chosenColour.blue());
 
-    ui->vtkWidget->renderWindow()->Render();
+    renderScheduler->requestRender();
     statusBar()->showMessage("Changed colour of entire model to " + chosenColour.name());
 }
 
 /**
  * @brief MainWindow::on_resetView_triggered
- * Resets the camera view to a default position.
+ * Turns the camera back to looking down the z axis with y up, then fits the whole model.
  */
 void MainWindow::on_resetView_triggered() {
     statusBar()->showMessage("View reset");
 
     vtkCamera* camera = renderer->GetActiveCamera();
 
-    camera->SetPosition(70.8764, 0, 597.675);
-    camera->SetFocalPoint(70.8764, 0, 34.8563);
+    camera->SetPosition(0, 0, 1);
+    camera->SetFocalPoint(0, 0, 0);
     camera->SetViewUp(0, 1, 0);
 
-    renderer->ResetCameraClippingRange();
-    ui->vtkWidget->renderWindow()->Render();
+    frameBounds(partList->getRootItem());
+}
+
+/**
+ * @brief MainWindow::on_actionFrameAll_triggered
+ * Fits the whole model in the view, keeping the camera's direction.
+ */
+void MainWindow::on_actionFrameAll_triggered() {
+    if (!frameBounds(partList->getRootItem()))
+        statusBar()->showMessage("Nothing loaded to frame");
+}
+
+/**
+ * @brief MainWindow::on_actionFrameSelection_triggered
+ * Fits the selected part and everything below it in the view, keeping the camera's direction.
+ */
+void MainWindow::on_actionFrameSelection_triggered() {
+    QModelIndex index = ui->treeView->currentIndex();
+    if (!index.isValid()) {
+        statusBar()->showMessage("Select a part to frame");
+        return;
+    }
+
+    ModelPart* part = static_cast<ModelPart*>(index.internalPointer());
+    if (frameBounds(part))
+        statusBar()->showMessage("Framed " + part->name());
+    else
+        statusBar()->showMessage(part->name() + " has no geometry loaded");
+}
+
+/**
+ * @brief MainWindow::frameBounds
+ * Uses the parts' cached subtree bounds, so framing costs the same however
+ * many actors are in the scene. The clipping range is set from the whole
+ * model so that framing a small part doesn't clip the parts around it.
+ * @param part The root of the subtree to frame.
+ * @return False if the subtree has no geometry.
+ */
+bool MainWindow::frameBounds(ModelPart* part) {
+    double bounds[6];
+    if (!part->getSubtreeBounds(bounds))
+        return false;
+
+    renderer->ResetCamera(bounds);
+
+    double modelBounds[6];
+    if (partList->getRootItem()->getSubtreeBounds(modelBounds))
+        renderer->ResetCameraClippingRange(modelBounds);
+
+    renderScheduler->requestRender();
+    return true;
 }
 
 /**
@@ -457,35 +1260,63 @@ void MainWindow::on_resetView_triggered() {
 void MainWindow::on_lightSlider_valueChanged(int value) {
     double intensity = static_cast<double>(value) / 100.0;
 
-    vtkLightCollection* lights = renderer->GetLights();
-    lights->InitTraversal();
-
-    vtkLight* light;
-    while ((light = lights->GetNextItem())) {
-        light->SetIntensity(intensity);
-    }
+    /* Only the last value set before each frame reaches the lights */
+    renderScheduler->defer("light", [this, intensity]() {
+        vtkLightCollection* lights = renderer->GetLights();
+        lights->InitTraversal();
 
-    renderer->Render();
-    ui->vtkWidget->renderWindow()->Render();
+        vtkLight* light;
+        while ((light = lights->GetNextItem())) {
+            light->SetIntensity(intensity);
+        }
+    });
 
     statusBar()->showMessage(QString("Light intensity set to %1%").arg(value));
 }
 
+/**
+ * @brief MainWindow::onShrinkSliderChanged
+ * Sets the shrink factor of the shrunk parts among the selected part and its
+ * children, or in the whole model if nothing is selected. Shrink itself is
+ * switched on with the checkbox or the context menu. Parts shrunk on the GPU
+ * only have a shader uniform changed, so this keeps up with the slider.
+ * @param value The value of the shrink slider (10-100 percent).
+ */
+void MainWindow::onShrinkSliderChanged(int value) {
+    double factor = static_cast<double>(value) / 100.0;
+
+    QModelIndex index = ui->treeView->currentIndex();
+    ModelPart* part = static_cast<ModelPart*>(index.internalPointer());
+
+    /* CPU shrink filters rerun on each change, so only the last value before each frame is applied */
+    /* An invalid index means the whole model, so a part deleted before the
+     * frame must not turn into that */
+    const QPersistentModelIndex target(index);
+    const bool wholeModel = !index.isValid();
+    renderScheduler->defer("shrink", [this, target, wholeModel, factor]() {
+        if (!wholeModel && !target.isValid())
+            return;
+        partList->setSubtreeShrinkFactor({ target }, factor);
+    });
+
+    statusBar()->showMessage(QString("Shrink factor of shrunk parts in %1 set to %2%")
+                                 .arg(part ? part->name() : QString("the model"))
+                                 .arg(value));
+}
+
 /**
  * @brief MainWindow::updateRender
- * Updates the entire scene by removing all actors and re-adding them from the model tree.
+ * Brings every part's actor in the renderer up to date. Parts whose actor
+ * hasn't changed cost a hash lookup, and the camera is left alone.
  */
 void MainWindow::updateRender() {
-    renderer->RemoveAllViewProps();
     updateRenderFromTree(QModelIndex());  // start from invisible root
-    renderer->ResetCamera();
-    ui->vtkWidget->renderWindow()->Render();
 }
 
 /**
  * @brief MainWindow::updateRenderFromTree
- * Recursively updates the scene by adding actors from the model tree.
- * @param index The index of the current item in the tree.
+ * Brings the actors of a subtree up to date and asks for a render.
+ * @param index The index of the root of the subtree, or an invalid index for the whole tree.
  */
 void MainWindow::updateRenderFromTree(const QModelIndex& index) {
     ModelPart* part;
@@ -496,15 +1327,8 @@ void MainWindow::updateRenderFromTree(const QModelIndex& index) {
         part = static_cast<ModelPart*>(index.internalPointer());
     }
 
-    if (part && part->getActor()) {
-        qDebug() << "Rendering part:" << part->data(0).toString();
-        renderer->AddActor(part->getActor());
-    }
-
-    int rows = partList->rowCount(index);
-    for (int i = 0; i < rows; ++i) {
-        updateRenderFromTree(partList->index(i, 0, index));
-    }
+    sceneSync->updateSubtree(part);
+    renderScheduler->requestRender();
 }
 
 
@@ -526,4 +1350,3 @@ void MainWindow::onStartVRButtonClicked()
 
 */
 
-}
@@ -4,14 +4,31 @@
 #include "ModelPart.h"      ///< Custom header for the ModelPart class
 #include "ModelPartList.h"  ///< Custom header for the ModelPartList class
 #include "VRRenderThread.h"   ///< Custom header for the VRRenderThread class
+#include "PartLoader.h"     ///< Custom header for the background STL loader
+#include "PartNameIndex.h"  ///< Custom header for the part search index
 
 #include <QMainWindow>      ///< Qt class for the main window
+#include <QMultiHash>       ///< Qt class for the pending load table
+#include <QSet>             ///< Qt class for the set of parts waiting for geometry
+#include <QPersistentModelIndex>  ///< Qt class for tree indexes that survive model changes
 
 // Forward declarations to avoid including OpenGL-heavy VTK headers in the header file
 class vtkLight;
 class vtkRenderer;
 class vtkGenericOpenGLRenderWindow;
 class QVTKOpenGLNativeWidget;
+class QProgressBar;
+class QLabel;
+class QPushButton;
+class SectionTool;
+class PartInstancer;
+class LodManager;
+class InteractionQuality;
+class PartCuller;
+class RenderScheduler;
+class SceneSync;
+class OverviewBatch;
+class QListWidgetItem;
 template <typename T> class vtkSmartPointer;
 
 
@@ -72,16 +89,138 @@ private slots:
       */
     void on_actionOpen_FIle_triggered();
 
+    /**
+      * @brief Adds a part loaded by the background loader to the tree and the scene.
+      * @param fileName The file that was loaded.
+      * @param pipeline The pipeline built for the file.
+      */
+    void onPartLoaded(const QString& fileName, const PartPipeline& pipeline);
+
+    /**
+      * @brief Gives a part already in the tree the geometry loaded for it and shows it.
+      * @param part The part.
+      * @param pipeline The pipeline built for the part.
+      */
+    void onPartReady(ModelPart* part, const PartPipeline& pipeline);
+
+    /**
+      * @brief Reports a file the background loader could not read.
+      * @param fileName The file that failed.
+      */
+    void onPartLoadFailed(const QString& fileName);
+
+    /**
+      * @brief Updates the status bar progress indicator.
+      * @param done Number of files loaded so far.
+      * @param total Number of files being loaded.
+      */
+    void onLoadProgress(int done, int total);
+
+    /**
+      * @brief Hides the progress indicator once a batch of files has finished loading.
+      * @param cancelled True if the batch was cancelled.
+      */
+    void onLoadFinished(bool cancelled);
+
+    /**
+      * @brief Shows the geometry cache hit and miss counts and the shared duplicate loads in the status bar.
+      */
+    void updateCacheStatus();
+
     /**
       * @brief Opens the item options dialog.
       */
     void on_actionItemOptions_triggered();
 
     /**
-      * @brief Saves the current scene to an STL file.
+      * @brief Saves the part tree to a project file.
       */
     void on_actionSave_File_triggered();
 
+    /**
+      * @brief Opens a project file, replacing the current part tree.
+      */
+    void on_actionOpen_Project_triggered();
+
+    /**
+      * @brief Imports every STL file in a folder and its subfolders as one subtree.
+      */
+    void on_actionImportFolder_triggered();
+
+    /**
+      * @brief Lists the parts whose names contain the search text.
+      * @param text The search text.
+      */
+    void on_searchEdit_textChanged(const QString& text);
+
+    /**
+      * @brief Selects and shows the part of a search result in the tree.
+      * @param result The result that was clicked.
+      */
+    void on_searchResults_itemClicked(QListWidgetItem* result);
+
+    /**
+      * @brief Selects every part matching the search, so the context menu acts on all of them.
+      */
+    void on_selectMatchesButton_clicked();
+
+    /**
+      * @brief Exports the visible parts, as filtered, to binary STL files.
+      */
+    void on_actionExport_STL_triggered();
+
+    /**
+      * @brief Adds a section plane facing along a chosen axis.
+      */
+    void on_actionAddSectionPlane_triggered();
+
+    /**
+      * @brief Adds a section plane facing the last one, keeping a slab between them.
+      */
+    void on_actionAddParallelPlane_triggered();
+
+    /**
+      * @brief Removes every section plane.
+      */
+    void on_actionClearSectionPlanes_triggered();
+
+    /**
+      * @brief Asks for the vertex welding grid spacing used when loading STL files.
+      */
+    void on_actionWeldTolerance_triggered();
+
+    /**
+      * @brief Asks for the screen sizes at which parts switch level of detail.
+      */
+    void on_actionLodThresholds_triggered();
+
+    /**
+      * @brief Shows or hides the level of detail debug overlay.
+      * @param checked True to show the overlay.
+      */
+    void on_actionLodOverlay_toggled(bool checked);
+
+    /**
+      * @brief Asks for the screen size below which parts are culled.
+      */
+    void on_actionCullingThreshold_triggered();
+
+    /**
+      * @brief Switches the batched overview on or off.
+      * @param checked True to batch the parts.
+      */
+    void on_actionBatchedOverview_toggled(bool checked);
+
+    /**
+      * @brief Shows the number of parts drawn and culled in the last frame.
+      */
+    void on_actionCullingStats_triggered();
+
+    /**
+      * @brief Shows the render count and times since they were last shown.
+      */
+    void on_actionFrameStats_triggered();
+
     /**
       * @brief Displays a help message.
       */
@@ -98,6 +237,14 @@ private slots:
       */
     void on_treeViewContextMenu(const QPoint &pos);
 
+    /**
+      * @brief Renders after a checkbox in the tree view is ticked or cleared, loading any parts it shows.
+      * @param index The item whose subtree changed.
+      * @param column The checkbox column.
+      * @param checked The new state.
+      */
+    void onSubtreeChecked(const QModelIndex& index, int column, bool checked);
+
     /**
       * @brief Handles the color change request.
       */
@@ -108,6 +255,16 @@ private slots:
       */
     void on_resetView_triggered();
 
+    /**
+      * @brief Fits the whole model in the view.
+      */
+    void on_actionFrameAll_triggered();
+
+    /**
+      * @brief Fits the selected part and its children in the view.
+      */
+    void on_actionFrameSelection_triggered();
+
     /**
       * @brief Handles changes to the light intensity slider.
       * @param value The new value of the slider.
@@ -115,23 +272,80 @@ private slots:
     void on_lightSlider_valueChanged(int value);
 
     /**
-      * @brief Updates the rendering of the scene.
+      * @brief Shrinks the selected subtree, or every part, by the slider's factor.
+      * @param value The new value of the slider (10-100 percent).
+      */
+    void onShrinkSliderChanged(int value);
+
+    /**
+      * @brief Brings the scene's part actors up to date with the whole tree, without moving the camera.
       */
     void updateRender();
 
     /**
-      * @brief Recursively updates the scene from the model tree.
-      * @param index The index of the current item in the tree.
+      * @brief Brings the scene's part actors up to date with a subtree.
+      * @param index The root of the subtree, or an invalid index for the whole tree.
       */
     void updateRenderFromTree(const QModelIndex& index);
     //void onStartVRButtonClicked();
 
 private:
+    /**
+      * @brief Queues geometry loads for visible parts in a subtree that don't have any yet.
+      * @param part The root of the subtree.
+      */
+    void loadVisibleGeometry(ModelPart* part);
+
+    /**
+      * @brief Builds a subtree of parts for the STL files in a folder, outside the tree model.
+      * @param directory The folder.
+      * @param files Incremented by the number of STL files found.
+      * @return The folder's item, owned by the caller, or nullptr if the folder has no STL files.
+      */
+    ModelPart* buildFolderTree(const QString& directory, int& files);
+
+    /**
+      * @brief Runs the search again and fills the results list, e.g. after the tree has changed.
+      */
+    void updateSearch();
+
+    /**
+      * @brief Gives every part in the tree the current section planes.
+      */
+    void applySectionPlanes();
+
+    /**
+      * @brief Points the camera so that a subtree fills the view.
+      * @param part The root of the subtree.
+      * @return False if the subtree has no geometry.
+      */
+    bool frameBounds(ModelPart* part);
+
     Ui::MainWindow *ui;                                     ///< Pointer to the user interface object.
     ModelPartList* partList;                                 ///< List of model parts in the scene.
     vtkSmartPointer<vtkLight> sceneLight;                   ///< Smart pointer to the scene's light.
     vtkSmartPointer<vtkGenericOpenGLRenderWindow> renderWindow;  ///< Smart pointer to the render window.
     vtkSmartPointer<vtkRenderer> renderer;                   ///< Smart pointer to the renderer.
+    PartLoader* partLoader;                                  ///< Loads STL files on worker threads.
+    QMultiHash<QString, QPersistentModelIndex> pendingLoads; ///< Tree item each queued file will be added under.
+    QProgressBar* loadProgress;                              ///< Status bar progress of the current load.
+    QPushButton* loadCancel;                                 ///< Status bar button cancelling the current load.
+    GeometryCache* geometryCache;                            ///< On-disk cache of processed part geometry.
+    QLabel* cacheStatus;                                     ///< Status bar geometry cache hit/miss counts.
+    GeometryStore* geometryStore;                            ///< Meshes in use, shared by parts loaded from the same bytes.
+    QLabel* storeStatus;                                     ///< Status bar duplicate loads and memory saved.
+    QSet<ModelPart*> queuedParts;                            ///< Parts in the tree waiting for the loader.
+    bool frameWhenLoaded = false;                            ///< Reset the camera when the current load finishes.
+    SectionTool* sectionTool;                                ///< Section planes shared by every part.
+    PartInstancer* instancer;                                ///< Shares and instances the meshes of repeated parts.
+    OverviewBatch* overviewBatch;                            ///< Draws plain parts as blocks of one composite mapper.
+    LodManager* lodManager;                                  ///< Decimated levels of detail of large parts.
+    InteractionQuality* interactionQuality;                  ///< Lowers quality while the camera moves.
+    vtkSmartPointer<PartCuller> partCuller;                  ///< Culls off-screen and tiny parts by subassembly.
+    RenderScheduler* renderScheduler;                        ///< Coalesces render requests to one per display frame.
+    SceneSync* sceneSync;                                    ///< Applies tree changes to the renderer's part actors.
+    PartNameIndex* nameIndex;                                ///< Index of part names for the search.
+    QList<PartNameIndex::Match> searchMatches;               ///< Parts matching the current search, made or not.
     //VRRenderThread* vrThread;
 };
 